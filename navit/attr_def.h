@@ -203,6 +203,11 @@ ATTR(nav_status)
 ATTR(virtual_dpi)
 ATTR(real_dpi)
 ATTR(underground_alpha)
+ATTR(image_cache_size)
+ATTR(draw_budget)
+ATTR(frame_stats)
+ATTR(dynamic_overlay)
+ATTR(load_threads)
 ATTR2(0x00027500,type_rel_abs_begin)
 /* These attributes are int that can either hold relative or absolute values. See the
  * documentation of ATTR_REL_RELSHIFT for details.
@@ -404,6 +409,7 @@ ATTR(street_destination)
 ATTR(exit_to)
 ATTR(street_destination_forward)
 ATTR(street_destination_backward)
+ATTR(frame_report)
 ATTR2(0x0003ffff,type_string_end)
 ATTR2(0x00040000,type_special_begin)
 ATTR(order)
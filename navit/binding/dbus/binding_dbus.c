@@ -889,6 +889,11 @@ static DBusHandlerResult request_gui_command(DBusConnection *connection, DBusMes
 
 
 
+static DBusHandlerResult request_graphics_get_attr(DBusConnection *connection, DBusMessage *message) {
+    return request_get_attr(connection, message, "graphics", NULL, (int (*)(void *, enum attr_type, struct attr *,
+                            struct attr_iter *))graphics_get_attr);
+}
+
 static DBusHandlerResult request_graphics_set_attr(DBusConnection *connection, DBusMessage *message) {
     return request_set_add_remove_attr(connection, message, "graphics", NULL, (int (*)(void *,
                                        struct attr *))graphics_set_attr);
@@ -1982,6 +1987,7 @@ struct dbus_method {
     {"",	    "search_list_new",	   "o",       "mapset",                                  "o",  "search",request_search_list_new},
     {".callback","destroy",            "",        "",                                        "",   "",      request_callback_destroy},
     {".graphics","get_data", 	   "s",	      "type",				 	 "ay",  "data", request_graphics_get_data},
+    {".graphics","get_attr",           "s",       "attribute",                               "sv",  "attrname,value", request_graphics_get_attr},
     {".graphics","set_attr",           "sv",      "attribute,value",                         "",   "",      request_graphics_set_attr},
     {".gui",     "get_attr",           "s",       "attribute",                               "sv",  "attrname,value", request_gui_get_attr},
     {".gui",     "command_parameter",  "sa{sa{sv}}","command,parameter",                     "a{sa{sv}}",  "return", request_gui_command},
@@ -31,6 +31,9 @@
 #include <wordexp.h>
 #include <glib.h>
 #include <zlib.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include "debug.h"
 #include "cache.h"
 #include "file.h"
@@ -50,6 +53,23 @@ static GHashTable *file_name_hash;
 
 static struct cache *file_cache;
 
+/* Map rects may be read from several threads at once, so the cache and the file position are guarded by a mutex.
+ * Compressed data is uncompressed outside of it, the entries being filled are kept in file_cache_filling. */
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t file_cache_mutex=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t file_cache_filled=PTHREAD_COND_INITIALIZER;
+#define file_cache_lock() pthread_mutex_lock(&file_cache_mutex)
+#define file_cache_unlock() pthread_mutex_unlock(&file_cache_mutex)
+#define file_cache_wait() pthread_cond_wait(&file_cache_filled, &file_cache_mutex)
+#define file_cache_signal() pthread_cond_broadcast(&file_cache_filled)
+#else
+#define file_cache_lock()
+#define file_cache_unlock()
+#define file_cache_wait()
+#define file_cache_signal()
+#endif
+static GList *file_cache_filling;
+
 #ifdef HAVE_PRAGMA_PACK
 #pragma pack(push)
 #pragma pack(1)
@@ -322,19 +342,26 @@ unsigned char *file_data_read(struct file *file, long long offset, int size) {
         return NULL;
     if (file->begin)
         return file->begin+offset;
+    file_cache_lock();
     if (file->cache) {
         struct file_cache_id id= {offset,size,file->name_id,0};
         ret=cache_lookup(file_cache,&id);
-        if (ret)
+        if (ret) {
+            file_cache_unlock();
             return ret;
+        }
         ret=cache_insert_new(file_cache,&id,size);
     } else
         ret=g_malloc(size);
     lseek(file->fd, offset, SEEK_SET);
     if (read(file->fd, ret, size) != size) {
-        file_data_free(file, ret);
+        if (file->cache)
+            cache_entry_destroy(file_cache, ret);
+        else
+            g_free(ret);
         ret=NULL;
     }
+    file_cache_unlock();
     return ret;
 
 }
@@ -431,7 +458,9 @@ unsigned char *file_data_read_all(struct file *file) {
 void file_data_flush(struct file *file, long long offset, int size) {
     if (file->cache) {
         struct file_cache_id id= {offset,size,file->name_id,0};
+        file_cache_lock();
         cache_flush(file_cache,&id);
+        file_cache_unlock();
         dbg(lvl_debug,"Flushing "LONGLONG_FMT" %d bytes",offset,size);
     }
 }
@@ -491,30 +520,57 @@ unsigned char *file_data_read_compressed(struct file *file, long long offset, in
     void *ret;
     char *buffer = 0;
     uLongf destLen=size_uncomp;
+    struct file_cache_id id= {offset,size,file->name_id,1};
+    int ok=0;
 
+    file_cache_lock();
     if (file->cache) {
-        struct file_cache_id id= {offset,size,file->name_id,1};
-        ret=cache_lookup(file_cache,&id);
-        if (ret)
+        /* another thread may be uncompressing the same data */
+        while ((ret=cache_lookup(file_cache,&id)) && g_list_find(file_cache_filling, ret)) {
+            cache_entry_destroy(file_cache, ret);
+            file_cache_wait();
+        }
+        if (ret) {
+            file_cache_unlock();
             return ret;
+        }
         ret=cache_insert_new(file_cache,&id,size_uncomp);
+        file_cache_filling=g_list_prepend(file_cache_filling, ret);
     } else
         ret=g_malloc(size_uncomp);
-    lseek(file->fd, offset, SEEK_SET);
+    if (file->begin)
+        buffer=(char *)file->begin+offset;
+    else {
+        lseek(file->fd, offset, SEEK_SET);
+        buffer = (char *)g_malloc(size);
+        if (read(file->fd, buffer, size) != size) {
+            g_free(buffer);
+            buffer=NULL;
+        }
+    }
+    file_cache_unlock();
 
-    buffer = (char *)g_malloc(size);
-    if (read(file->fd, buffer, size) != size) {
-        g_free(ret);
-        ret=NULL;
-    } else {
-        if (uncompress_int(ret, &destLen, (Bytef *)buffer, size) != Z_OK) {
+    if (buffer) {
+        ok=uncompress_int(ret, &destLen, (Bytef *)buffer, size) == Z_OK;
+        if (!ok)
             dbg(lvl_error,"uncompress failed");
-            g_free(ret);
-            ret=NULL;
-        }
+        if (!file->begin)
+            g_free(buffer);
     }
-    g_free(buffer);
 
+    file_cache_lock();
+    if (file->cache) {
+        file_cache_filling=g_list_remove(file_cache_filling, ret);
+        file_cache_signal();
+    }
+    if (!ok) {
+        if (file->cache)
+            cache_flush_data(file_cache, ret);
+        else
+            g_free(ret);
+        ret=NULL;
+    }
+    file_cache_unlock();
     return ret;
 }
 
@@ -526,7 +582,9 @@ void file_data_free(struct file *file, unsigned char *data) {
             return;
     }
     if (file->cache && data) {
+        file_cache_lock();
         cache_entry_destroy(file_cache, data);
+        file_cache_unlock();
     } else
         g_free(data);
 }
@@ -539,7 +597,9 @@ void file_data_remove(struct file *file, unsigned char *data) {
             return;
     }
     if (file->cache && data) {
+        file_cache_lock();
         cache_flush_data(file_cache, data);
+        file_cache_unlock();
     } else
         g_free(data);
 }
@@ -85,6 +85,177 @@ static FTC_SBitCache sbit_cache;
 static int library_init = 0;
 static int library_deinit = 0;
 
+/** Bytes of laid out texts and text bounding boxes kept for reuse after nobody uses them any more */
+#define TEXT_CACHE_SIZE (1024*1024)
+
+/**
+ * @brief Key of a laid out text or a text bounding box in the text cache
+ *
+ * The font is identified by its face and size rather than by the struct font_freetype_font, so entries stay valid
+ * when a font is destroyed and may be shared by several font instances.
+ */
+struct text_cache_key {
+    void *face;         /**< Face id (or face, without FreeType caching) of the font */
+    int size;           /**< Size of the font */
+    int dx,dy;          /**< Text direction, 0,0 for bounding boxes */
+    int bbox;           /**< 1 if this is a bounding box, 0 for a laid out text */
+    char *text;         /**< The text itself */
+};
+
+/**
+ * @brief Entry of the text cache
+ *
+ * For laid out texts, the struct font_freetype_text returned to the caller immediately follows this struct
+ * in the same allocation.
+ */
+struct text_cache_entry {
+    struct text_cache_key key;
+    int refcount;                               /**< Number of users which did not call text_destroy() yet */
+    int size;                                   /**< Estimated memory used by the entry, in bytes */
+    int cached;                                 /**< 1 if the entry is in the hash, 0 if it is freed when unused */
+    struct text_cache_entry *prev,*next;        /**< Neighbours in the list of unused entries, least recently used first */
+    FT_BBox bbox;                               /**< Bounding box, for bounding box entries */
+};
+
+static GHashTable *text_cache;
+static int text_cache_size;
+static struct text_cache_entry *text_cache_unused_first,*text_cache_unused_last;
+
+static guint text_cache_hash(gconstpointer key) {
+    const struct text_cache_key *k=key;
+    return g_str_hash(k->text) ^ GPOINTER_TO_UINT(k->face) ^ (k->size*31) ^ (k->dx*17) ^ (k->dy*7) ^ k->bbox;
+}
+
+static gboolean text_cache_equal(gconstpointer a, gconstpointer b) {
+    const struct text_cache_key *ka=a,*kb=b;
+    return ka->face == kb->face && ka->size == kb->size && ka->dx == kb->dx && ka->dy == kb->dy
+           && ka->bbox == kb->bbox && !strcmp(ka->text, kb->text);
+}
+
+static void text_cache_key_init(struct text_cache_key *key, struct font_freetype_font *font, char *text, int dx, int dy,
+                                int bbox) {
+#if USE_CACHING
+    key->face=font->scaler.face_id;
+#else
+    key->face=font->face;
+#endif
+    key->size=font->size;
+    key->dx=dx;
+    key->dy=dy;
+    key->bbox=bbox;
+    key->text=text;
+}
+
+static void text_cache_unlink(struct text_cache_entry *e) {
+    if (e->prev)
+        e->prev->next=e->next;
+    else
+        text_cache_unused_first=e->next;
+    if (e->next)
+        e->next->prev=e->prev;
+    else
+        text_cache_unused_last=e->prev;
+    e->prev=e->next=NULL;
+}
+
+static void text_cache_append(struct text_cache_entry *e) {
+    e->prev=text_cache_unused_last;
+    e->next=NULL;
+    if (text_cache_unused_last)
+        text_cache_unused_last->next=e;
+    else
+        text_cache_unused_first=e;
+    text_cache_unused_last=e;
+}
+
+static void text_cache_free_entry(struct text_cache_entry *e) {
+    int i;
+    if (!e->key.bbox) {
+        struct font_freetype_text *text=(struct font_freetype_text *)(e+1);
+        for (i = 0 ; i < text->glyph_count ; i++)
+            g_free(text->glyph[i]);
+    }
+    g_free(e->key.text);
+    g_free(e);
+}
+
+/**
+ * @brief Frees unused entries, least recently used first, until the cache fits into TEXT_CACHE_SIZE
+ */
+static void text_cache_shrink(void) {
+    while (text_cache_size > TEXT_CACHE_SIZE && text_cache_unused_first) {
+        struct text_cache_entry *e=text_cache_unused_first;
+        text_cache_unlink(e);
+        g_hash_table_remove(text_cache, &e->key);
+        text_cache_size-=e->size;
+        text_cache_free_entry(e);
+    }
+}
+
+/**
+ * @brief Looks up an entry, taking it off the list of unused entries
+ *
+ * @return The entry, or NULL if the text is not cached
+ */
+static struct text_cache_entry *text_cache_lookup(struct text_cache_key *key) {
+    struct text_cache_entry *e;
+    if (!text_cache)
+        return NULL;
+    e=g_hash_table_lookup(text_cache, key);
+    if (e && !e->refcount)
+        text_cache_unlink(e);
+    return e;
+}
+
+/**
+ * @brief Adds an entry to the cache
+ *
+ * The key text is copied. The entry starts out in use by the caller.
+ */
+static void text_cache_insert(struct text_cache_entry *e, struct text_cache_key *key, int size) {
+    e->key=*key;
+    e->key.text=g_strdup(key->text);
+    e->refcount=1;
+    e->size=size+sizeof(*e)+strlen(key->text)+1;
+    e->cached=1;
+    if (!text_cache)
+        text_cache=g_hash_table_new(text_cache_hash, text_cache_equal);
+    g_hash_table_insert(text_cache, &e->key, e);
+    text_cache_size+=e->size;
+}
+
+/**
+ * @brief Marks an entry as unused, keeping it for reuse while the cache has room for it
+ */
+static void text_cache_release(struct text_cache_entry *e) {
+    if (--e->refcount)
+        return;
+    if (!e->cached) {
+        text_cache_free_entry(e);
+        return;
+    }
+    text_cache_append(e);
+    text_cache_shrink();
+}
+
+static void text_cache_destroy(void) {
+    struct text_cache_entry *e;
+    GHashTableIter iter;
+    if (!text_cache)
+        return;
+    g_hash_table_iter_init(&iter, text_cache);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&e)) {
+        if (e->refcount)
+            e->cached=0;
+        else
+            text_cache_free_entry(e);
+    }
+    g_hash_table_destroy(text_cache);
+    text_cache=NULL;
+    text_cache_size=0;
+    text_cache_unused_first=text_cache_unused_last=NULL;
+}
+
 
 static void font_freetype_get_text_bbox(struct graphics_priv *gr, struct font_freetype_font *font, char *text, int dx,
                                         int dy, struct point *ret, int estimate) {
@@ -97,6 +268,9 @@ static void font_freetype_get_text_bbox(struct graphics_priv *gr, struct font_fr
     int i;
     struct point pt;
     int n, len, x = 0, y = 0;
+    struct text_cache_key key;
+    struct text_cache_entry *cached;
+    text_cache_key_init(&key, font, text, 0, 0, 1);
     pen.x = 0 * 64;
     pen.y = 0 * 64;
 #if 0
@@ -117,6 +291,11 @@ static void font_freetype_get_text_bbox(struct graphics_priv *gr, struct font_fr
         bbox.yMin = 0;
         bbox.yMax = 13*font->size/256;
         bbox.xMax = 9*font->size*len/256;
+    } else if ((cached=text_cache_lookup(&key))) {
+        /* the lookup does not take a reference, the release below puts the entry back on the unused list */
+        cached->refcount++;
+        bbox=cached->bbox;
+        text_cache_release(cached);
     } else {
         bbox.xMin = bbox.yMin = 32000;
         bbox.xMax = bbox.yMax = -32000;
@@ -170,6 +349,10 @@ static void font_freetype_get_text_bbox(struct graphics_priv *gr, struct font_fr
             bbox.xMax = 0;
             bbox.yMax = 0;
         }
+        cached=g_new0(struct text_cache_entry, 1);
+        cached->bbox=bbox;
+        text_cache_insert(cached, &key, 0);
+        text_cache_release(cached);
     }
     ret[0].x = bbox.xMin;
     ret[0].y = -bbox.yMin;
@@ -192,16 +375,27 @@ static struct font_freetype_text *font_freetype_text_new(char *text, struct font
     FT_Matrix matrix;
     FT_Vector pen;
     FT_UInt glyph_index;
-    int y, n, len, w, h, pixmap_len;
+    int x, y, n, len, w, h, pixmap_len;
     struct font_freetype_text *ret;
     struct font_freetype_glyph *curr;
     char *p = text;
-    unsigned char *gl, *pm;
+    unsigned char *gl, *pm, *ps;
     FT_BitmapGlyph glyph_bitmap;
     FT_Glyph glyph;
+    struct text_cache_key key;
+    struct text_cache_entry *cached;
+    int size;
 
+    text_cache_key_init(&key, font, text, dx, dy, 0);
+    cached=text_cache_lookup(&key);
+    if (cached) {
+        cached->refcount++;
+        return (struct font_freetype_text *)(cached+1);
+    }
     len = g_utf8_strlen(text, -1);
-    ret = g_malloc(sizeof(*ret) + len * sizeof(struct text_glyph *));
+    size = sizeof(*ret) + len * sizeof(struct text_glyph *);
+    cached = g_malloc0(sizeof(*cached) + size);
+    ret = (struct font_freetype_text *)(cached+1);
     ret->glyph_count = len;
 
     matrix.xx = dx;
@@ -273,17 +467,16 @@ static struct font_freetype_text *font_freetype_text_new(char *text, struct font
 
         w = glyph_bitmap->bitmap.width;
         h = glyph_bitmap->bitmap.rows;
-        if (w && h)
-            pixmap_len = (w + 2) * (h + 2);
-        else
-            pixmap_len = 0;
+        pixmap_len = w * h + (w + 2) * (h + 2);
         curr = g_malloc0(sizeof(*curr) + pixmap_len);
-        if (pixmap_len) {
+        if (w && h) {
             curr->w = w;
             curr->h = h;
         }
         curr->pixmap = (unsigned char *) (curr + 1);
+        curr->shadow = curr->pixmap + w * h;
         ret->glyph[n] = curr;
+        size += sizeof(*curr) + pixmap_len;
 
         curr->x = glyph_bitmap->left << 6;
         curr->y = -glyph_bitmap->top << 6;
@@ -291,6 +484,12 @@ static struct font_freetype_text *font_freetype_text_new(char *text, struct font
             gl = glyph_bitmap->bitmap.buffer + y * glyph_bitmap->bitmap.pitch;
             pm = curr->pixmap + y * w;
             memcpy(pm, gl, w);
+            for (x = 0; x < w; x++) {
+                if (pm[x]) {
+                    ps = curr->shadow + y * (w + 2) + x;
+                    ps[1] = ps[w + 2] = ps[w + 3] = ps[w + 4] = ps[2 * (w + 2) + 1] = 1;
+                }
+            }
         }
 
         curr->dx = glyph->advance.x >> 10;
@@ -302,6 +501,7 @@ static struct font_freetype_text *font_freetype_text_new(char *text, struct font
         p = g_utf8_next_char(p);
     }
     ret->glyph_count = len;
+    text_cache_insert(cached, &key, size);
     return ret;
 }
 
@@ -329,14 +529,7 @@ static struct graphics_font_methods font_methods = {
 
 
 static void font_freetype_text_destroy(struct font_freetype_text *text) {
-    int i;
-    struct font_freetype_glyph **gp;
-
-    gp = text->glyph;
-    i = text->glyph_count;
-    while (i-- > 0)
-        g_free(*gp++);
-    g_free(text);
+    text_cache_release((struct text_cache_entry *)text-1);
 }
 
 #if USE_CACHING
@@ -513,7 +706,7 @@ static int font_freetype_glyph_get_shadow(struct font_freetype_glyph *g, unsigne
         struct color *foreground, struct color *background) {
     int x, y, w = g->w, h = g->h;
     unsigned int bg, fg;
-    unsigned char *pm, *psp,*ps,*psn;
+    unsigned char *pm, *ps;
     fg=((foreground->a>>COL_SHIFT)<<24)|
        ((foreground->r>>COL_SHIFT)<<16)|
        ((foreground->g>>COL_SHIFT)<<8)|
@@ -522,6 +715,7 @@ static int font_freetype_glyph_get_shadow(struct font_freetype_glyph *g, unsigne
        ((background->r>>COL_SHIFT)<<16)|
        ((background->g>>COL_SHIFT)<<8)|
        ((background->b>>COL_SHIFT)<<0);
+    pm = g->shadow;
     for (y = 0; y < h+2; y++) {
         if (stride) {
             ps = data + stride * y;
@@ -530,33 +724,7 @@ static int font_freetype_glyph_get_shadow(struct font_freetype_glyph *g, unsigne
             ps = dataptr[y];
         }
         for (x = 0 ; x < w+2 ; x++)
-            ((unsigned int *)ps)[x]=bg;
-    }
-    for (y = 0; y < h; y++) {
-        pm = g->pixmap + y * w;
-        if (stride) {
-            psp = data + stride * y;
-            ps = psp + stride;
-            psn = ps + stride;
-        } else {
-            unsigned char **dataptr=(unsigned char **)data;
-            psp = dataptr[y];
-            ps = dataptr[y+1];
-            psn = dataptr[y+2];
-        }
-        for (x = 0; x < w; x++) {
-            if (*pm) {
-                ((unsigned int *)psp)[1]=fg;
-                ((unsigned int *)ps)[0]=fg;
-                ((unsigned int *)ps)[1]=fg;
-                ((unsigned int *)ps)[2]=fg;
-                ((unsigned int *)psn)[1]=fg;
-            }
-            psp+=4;
-            ps+=4;
-            psn+=4;
-            pm++;
-        }
+            ((unsigned int *)ps)[x]=*pm++ ? fg : bg;
     }
     return 1;
 }
@@ -601,6 +769,7 @@ static void font_freetype_destroy(void) {
     // Do not call FcFini here: GdkPixbuf also (indirectly) uses fontconfig (for SVGs with
     // text), but does not properly deallocate all objects, so FcFini assert()s.
     if (!library_deinit) {
+        text_cache_destroy();
 #if USE_CACHING
         FTC_Manager_Done(manager);
 #endif
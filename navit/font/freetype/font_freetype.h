@@ -100,6 +100,7 @@ struct font_freetype_methods {
 struct font_freetype_glyph {
 	int x, y, w, h, dx, dy;
 	unsigned char *pixmap;
+	unsigned char *shadow;	/**< mask of the glyph fattened by one pixel, (w+2)*(h+2) bytes */
 };
 
 struct font_freetype_text {
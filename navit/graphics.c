@@ -27,10 +27,17 @@
 //##############################################################################################################
 
 #include <stdlib.h>
+#include <limits.h>
 #include <glib.h>
 #include <stdio.h>
 #include <math.h>
+#ifndef _MSC_VER
+#include <sys/time.h>
+#endif /* _MSC_VER */
 #include "config.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include "debug.h"
 #include "string.h"
 #include "draw_info.h"
@@ -92,9 +99,151 @@ struct graphics {
      * Counter for z_order of displayitems;
     */
     int current_z_order;
-    GHashTable *image_cache_hash;
+    struct graphics_image_cache *image_cache; /**< Images loaded so far, shared with all overlays */
     /* for dpi compensation */
     int dpi_factor;
+    struct graphics_tiles *tiles; /**< Raster tile cache of the map, NULL if not used */
+    struct graphics_batcher *batch; /**< Primitives collected for {@code draw_batch}, NULL if not batching */
+    struct graphics_frame_stats *frame_stats; /**< Statistics of the last frames, NULL if not collected */
+    struct graphics_dynamic *dynamic; /**< Overlay holding the items of dynamic maps, NULL if not used */
+    unsigned int draw_count;    /**< Number of times drawing on the graphics was started */
+};
+
+/**
+ * @brief An image in the image cache
+ */
+struct graphics_image_cached {
+    struct graphics_image img;                  /**< The image itself, must be first */
+    char *key;                                  /**< Key in the cache */
+    int refcount;                               /**< Number of users which did not call {@code graphics_image_free()} yet */
+    int size;                                   /**< Estimated memory used by the image, in bytes */
+    struct graphics_image_cached *prev,*next;   /**< Neighbours in the list of unused images, least recently used first */
+};
+
+/**
+ * @brief Cache of the images loaded by a graphics instance and its overlays
+ *
+ * Images are looked up by path, size and rotation. Images nobody uses any more are kept until the memory used by
+ * all images exceeds {@code attr_image_cache_size}, and then freed least recently used first. Paths for which no
+ * image was found are remembered as well, as {@code NULL}.
+ */
+struct graphics_image_cache {
+    struct graphics *gra;                       /**< The graphics instance the images were loaded for */
+    GHashTable *hash;                           /**< Images by key */
+    int size;                                   /**< Estimated memory used by all images, in bytes */
+    int max_size;                               /**< Size to shrink to by freeing unused images, 0 for no limit */
+    struct graphics_image_cached *unused_first,*unused_last; /**< Unused images, least recently used first */
+};
+
+static struct graphics_image_cache *graphics_image_cache_new(struct graphics *gra) {
+    struct graphics_image_cache *cache=g_new0(struct graphics_image_cache, 1);
+    struct attr *attr=attr_search(gra->attrs, attr_image_cache_size);
+    cache->gra=gra;
+    cache->hash=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    if (attr)
+        cache->max_size=attr->u.num;
+    return cache;
+}
+
+static void graphics_image_cache_unlink(struct graphics_image_cache *cache, struct graphics_image_cached *c) {
+    if (c->prev)
+        c->prev->next=c->next;
+    else
+        cache->unused_first=c->next;
+    if (c->next)
+        c->next->prev=c->prev;
+    else
+        cache->unused_last=c->prev;
+    c->prev=c->next=NULL;
+}
+
+static void graphics_image_cache_free_image(struct graphics_image_cache *cache, struct graphics_image_cached *c) {
+    if (cache->gra->meth.image_free)
+        cache->gra->meth.image_free(cache->gra->priv, c->img.priv);
+    cache->size-=c->size;
+    g_free(c);
+}
+
+/**
+ * @brief Frees unused images until the cache fits into its size limit
+ */
+static void graphics_image_cache_shrink(struct graphics_image_cache *cache) {
+    while (cache->max_size && cache->size > cache->max_size && cache->unused_first) {
+        struct graphics_image_cached *c=cache->unused_first;
+        dbg(lvl_debug,"Freeing cached image '%s'", c->key);
+        graphics_image_cache_unlink(cache, c);
+        /* frees c->key */
+        g_hash_table_remove(cache->hash, c->key);
+        graphics_image_cache_free_image(cache, c);
+    }
+}
+
+static void graphics_image_cache_destroy(struct graphics_image_cache *cache) {
+    GList *ll, *l;
+    /* GHashTableIter isn't used because it broke n800 build at r5107. */
+    for(ll=l=g_hash_to_list(cache->hash); l; l=g_list_next(l)) {
+        if (l->data)
+            graphics_image_cache_free_image(cache, l->data);
+    }
+    g_list_free(ll);
+    g_hash_table_destroy(cache->hash);
+    g_free(cache);
+}
+
+/**
+ * @brief Counters of the caches used while drawing
+ *
+ * The counters only ever increase, the values for a frame are the difference between its start and its end.
+ */
+struct graphics_counters {
+    int image_hits,image_misses;        /**< Lookups in the image cache */
+    int poly_hits,poly_misses;          /**< Lookups of the screen geometry of polygons with holes */
+    int tiles_reused,tiles_rendered;    /**< Tiles of the raster tile cache shown */
+};
+
+static struct graphics_counters graphics_counters;
+
+/**
+ * @brief Items and vertices drawn by a layer of the layout
+ */
+struct graphics_frame_layer {
+    char *name;
+    int items;
+    int vertices;
+};
+
+/**
+ * @brief Statistics of one frame
+ *
+ * A frame starts when loading the displaylist starts, or when drawing starts if the displaylist isn't loaded again,
+ * and ends when the complete displaylist has been drawn. Intermediate frames drawn while loading are part of it.
+ */
+struct graphics_frame {
+    struct timeval start;               /**< Time the frame was started */
+    double total_ms;                    /**< Time from start to end */
+    double phase_ms[graphics_phase_last]; /**< Time spent in each phase, see {@code graphics_phase_set()} */
+    struct graphics_counters counters;  /**< Cache lookups during the frame, the counters at the start while in progress */
+    int order;                          /**< Order the displaylist was loaded for */
+    int items,vertices;                 /**< Total of all layers */
+    int dropped;                        /**< Number of loads cancelled since the previous frame */
+    struct graphics_frame_layer *layers;/**< Counts by layer, indexed like the layers of the layout */
+    int layer_count,layer_size;
+};
+
+/**
+ * @brief Ring buffer with the statistics of the last frames of a graphics instance
+ *
+ * Enabled by setting {@code attr_frame_stats} to the number of frames to keep, and read back as text with
+ * {@code attr_frame_report}.
+ */
+struct graphics_frame_stats {
+    int size;                           /**< Number of frames kept */
+    int count;                          /**< Number of frames in the ring */
+    int next;                           /**< Slot of the next frame */
+    unsigned int frames;                /**< Number of frames completed since the statistics were enabled */
+    unsigned int dropped;               /**< Number of loads cancelled since the statistics were enabled */
+    struct graphics_frame *frame;
+    char *report;                       /**< Last text returned for {@code attr_frame_report} */
 };
 
 struct display_context {
@@ -108,9 +257,24 @@ struct display_context {
     struct transformation *trans;
     enum item_type type;
     int maxlen;
+    struct label_placement *labels; /**< Collects the labels of a frame for placement, NULL to draw them immediately */
+    struct graphics_frame_layer *stats; /**< Receives the items and vertices drawn, NULL if not counted */
+    enum display_maps {
+        display_maps_all,
+        display_maps_static,
+        display_maps_dynamic,
+    } maps; /**< Which maps to draw the items of, see {@code displaylist_map_is_static()} */
+    enum display_elements {
+        display_elements_all,
+        display_elements_no_text,
+        display_elements_text,
+    } elements; /**< Which elements to draw */
+    struct coord_rect *cull; /**< Only items with a bounding box overlapping this area are drawn, NULL to draw all */
 };
 
 #define HASH_SIZE 1024
+/* a progressive load first fetches the items of static maps shown this many orders further out */
+#define PROGRESSIVE_ORDER_DELTA 4
 struct hash_entry {
     enum item_type type;
     struct displayitem *di;
@@ -120,6 +284,10 @@ struct hash_entry {
 struct displaylist {
     int busy;
     int workload;
+    int budget;         /**< Time in ms to spend loading per idle callback, 0 to load {@code workload} items instead */
+    int progressive;    /**< 1 while loading the coarse items of a progressive load, 2 while loading the rest */
+    int coarse_order;   /**< Order of the coarse items of a progressive load */
+    int partial;        /**< Whether the items are what a cancelled load has fetched so far */
     struct callback *cb;
     struct layout *layout, *layout_hashed;
     struct display_context dc;
@@ -130,10 +298,23 @@ struct displaylist {
     int conv;
     struct map_selection *sel;
     struct map_rect *mr;
+    struct map_item_batch *batch;   /**< Items read from {@code mr}, NULL until the first load */
+    int batch_pos;                  /**< Index of the next record of the current batch to add */
+    int threads;                    /**< Number of threads to read static maps with, see {@code attr_load_threads} */
+    struct displaylist_loader *loader; /**< Reads the map being loaded in place of {@code mr} if threads are used */
     struct callback *idle_cb;
     struct event_idle *idle_ev;
     unsigned int seq;
     struct hash_entry hash_entries[HASH_SIZE];
+    struct transformation *trans_loaded; /**< Transformation of the last completed load, NULL if none */
+    struct item_hash *reused; /**< Items kept from the last load while loading, NULL if everything is loaded */
+    struct label_placement *labels; /**< Label placement state, kept across frames */
+    GHashTable *label_strings; /**< Labels of the displayitems, see {@code struct displaylist_label} */
+    struct displaylist_grid *grid; /**< Index of the displayitems for hit testing, NULL if there are no items */
+    struct graphics_frame frame;    /**< Frame in progress, if {@code framing} is set */
+    int framing;                    /**< Whether statistics of the current frame are collected */
+    int dynamic;                    /**< Whether the map being loaded is dynamic */
+    unsigned int static_seq;        /**< Changed whenever items of static maps are added or removed */
 };
 
 
@@ -146,6 +327,17 @@ static void circle_to_points(const struct point *center, int diameter, int scale
                              int *pos, int dir);
 static void graphics_process_selection(struct graphics *gra, struct displaylist *dl);
 static void graphics_gc_init(struct graphics *this_);
+static void graphics_tiles_drag(struct graphics_tiles *tiles, struct point *p);
+static void graphics_tiles_destroy(struct graphics_tiles *tiles);
+static void graphics_dynamic_drag(struct graphics_dynamic *dyn, struct point *p);
+static void graphics_dynamic_destroy(struct graphics_dynamic *dyn);
+static void graphics_batch_flush(struct graphics *gra);
+static void graphics_batch_destroy(struct graphics *gra);
+static void displaylist_grid_add(struct displaylist *dl, struct displayitem *di);
+static void displaylist_grid_free(struct displaylist *dl);
+static void graphics_frame_stats_set(struct graphics *gra, int size);
+static void graphics_frame_stats_free(struct graphics_frame_stats *stats);
+static char *graphics_frame_report(struct graphics *gra);
 
 
 static int graphics_dpi_scale(struct graphics * gra, int p) {
@@ -198,29 +390,183 @@ static struct hash_entry *get_hash_entry(struct displaylist *dl, enum item_type
     return NULL;
 }
 
-static struct hash_entry *set_hash_entry(struct displaylist *dl, enum item_type type) {
+/**
+ * @brief Inserts an item type into a displaylist hash
+ *
+ * @param entries The hash entries
+ * @param type The item type
+ * @param max_offset Maximum probing distance of the hash, updated if the type had to be placed further away
+ * @return The index of the entry of the type, -1 if the hash is full
+ */
+static int set_hash_entry(struct hash_entry *entries, enum item_type type, int *max_offset) {
     int hashidx=(type*2654435761UL) & (HASH_SIZE-1);
-    int offset=0;
-    for (;;) {
-        if (!dl->hash_entries[hashidx].type) {
-            dl->hash_entries[hashidx].type=type;
-            if (dl->max_offset < offset)
-                dl->max_offset=offset;
-            return &dl->hash_entries[hashidx];
+    int offset;
+    for (offset = 0 ; offset < HASH_SIZE ; offset++) {
+        if (!entries[hashidx].type) {
+            entries[hashidx].type=type;
+            if (*max_offset < offset)
+                *max_offset=offset;
+            return hashidx;
         }
-        if (dl->hash_entries[hashidx].type == type)
-            return &dl->hash_entries[hashidx];
+        if (entries[hashidx].type == type)
+            return hashidx;
         hashidx=(hashidx+1)&(HASH_SIZE-1);
-        offset++;
     }
-    return NULL;
+    return -1;
+}
+
+/**
+ * @brief Drawing step of a compiled layout: draw the items of one type with one element
+ */
+struct layout_draw_step {
+    struct element *e;
+    enum item_type type;
+    int hashidx;                /**< Index of the type in the hash of a displaylist set up from the same table */
+    int layer;                  /**< Index of the layer in the layout */
+};
+
+/**
+ * @brief Hash entry of a compiled layout
+ */
+struct layout_hash_slot {
+    enum item_type type;
+    int hashidx;
+};
+
+/**
+ * @brief A layout compiled for one order
+ *
+ * Holds the elements and item types of all itemgras of the active layers matching the order, flattened in drawing
+ * order, so drawing doesn't walk the layers and itemgras and check their order ranges, and the hash slots of the item
+ * types of all layers, so setting up the hash of a displaylist for an order is a copy. The tables are compiled on first
+ * use, kept in the layout and shared by all displaylists drawing with it.
+ */
+struct layout_compiled {
+    struct layout_draw_step *steps;
+    int step_count;
+    struct layout_hash_slot *slots;
+    int slot_count;
+    int max_offset;             /**< Maximum probing distance of the hash */
+};
+
+/**
+ * @brief Returns a signature of the layers of a layout and their active state
+ */
+static unsigned int layout_layers_signature(struct layout *l) {
+    unsigned int layers=0;
+    GList *lays;
+    for (lays=l->layers ; lays ; lays=g_list_next(lays))
+        layers=layers*31+((struct layer *)lays->data)->active+1;
+    return layers;
+}
+
+static struct layout_compiled *layout_compile(struct layout *l, int order) {
+    struct layout_compiled *lc=g_new0(struct layout_compiled, 1);
+    struct hash_entry *entries=g_new0(struct hash_entry, HASH_SIZE);
+    GList *lays,*itms,*es,*types;
+    int steps_size=0,slots_size=0,layer=0;
+
+    for (lays=l->layers ; lays ; lays=g_list_next(lays),layer++) {
+        struct layer *lay=lays->data;
+        int active=lay->active;
+        if (lay->ref)
+            lay=lay->ref;
+        for (itms=lay->itemgras ; itms ; itms=g_list_next(itms)) {
+            struct itemgra *itm=itms->data;
+            if (order < itm->order.min || order > itm->order.max)
+                continue;
+            for (types=itm->type ; types ; types=g_list_next(types)) {
+                enum item_type type=GPOINTER_TO_INT(types->data);
+                int hashidx=set_hash_entry(entries, type, &lc->max_offset);
+                if (hashidx < 0) {
+                    dbg(lvl_error, "too many item types in layout %s", l->name);
+                    continue;
+                }
+                /* the type is already recorded */
+                if (entries[hashidx].di)
+                    continue;
+                entries[hashidx].di=(struct displayitem *)entries;
+                if (lc->slot_count == slots_size) {
+                    slots_size=slots_size ? slots_size*2 : 64;
+                    lc->slots=g_renew(struct layout_hash_slot, lc->slots, slots_size);
+                }
+                lc->slots[lc->slot_count].type=type;
+                lc->slots[lc->slot_count++].hashidx=hashidx;
+            }
+            if (!active)
+                continue;
+            for (es=itm->elements ; es ; es=g_list_next(es)) {
+                for (types=itm->type ; types ; types=g_list_next(types)) {
+                    enum item_type type=GPOINTER_TO_INT(types->data);
+                    if (lc->step_count == steps_size) {
+                        steps_size=steps_size ? steps_size*2 : 64;
+                        lc->steps=g_renew(struct layout_draw_step, lc->steps, steps_size);
+                    }
+                    lc->steps[lc->step_count].e=es->data;
+                    lc->steps[lc->step_count].type=type;
+                    lc->steps[lc->step_count].layer=layer;
+                    lc->steps[lc->step_count++].hashidx=set_hash_entry(entries, type, &lc->max_offset);
+                }
+            }
+        }
+    }
+    g_free(entries);
+    dbg(lvl_debug, "layout %s order %d: %d steps, %d types, max offset %d", l->name, order, lc->step_count,
+        lc->slot_count, lc->max_offset);
+    return lc;
+}
+
+static void layout_compiled_free(struct layout *l) {
+    int i;
+    for (i = 0 ; i < l->compiled_count ; i++) {
+        if (l->compiled[i]) {
+            g_free(l->compiled[i]->steps);
+            g_free(l->compiled[i]->slots);
+            g_free(l->compiled[i]);
+        }
+    }
+    g_free(l->compiled);
+    l->compiled=NULL;
+    l->compiled_count=0;
+}
+
+/**
+ * @brief Returns the layout compiled for an order
+ *
+ * The compiled tables of all orders are dropped if layers were added or activated or deactivated since they were
+ * compiled.
+ */
+static struct layout_compiled *layout_get_compiled(struct layout *l, int order) {
+    unsigned int layers=layout_layers_signature(l);
+    if (layers != l->compiled_layers) {
+        layout_compiled_free(l);
+        l->compiled_layers=layers;
+    }
+    if (order >= l->compiled_count) {
+        l->compiled=g_renew(struct layout_compiled *, l->compiled, order+1);
+        memset(l->compiled+l->compiled_count, 0, (order+1-l->compiled_count)*sizeof(struct layout_compiled *));
+        l->compiled_count=order+1;
+    }
+    if (!l->compiled[order])
+        l->compiled[order]=layout_compile(l, order);
+    return l->compiled[order];
+}
+
+static void displaylist_update_hash(struct displaylist *displaylist) {
+    struct layout_compiled *lc=layout_get_compiled(displaylist->layout, displaylist->order);
+    int i;
+    clear_hash(displaylist);
+    for (i = 0 ; i < lc->slot_count ; i++)
+        displaylist->hash_entries[lc->slots[i].hashidx].type=lc->slots[i].type;
+    displaylist->max_offset=lc->max_offset;
+    dbg(lvl_debug,"max offset %d",displaylist->max_offset);
 }
 
 /**
  * @brief Sets a generic attribute of the graphics instance
  *
  * This will only set one of the supported generic graphics attributes (currently {@code gamma},
- * {@code brightness}, {@code contrast} or {@code font_size}) and fail for other attribute types.
+ * {@code brightness}, {@code contrast}, {@code font_size} or {@code frame_stats}) and fail for other attribute types.
  *
  * To set an attribute provided by a graphics plugin, use {@link graphics_set_attr(struct graphics *, struct attr *)}
  * instead.
@@ -244,6 +590,10 @@ static int graphics_set_attr_do(struct graphics *gra, struct attr *attr) {
     case attr_font_size:
         gra->font_size=attr->u.num;
         return 1;
+    case attr_frame_stats:
+        graphics_frame_stats_set(gra, attr->u.num);
+        gra->attrs=attr_generic_set_attr(gra->attrs, attr);
+        return 1;
     default:
         return 0;
     }
@@ -270,7 +620,10 @@ int graphics_set_attr(struct graphics *gra, struct attr *attr) {
     int ret=1;
     /* FIXME if gra->meth doesn't have a setter, we don't even try the generic attrs - is that what we want? */
     dbg(lvl_debug,"enter");
-    if (gra->meth.set_attr)
+    /* the frame statistics are no business of the plugin */
+    if (attr->type == attr_frame_stats)
+        ret=0;
+    else if (gra->meth.set_attr)
         ret=gra->meth.set_attr(gra->priv, attr);
     if (!ret)
         ret=graphics_set_attr_do(gra, attr);
@@ -362,7 +715,7 @@ struct graphics * graphics_new(struct attr *parent, struct attr **attrs) {
     this_->contrast=65536;
     this_->gamma=65536;
     this_->font_size=20;
-    this_->image_cache_hash = g_hash_table_new_full(g_str_hash, g_str_equal,g_free,g_free);
+    this_->image_cache=graphics_image_cache_new(this_);
     /*get dpi */
     virtual_dpi_attr=attr_search(attrs, attr_virtual_dpi);
     real_dpi_attr=attr_search(attrs, attr_real_dpi);
@@ -417,6 +770,13 @@ struct graphics * graphics_new(struct attr *parent, struct attr **attrs) {
  * @author Martin Schaller (04/2008)
 */
 int graphics_get_attr(struct graphics *this_, enum attr_type type, struct attr *attr, struct attr_iter *iter) {
+    if (type == attr_frame_report) {
+        if (!this_->frame_stats)
+            return 0;
+        attr->type=type;
+        attr->u.str=graphics_frame_report(this_);
+        return 1;
+    }
     return attr_generic_get_attr(this_->attrs, NULL, type, attr, iter);
 }
 
@@ -451,7 +811,7 @@ struct graphics * graphics_overlay_new(struct graphics *parent, struct point *p,
     w_scaled=graphics_dpi_scale(parent,w);
     h_scaled=graphics_dpi_scale(parent,h);
     this_->priv=parent->meth.overlay_new(parent->priv, &this_->meth, &p_scaled, w_scaled, h_scaled, wraparound);
-    this_->image_cache_hash = parent->image_cache_hash;
+    this_->image_cache = parent->image_cache;
     this_->parent = parent;
     pr.lu.x=0;
     pr.lu.y=0;
@@ -575,23 +935,14 @@ void graphics_free(struct graphics *gra) {
     if (!gra)
         return;
 
-    /* If it's not an overlay, free the image cache. */
-    if(!gra->parent) {
-        struct graphics_image *img;
-        GList *ll, *l;
+    graphics_tiles_destroy(gra->tiles);
+    graphics_dynamic_destroy(gra->dynamic);
+    graphics_batch_destroy(gra);
+    graphics_frame_stats_free(gra->frame_stats);
 
-        /* We can't specify context (pointer to struct graphics) for g_hash_table_new to have it passed to free function
-           so we have to free img->priv manually, the rest would be freed by g_hash_table_destroy. GHashTableIter isn't used because it
-           broke n800 build at r5107.
-        */
-        for(ll=l=g_hash_to_list(gra->image_cache_hash); l; l=g_list_next(l)) {
-            img=l->data;
-            if (img && gra->meth.image_free)
-                gra->meth.image_free(gra->priv, img->priv);
-        }
-        g_list_free(ll);
-        g_hash_table_destroy(gra->image_cache_hash);
-    }
+    /* If it's not an overlay, free the image cache. */
+    if(!gra->parent)
+        graphics_image_cache_destroy(gra->image_cache);
 
     attr_list_free(gra->attrs);
     graphics_gc_destroy(gra->gc[0]);
@@ -636,6 +987,26 @@ struct graphics_gc * graphics_gc_new(struct graphics *gra) {
     return this_;
 }
 
+/**
+ * @brief Primitives collected for one call of {@code draw_batch}
+ */
+struct graphics_batcher {
+    struct graphics_batch b;            /**< The primitives */
+    int active;                         /**< Whether primitives are collected */
+    struct graphics_gc *gc;             /**< Graphics context of the primitives, NULL if there are none */
+    int lines_points,lines_points_size,lines_size; /**< Points used and allocated, polylines allocated */
+    int polygons_points,polygons_points_size,polygons_size; /**< Points used and allocated, polygons allocated */
+    int circles_size;                   /**< Circles allocated */
+};
+
+/**
+ * @brief Draws what was collected for a graphics context before it is changed
+ */
+static inline void graphics_batch_gc_changed(struct graphics_gc *gc) {
+    if (gc->gra->batch && gc->gra->batch->gc == gc)
+        graphics_batch_flush(gc->gra);
+}
+
 /**
  * Destroy a graphics context, freeing associated resources.
  * @param gc context to destroy
@@ -644,6 +1015,7 @@ struct graphics_gc * graphics_gc_new(struct graphics *gra) {
 void graphics_gc_destroy(struct graphics_gc *gc) {
     if (!gc)
         return;
+    graphics_batch_gc_changed(gc);
     gc->meth.gc_destroy(gc->priv);
     g_free(gc);
 }
@@ -691,6 +1063,7 @@ void graphics_gc_set_foreground(struct graphics_gc *gc, struct color *c) {
         graphics_convert_color(gc->gra, c, &cn);
         c=&cn;
     }
+    graphics_batch_gc_changed(gc);
     gc->meth.gc_set_foreground(gc->priv, c);
 }
 
@@ -706,6 +1079,7 @@ void graphics_gc_set_background(struct graphics_gc *gc, struct color *c) {
         graphics_convert_color(gc->gra, c, &cn);
         c=&cn;
     }
+    graphics_batch_gc_changed(gc);
     gc->meth.gc_set_background(gc->priv, c);
 }
 
@@ -717,8 +1091,10 @@ void graphics_gc_set_background(struct graphics_gc *gc, struct color *c) {
  * @author metalstrolch (04/2020)
 */
 void graphics_gc_set_texture(struct graphics_gc *gc, struct graphics_image *img) {
-    if(graphics_gc_has_texture(gc))
+    if(graphics_gc_has_texture(gc)) {
+        graphics_batch_gc_changed(gc);
         gc->meth.gc_set_texture(gc->priv, img->priv);
+    }
 }
 
 /**
@@ -740,6 +1116,7 @@ gboolean graphics_gc_has_texture(struct graphics_gc *gc) {
  * @author Martin Schaller (04/2008)
 */
 void graphics_gc_set_linewidth(struct graphics_gc *gc, int width) {
+    graphics_batch_gc_changed(gc);
     gc->meth.gc_set_linewidth(gc->priv, graphics_dpi_scale(gc->gra, width));
 }
 
@@ -756,6 +1133,7 @@ void graphics_gc_set_dashes(struct graphics_gc *gc, int width, int offset, unsig
         for(a = 0; a < n; a ++) {
             dash_list_scaled[a]=graphics_dpi_scale(gc->gra,dash_list[a]);
         }
+        graphics_batch_gc_changed(gc);
         gc->meth.gc_set_dashes(gc->priv, graphics_dpi_scale(gc->gra,width), graphics_dpi_scale(gc->gra,offset),
                                dash_list_scaled, n);
     }
@@ -922,18 +1300,27 @@ static void image_new_helper(struct graphics *gra, struct graphics_image *this_,
  * @author Martin Schaller (04/2008)
 */
 struct graphics_image * graphics_image_new_scaled_rotated(struct graphics *gra, char *path, int w, int h, int rotate) {
+    struct graphics_image_cache *cache=gra->image_cache;
+    struct graphics_image_cached *cached;
     struct graphics_image *this_;
     char* hash_key = g_strdup_printf("%s*%d*%d*%d",path,w,h,rotate);
     struct file_wordexp *we;
     int i;
     char **paths;
-    if ( g_hash_table_lookup_extended( gra->image_cache_hash, hash_key, NULL, (gpointer)&this_) ) {
+    if ( g_hash_table_lookup_extended( cache->hash, hash_key, NULL, (gpointer)&cached) ) {
         g_free(hash_key);
-        dbg(lvl_debug,"Found cached image%sfor '%s'",this_?" ":" miss ",path);
-        return this_;
+        graphics_counters.image_hits++;
+        dbg(lvl_debug,"Found cached image%sfor '%s'",cached?" ":" miss ",path);
+        if (!cached)
+            return NULL;
+        if (!cached->refcount++)
+            graphics_image_cache_unlink(cache, cached);
+        return &cached->img;
     }
 
-    this_=g_new0(struct graphics_image,1);
+    graphics_counters.image_misses++;
+    cached=g_new0(struct graphics_image_cached,1);
+    this_=&cached->img;
     this_->height=h;
     this_->width=w;
 
@@ -1009,11 +1396,16 @@ struct graphics_image * graphics_image_new_scaled_rotated(struct graphics *gra,
 
     if (! this_->priv) {
         dbg(lvl_error,"No image for '%s'", path);
-        g_free(this_);
-        this_=NULL;
+        g_free(cached);
+        g_hash_table_insert(cache->hash, hash_key, NULL);
+        return NULL;
     }
 
-    g_hash_table_insert(gra->image_cache_hash, hash_key,  (gpointer)this_ );
+    cached->key=hash_key;
+    cached->refcount=1;
+    cached->size=this_->width > 0 && this_->height > 0 ? this_->width*this_->height*4 : 0;
+    cache->size+=cached->size;
+    g_hash_table_insert(cache->hash, hash_key, cached);
 
     return this_;
 }
@@ -1030,13 +1422,28 @@ struct graphics_image * graphics_image_new(struct graphics *gra, char *path) {
 }
 
 /**
- * FIXME
- * @param <>
- * @returns <>
- * @author Martin Schaller (04/2008)
+ * @brief Releases an image obtained from one of the {@code graphics_image_new} functions.
+ *
+ * The image stays in the cache of the graphics instance, and is only freed once the cache exceeds its size limit
+ * and the image is among the least recently used ones.
+ *
+ * @param gra the graphics instance
+ * @param img the image, may be NULL
 */
 void graphics_image_free(struct graphics *gra, struct graphics_image *img) {
-    /* Image is cached inside gra->image_cache_hash. So it would be freed only when graphics is destroyed => Do nothing here. */
+    struct graphics_image_cache *cache=gra->image_cache;
+    struct graphics_image_cached *cached=(struct graphics_image_cached *)img;
+    if (!cached || cached->refcount <= 0)
+        return;
+    if (--cached->refcount)
+        return;
+    cached->prev=cache->unused_last;
+    if (cache->unused_last)
+        cache->unused_last->next=cached;
+    else
+        cache->unused_first=cached;
+    cache->unused_last=cached;
+    graphics_image_cache_shrink(cache);
 }
 
 /**
@@ -1051,127 +1458,559 @@ void graphics_image_free(struct graphics *gra, struct graphics_image *img) {
  * @author Martin Schaller (04/2008)
 */
 void graphics_draw_mode(struct graphics *this_, enum draw_mode_num mode) {
+    if (mode != draw_mode_end)
+        this_->draw_count++;
+    graphics_batch_flush(this_);
     this_->meth.draw_mode(this_->priv, mode);
 }
 
-/**
- * FIXME
- * @param <>
- * @returns <>
- * @author Martin Schaller (04/2008)
-*/
-void graphics_draw_lines(struct graphics *this_, struct graphics_gc *gc, struct point *p, int count) {
-    struct point * p_scaled;
-    int a;
-    if(count < ALLOCA_COORD_LIMIT)
-        p_scaled = g_alloca(sizeof (struct point)* count);
-    else
-        p_scaled = g_malloc(sizeof (struct point)* count);
+static int graphics_phase_enabled;         /**< Number of users of the phase times */
+static int graphics_phase_timing_on;      /**< Whether {@code graphics_phase_timing()} has enabled timing */
+static enum graphics_phase graphics_phase_current;
+static struct timeval graphics_phase_start;
+static double graphics_phase_ms[graphics_phase_last];
+static double graphics_phase_base[graphics_phase_last];
 
-    for(a=0; a < count; a ++)
-        p_scaled[a] = graphics_dpi_scale_point(this_,&(p[a]));
-    this_->meth.draw_lines(this_->priv, gc->priv, p_scaled, count);
-    if(count >= ALLOCA_COORD_LIMIT)
-        g_free(p_scaled);
+/**
+ * @brief Charges the time since the last switch to the current phase
+ */
+static void graphics_phase_charge(void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    graphics_phase_ms[graphics_phase_current]+=(now.tv_sec-graphics_phase_start.tv_sec)*1000.0
+            +(now.tv_usec-graphics_phase_start.tv_usec)/1000.0;
+    graphics_phase_start=now;
 }
 
 /**
- * @brief Draw a circle
- * @param this_ The graphics instance on which to draw
- * @param gc The graphics context
- * @param p The coordinates of the center of the circle
- * @param r The radius of the circle
+ * @brief Adds or removes a user of the phase times
  *
- * @author Martin Schaller (04/2008)
-*/
-void graphics_draw_circle(struct graphics *this_, struct graphics_gc *gc, struct point *p, int r) {
-    struct point *pnt;
-    int i=0;
-    if((r*4+64) < ALLOCA_COORD_LIMIT)
-        pnt=g_alloca(sizeof(struct point)*(r*4+64));
-    else
-        pnt=g_malloc(sizeof(struct point)*(r*4+64));
+ * The times are only measured while there is at least one user, and only ever increase.
+ */
+static void graphics_phase_use(int use) {
+    if (use && !graphics_phase_enabled)
+        gettimeofday(&graphics_phase_start, NULL);
+    graphics_phase_enabled+=use ? 1 : -1;
+}
 
-    if(this_->meth.draw_circle) {
-        struct point p_scaled;
-        p_scaled = graphics_dpi_scale_point(this_,p);
-        this_->meth.draw_circle(this_->priv, gc->priv, &p_scaled, graphics_dpi_scale(this_,r));
-    } else {
-        /* do not scale circle_to_points */
-        circle_to_points(p, r, 0, -1, 1026, pnt, &i, 1);
-        pnt[i] = pnt[0];
-        i++;
-        graphics_draw_lines(this_, gc, pnt, i);
+/**
+ * @brief Enables or disables measuring the time spent in each phase of drawing.
+ *
+ * Enabling resets all times to 0.
+ *
+ * @param enable true to enable, false to disable
+ */
+void graphics_phase_timing(int enable) {
+    int i;
+    if (enable) {
+        if (graphics_phase_enabled)
+            graphics_phase_charge();
+        for (i = 0 ; i < graphics_phase_last ; i++)
+            graphics_phase_base[i]=graphics_phase_ms[i];
     }
-    if((r*4+64) >= ALLOCA_COORD_LIMIT)
-        g_free(pnt);
+    if (!enable != !graphics_phase_timing_on)
+        graphics_phase_use(enable);
+    graphics_phase_timing_on=enable;
 }
 
 /**
- * FIXME
- * @param <>
- * @returns <>
- * @author Martin Schaller (04/2008)
-*/
-void graphics_draw_rectangle(struct graphics *this_, struct graphics_gc *gc, struct point *p, int w, int h) {
-    struct point p_scaled;
-    p_scaled = graphics_dpi_scale_point(this_,p);
-    this_->meth.draw_rectangle(this_->priv, gc->priv, &p_scaled, graphics_dpi_scale(this_,w), graphics_dpi_scale(this_,h));
+ * @brief Returns the time spent in each phase of drawing since timing was enabled.
+ *
+ * @param ms Receives the times in milliseconds, indexed by {@code enum graphics_phase}
+ */
+void graphics_phase_get(double *ms) {
+    int i;
+    for (i = 0 ; i < graphics_phase_last ; i++)
+        ms[i]=graphics_phase_ms[i]-graphics_phase_base[i];
 }
 
 /**
- * @brief Draw a plain polygon on the display
+ * @brief Switches to another phase of drawing, charging the time since the last switch to the current one.
  *
- * @param gra The graphics instance on which to draw
- * @param gc The graphics context
- * @param[in] pin An array of points forming the polygon
- * @param count_in The number of elements inside @p pin
+ * @param phase The new phase
+ * @return The previous phase, to be restored by the caller
  */
-static void graphics_draw_polygon(struct graphics *gra, struct graphics_gc *gc, struct point *pin, int count_in) {
-    if (! gra->meth.draw_polygon) {
+static enum graphics_phase graphics_phase_set(enum graphics_phase phase) {
+    enum graphics_phase ret=graphics_phase_current;
+    if (graphics_phase_enabled && phase != ret)
+        graphics_phase_charge();
+    graphics_phase_current=phase;
+    return ret;
+}
+
+static void graphics_frame_free_layers(struct graphics_frame *frame) {
+    int i;
+    for (i = 0 ; i < frame->layer_count ; i++)
+        g_free(frame->layers[i].name);
+    g_free(frame->layers);
+    frame->layers=NULL;
+    frame->layer_count=frame->layer_size=0;
+}
+
+static void graphics_frame_stats_free(struct graphics_frame_stats *stats) {
+    int i;
+    if (!stats)
         return;
-    } else {
-        struct point * pin_scaled;
-        int a;
-        if(count_in < ALLOCA_COORD_LIMIT)
-            pin_scaled =  g_alloca(sizeof (struct point)*count_in);
-        else
-            pin_scaled =  g_malloc(sizeof (struct point)*count_in);
+    for (i = 0 ; i < stats->size ; i++)
+        graphics_frame_free_layers(&stats->frame[i]);
+    g_free(stats->frame);
+    g_free(stats->report);
+    g_free(stats);
+    graphics_phase_use(0);
+}
 
-        for(a=0; a < count_in; a ++)
-            pin_scaled[a] = graphics_dpi_scale_point(gra,&(pin[a]));
-        gra->meth.draw_polygon(gra->priv, gc->priv, pin_scaled, count_in);
-        if(count_in >= ALLOCA_COORD_LIMIT)
-            g_free(pin_scaled);
-    }
+/**
+ * @brief Enables or disables collecting frame statistics
+ *
+ * @param gra The graphics instance
+ * @param size Number of frames to keep, 0 to disable. Changing the number discards the frames collected so far.
+ */
+static void graphics_frame_stats_set(struct graphics *gra, int size) {
+    if (size < 0)
+        size=0;
+    if (gra->frame_stats && gra->frame_stats->size == size)
+        return;
+    graphics_frame_stats_free(gra->frame_stats);
+    gra->frame_stats=NULL;
+    if (!size)
+        return;
+    gra->frame_stats=g_new0(struct graphics_frame_stats, 1);
+    gra->frame_stats->size=size;
+    gra->frame_stats->frame=g_new0(struct graphics_frame, size);
+    graphics_phase_use(1);
 }
 
 /**
- * @brief Draw a plain polygon with holes on the display
+ * @brief Starts the statistics of a frame of a displaylist
  *
- * @param gra The graphics instance on which to draw
- * @param gc The graphics context
- * @param[in] pin An array of points forming the polygon
- * @param count_in The number of elements inside @p pin
- * @param hole_count The number of hole polygons to cut out
- * @param pcount array of [hole_count] integers giving the number of
- *        points per hole
- * @param holes array of point arrays for the hole polygons
+ * Does nothing if the graphics doesn't collect statistics, or a frame is already in progress.
  */
-static void graphics_draw_polygon_with_holes(struct graphics *gra, struct graphics_gc *gc, struct point *pin,
-        int count_in, int hole_count, int* ccount, struct point **holes) {
-    if (! gra->meth.draw_polygon_with_holes) {
-        /* TODO: add attr to configure if polygons with holes should be drawn without
-         *       the holes if no graphics support for this is present.
-         */
-        graphics_draw_polygon(gra, gc, pin, count_in);
+static void graphics_frame_begin(struct graphics *gra, struct displaylist *dl, struct layout *l, int order) {
+    struct graphics_frame *frame=&dl->frame;
+    GList *lays;
+    int i;
+
+    if (!gra->frame_stats || dl->framing)
         return;
-    } else {
-        struct point * pin_scaled;
-        struct point ** holes_scaled;
-        int a;
-        int b;
-        if(count_in < ALLOCA_COORD_LIMIT) {
+    dl->framing=1;
+    graphics_phase_charge();
+    gettimeofday(&frame->start, NULL);
+    for (i = 0 ; i < graphics_phase_last ; i++)
+        frame->phase_ms[i]=graphics_phase_ms[i];
+    frame->counters=graphics_counters;
+    frame->order=order;
+    frame->items=frame->vertices=0;
+    for (i = 0 ; i < frame->layer_count ; i++)
+        frame->layers[i].items=frame->layers[i].vertices=0;
+    /* names are only copied again if the layers have changed */
+    for (lays=l ? l->layers : NULL, i=0 ; lays ; lays=g_list_next(lays), i++) {
+        struct layer *lay=lays->data;
+        if (i == frame->layer_size) {
+            frame->layer_size=frame->layer_size ? frame->layer_size*2 : 16;
+            frame->layers=g_renew(struct graphics_frame_layer, frame->layers, frame->layer_size);
+        }
+        if (i == frame->layer_count) {
+            frame->layers[i].name=NULL;
+            frame->layers[i].items=frame->layers[i].vertices=0;
+            frame->layer_count++;
+        }
+        if (!frame->layers[i].name || strcmp(frame->layers[i].name, lay->name ? lay->name : "")) {
+            g_free(frame->layers[i].name);
+            frame->layers[i].name=g_strdup(lay->name ? lay->name : "");
+        }
+    }
+    while (frame->layer_count > i)
+        g_free(frame->layers[--frame->layer_count].name);
+}
+
+/**
+ * @brief Ends the statistics of a frame of a displaylist and stores them in the ring buffer of the graphics
+ */
+static void graphics_frame_end(struct graphics *gra, struct displaylist *dl) {
+    struct graphics_frame_stats *stats=gra->frame_stats;
+    struct graphics_frame *frame=&dl->frame,*slot,tmp;
+    struct timeval now;
+    int i;
+
+    if (!dl->framing)
+        return;
+    dl->framing=0;
+    if (!stats)
+        return;
+    graphics_phase_charge();
+    gettimeofday(&now, NULL);
+    frame->total_ms=(now.tv_sec-frame->start.tv_sec)*1000.0+(now.tv_usec-frame->start.tv_usec)/1000.0;
+    for (i = 0 ; i < graphics_phase_last ; i++)
+        frame->phase_ms[i]=graphics_phase_ms[i]-frame->phase_ms[i];
+    frame->counters.image_hits=graphics_counters.image_hits-frame->counters.image_hits;
+    frame->counters.image_misses=graphics_counters.image_misses-frame->counters.image_misses;
+    frame->counters.poly_hits=graphics_counters.poly_hits-frame->counters.poly_hits;
+    frame->counters.poly_misses=graphics_counters.poly_misses-frame->counters.poly_misses;
+    frame->counters.tiles_reused=graphics_counters.tiles_reused-frame->counters.tiles_reused;
+    frame->counters.tiles_rendered=graphics_counters.tiles_rendered-frame->counters.tiles_rendered;
+    for (i = 0 ; i < frame->layer_count ; i++) {
+        frame->items+=frame->layers[i].items;
+        frame->vertices+=frame->layers[i].vertices;
+    }
+    /* swap with the slot, so the layers allocated by either are reused */
+    slot=&stats->frame[stats->next];
+    tmp=*slot;
+    *slot=*frame;
+    *frame=tmp;
+    frame->dropped=0;
+    stats->next=(stats->next+1)%stats->size;
+    if (stats->count < stats->size)
+        stats->count++;
+    stats->frames++;
+}
+
+/**
+ * @brief Records that the load of a displaylist was cancelled before its frame was complete
+ */
+static void graphics_frame_drop(struct graphics *gra, struct displaylist *dl) {
+    if (!dl->framing)
+        return;
+    dl->framing=0;
+    dl->frame.dropped++;
+    if (gra->frame_stats)
+        gra->frame_stats->dropped++;
+}
+
+/**
+ * @brief Formats the frame statistics of a graphics instance as text
+ *
+ * The first line summarizes all frames kept, followed by a line for each frame, oldest first, and a line for each
+ * layer which has drawn something in it:
+ * {@code
+ * frames 120 dropped 3 kept 2 mean 31.20ms max 40.15ms
+ * frame 1697630000.250 order 14 total 22.25ms fetch 9.10ms transform 4.02ms clip 0.31ms draw 6.93ms items 2040 vertices 50211 images 12/0 polygons 40/2 tiles 12/0 dropped 0
+ *  layer polygons items 1500 vertices 40100
+ * }
+ * where the image, polygon and tile counts are cache hits and misses.
+ *
+ * @return The text, owned by the graphics instance and valid until the next call
+ */
+static char *graphics_frame_report(struct graphics *gra) {
+    struct graphics_frame_stats *stats=gra->frame_stats;
+    double sum=0,max=0;
+    char **lines;
+    int i,j,n=0,count=1;
+
+    for (i = 0 ; i < stats->count ; i++) {
+        struct graphics_frame *frame=&stats->frame[(stats->next-stats->count+i+stats->size)%stats->size];
+        sum+=frame->total_ms;
+        if (frame->total_ms > max)
+            max=frame->total_ms;
+        count++;
+        for (j = 0 ; j < frame->layer_count ; j++)
+            if (frame->layers[j].items)
+                count++;
+    }
+    /* the lines are joined once at the end, so the report takes time linear in its length */
+    lines=g_new(char *, count+1);
+    lines[n++]=g_strdup_printf("frames %u dropped %u kept %d mean %.2fms max %.2fms\n", stats->frames, stats->dropped,
+                               stats->count, stats->count ? sum/stats->count : 0, max);
+    for (i = 0 ; i < stats->count ; i++) {
+        struct graphics_frame *frame=&stats->frame[(stats->next-stats->count+i+stats->size)%stats->size];
+        double end=frame->start.tv_sec+frame->start.tv_usec/1000000.0+frame->total_ms/1000.0;
+        lines[n++]=g_strdup_printf("frame %.3f order %d total %.2fms fetch %.2fms"
+                                   " transform %.2fms clip %.2fms draw %.2fms items %d vertices %d images %d/%d polygons %d/%d tiles %d/%d"
+                                   " dropped %d\n", end, frame->order, frame->total_ms, frame->phase_ms[graphics_phase_fetch],
+                                   frame->phase_ms[graphics_phase_transform], frame->phase_ms[graphics_phase_clip],
+                                   frame->phase_ms[graphics_phase_draw], frame->items, frame->vertices, frame->counters.image_hits,
+                                   frame->counters.image_misses, frame->counters.poly_hits, frame->counters.poly_misses,
+                                   frame->counters.tiles_reused, frame->counters.tiles_rendered, frame->dropped);
+        for (j = 0 ; j < frame->layer_count ; j++) {
+            if (frame->layers[j].items)
+                lines[n++]=g_strdup_printf(" layer %s items %d vertices %d\n", frame->layers[j].name, frame->layers[j].items,
+                                           frame->layers[j].vertices);
+        }
+    }
+    lines[n]=NULL;
+    g_free(stats->report);
+    stats->report=g_strjoinv("", lines);
+    g_strfreev(lines);
+    return stats->report;
+}
+
+/**
+ * @brief Starts collecting lines, polygons and circles drawn with the same graphics context
+ *
+ * Instead of drawing them one by one, they are passed to the {@code draw_batch} method of the driver whenever the
+ * graphics context or the kind of drawing changes. Does nothing if the driver does not implement {@code draw_batch}.
+ *
+ * @param this_ The graphics instance
+ */
+void graphics_batch_begin(struct graphics *this_) {
+    if (!this_->meth.draw_batch)
+        return;
+    if (!this_->batch)
+        this_->batch=g_new0(struct graphics_batcher, 1);
+    this_->batch->active=1;
+}
+
+/**
+ * @brief Draws everything collected so far and stops collecting
+ *
+ * The buffers are kept for the next {@code graphics_batch_begin()}.
+ *
+ * @param this_ The graphics instance
+ */
+void graphics_batch_end(struct graphics *this_) {
+    graphics_batch_flush(this_);
+    if (this_->batch)
+        this_->batch->active=0;
+}
+
+static void graphics_batch_destroy(struct graphics *gra) {
+    struct graphics_batcher *batch=gra->batch;
+    if (!batch)
+        return;
+    g_free(batch->b.lines_len);
+    g_free(batch->b.lines);
+    g_free(batch->b.polygons_len);
+    g_free(batch->b.polygons);
+    g_free(batch->b.circles);
+    g_free(batch->b.circles_r);
+    g_free(batch);
+    gra->batch=NULL;
+}
+
+static void graphics_batch_flush(struct graphics *gra) {
+    struct graphics_batcher *batch=gra->batch;
+    enum graphics_phase phase;
+    if (!batch || !batch->gc)
+        return;
+    phase=graphics_phase_set(graphics_phase_draw);
+    gra->meth.draw_batch(gra->priv, batch->gc->priv, &batch->b);
+    graphics_phase_set(phase);
+    batch->gc=NULL;
+    batch->b.lines_count=batch->lines_points=0;
+    batch->b.polygons_count=batch->polygons_points=0;
+    batch->b.circles_count=0;
+}
+
+/**
+ * @brief Adds a polyline or polygon to the batch
+ *
+ * @param gra The graphics instance
+ * @param gc The graphics context to draw with
+ * @param polygon true for a polygon, false for a polyline
+ * @param p The points, already scaled to device pixels
+ * @param count The number of points
+ * @return true if added, false if not batching
+ */
+static int graphics_batch_add(struct graphics *gra, struct graphics_gc *gc, int polygon, struct point *p, int count) {
+    struct graphics_batcher *batch=gra->batch;
+    struct point **points;
+    int **len;
+    int *used,*size,*points_used,*points_size;
+    if (!batch || !batch->active)
+        return 0;
+    if (batch->gc != gc) {
+        graphics_batch_flush(gra);
+        batch->gc=gc;
+    }
+    if (polygon) {
+        points=&batch->b.polygons;
+        len=&batch->b.polygons_len;
+        used=&batch->b.polygons_count;
+        size=&batch->polygons_size;
+        points_used=&batch->polygons_points;
+        points_size=&batch->polygons_points_size;
+    } else {
+        points=&batch->b.lines;
+        len=&batch->b.lines_len;
+        used=&batch->b.lines_count;
+        size=&batch->lines_size;
+        points_used=&batch->lines_points;
+        points_size=&batch->lines_points_size;
+    }
+    if (*used >= *size) {
+        *size=*size ? *size*2 : 64;
+        *len=g_renew(int, *len, *size);
+    }
+    if (*points_used+count > *points_size) {
+        *points_size=MAX(*points_size*2, *points_used+count);
+        *points=g_renew(struct point, *points, *points_size);
+    }
+    memcpy(*points+*points_used, p, count*sizeof(*p));
+    *points_used+=count;
+    (*len)[(*used)++]=count;
+    return 1;
+}
+
+/**
+ * @brief Adds a circle to the batch
+ *
+ * @param gra The graphics instance
+ * @param gc The graphics context to draw with
+ * @param p The center, already scaled to device pixels
+ * @param r The radius, already scaled to device pixels
+ * @return true if added, false if not batching
+ */
+static int graphics_batch_add_circle(struct graphics *gra, struct graphics_gc *gc, struct point *p, int r) {
+    struct graphics_batcher *batch=gra->batch;
+    if (!batch || !batch->active)
+        return 0;
+    if (batch->gc != gc) {
+        graphics_batch_flush(gra);
+        batch->gc=gc;
+    }
+    if (batch->b.circles_count >= batch->circles_size) {
+        batch->circles_size=batch->circles_size ? batch->circles_size*2 : 64;
+        batch->b.circles=g_renew(struct point, batch->b.circles, batch->circles_size);
+        batch->b.circles_r=g_renew(int, batch->b.circles_r, batch->circles_size);
+    }
+    batch->b.circles[batch->b.circles_count]=*p;
+    batch->b.circles_r[batch->b.circles_count++]=r;
+    return 1;
+}
+
+/**
+ * FIXME
+ * @param <>
+ * @returns <>
+ * @author Martin Schaller (04/2008)
+*/
+void graphics_draw_lines(struct graphics *this_, struct graphics_gc *gc, struct point *p, int count) {
+    struct point * p_scaled;
+    int a;
+    enum graphics_phase phase;
+    if(count < ALLOCA_COORD_LIMIT)
+        p_scaled = g_alloca(sizeof (struct point)* count);
+    else
+        p_scaled = g_malloc(sizeof (struct point)* count);
+
+    for(a=0; a < count; a ++)
+        p_scaled[a] = graphics_dpi_scale_point(this_,&(p[a]));
+    if (!graphics_batch_add(this_, gc, 0, p_scaled, count)) {
+        phase=graphics_phase_set(graphics_phase_draw);
+        this_->meth.draw_lines(this_->priv, gc->priv, p_scaled, count);
+        graphics_phase_set(phase);
+    }
+    if(count >= ALLOCA_COORD_LIMIT)
+        g_free(p_scaled);
+}
+
+/**
+ * @brief Draw a circle
+ * @param this_ The graphics instance on which to draw
+ * @param gc The graphics context
+ * @param p The coordinates of the center of the circle
+ * @param r The radius of the circle
+ *
+ * @author Martin Schaller (04/2008)
+*/
+void graphics_draw_circle(struct graphics *this_, struct graphics_gc *gc, struct point *p, int r) {
+    struct point *pnt;
+    int i=0;
+    if((r*4+64) < ALLOCA_COORD_LIMIT)
+        pnt=g_alloca(sizeof(struct point)*(r*4+64));
+    else
+        pnt=g_malloc(sizeof(struct point)*(r*4+64));
+
+    if(this_->meth.draw_circle) {
+        struct point p_scaled;
+        enum graphics_phase phase;
+        p_scaled = graphics_dpi_scale_point(this_,p);
+        if (!graphics_batch_add_circle(this_, gc, &p_scaled, graphics_dpi_scale(this_,r))) {
+            phase=graphics_phase_set(graphics_phase_draw);
+            this_->meth.draw_circle(this_->priv, gc->priv, &p_scaled, graphics_dpi_scale(this_,r));
+            graphics_phase_set(phase);
+        }
+    } else {
+        /* do not scale circle_to_points */
+        circle_to_points(p, r, 0, -1, 1026, pnt, &i, 1);
+        pnt[i] = pnt[0];
+        i++;
+        graphics_draw_lines(this_, gc, pnt, i);
+    }
+    if((r*4+64) >= ALLOCA_COORD_LIMIT)
+        g_free(pnt);
+}
+
+/**
+ * FIXME
+ * @param <>
+ * @returns <>
+ * @author Martin Schaller (04/2008)
+*/
+void graphics_draw_rectangle(struct graphics *this_, struct graphics_gc *gc, struct point *p, int w, int h) {
+    struct point p_scaled;
+    enum graphics_phase phase;
+    p_scaled = graphics_dpi_scale_point(this_,p);
+    graphics_batch_flush(this_);
+    phase=graphics_phase_set(graphics_phase_draw);
+    this_->meth.draw_rectangle(this_->priv, gc->priv, &p_scaled, graphics_dpi_scale(this_,w), graphics_dpi_scale(this_,h));
+    graphics_phase_set(phase);
+}
+
+/**
+ * @brief Draw a plain polygon on the display
+ *
+ * @param gra The graphics instance on which to draw
+ * @param gc The graphics context
+ * @param[in] pin An array of points forming the polygon
+ * @param count_in The number of elements inside @p pin
+ */
+static void graphics_draw_polygon(struct graphics *gra, struct graphics_gc *gc, struct point *pin, int count_in) {
+    if (! gra->meth.draw_polygon) {
+        return;
+    } else {
+        struct point * pin_scaled;
+        int a;
+        enum graphics_phase phase;
+        if(count_in < ALLOCA_COORD_LIMIT)
+            pin_scaled =  g_alloca(sizeof (struct point)*count_in);
+        else
+            pin_scaled =  g_malloc(sizeof (struct point)*count_in);
+
+        for(a=0; a < count_in; a ++)
+            pin_scaled[a] = graphics_dpi_scale_point(gra,&(pin[a]));
+        if (!graphics_batch_add(gra, gc, 1, pin_scaled, count_in)) {
+            phase=graphics_phase_set(graphics_phase_draw);
+            gra->meth.draw_polygon(gra->priv, gc->priv, pin_scaled, count_in);
+            graphics_phase_set(phase);
+        }
+        if(count_in >= ALLOCA_COORD_LIMIT)
+            g_free(pin_scaled);
+    }
+}
+
+/**
+ * @brief Draw a plain polygon with holes on the display
+ *
+ * @param gra The graphics instance on which to draw
+ * @param gc The graphics context
+ * @param[in] pin An array of points forming the polygon
+ * @param count_in The number of elements inside @p pin
+ * @param hole_count The number of hole polygons to cut out
+ * @param pcount array of [hole_count] integers giving the number of
+ *        points per hole
+ * @param holes array of point arrays for the hole polygons
+ */
+static void graphics_draw_polygon_with_holes(struct graphics *gra, struct graphics_gc *gc, struct point *pin,
+        int count_in, int hole_count, int* ccount, struct point **holes) {
+    if (! gra->meth.draw_polygon_with_holes) {
+        /* TODO: add attr to configure if polygons with holes should be drawn without
+         *       the holes if no graphics support for this is present.
+         */
+        graphics_draw_polygon(gra, gc, pin, count_in);
+        return;
+    } else if (gra->dpi_factor == 1) {
+        enum graphics_phase phase;
+        graphics_batch_flush(gra);
+        phase=graphics_phase_set(graphics_phase_draw);
+        gra->meth.draw_polygon_with_holes(gra->priv, gc->priv, pin, count_in, hole_count, ccount, holes);
+        graphics_phase_set(phase);
+    } else {
+        struct point * pin_scaled;
+        struct point ** holes_scaled;
+        int a;
+        int b;
+        enum graphics_phase phase;
+        if(count_in < ALLOCA_COORD_LIMIT) {
             pin_scaled = g_alloca(sizeof (struct point)*count_in);
         } else {
             pin_scaled = g_malloc(sizeof (struct point)*count_in);
@@ -1190,7 +2029,10 @@ static void graphics_draw_polygon_with_holes(struct graphics *gra, struct graphi
             for(a=0; a < ccount[b]; a ++)
                 holes_scaled[b][a] = graphics_dpi_scale_point(gra,&(holes[b][a]));
         }
+        graphics_batch_flush(gra);
+        phase=graphics_phase_set(graphics_phase_draw);
         gra->meth.draw_polygon_with_holes(gra->priv, gc->priv, pin_scaled, count_in, hole_count, ccount, holes_scaled);
+        graphics_phase_set(phase);
         /* free the hole arrays */
         for(b=0; b < hole_count; b ++)
             g_free(holes_scaled[b]);
@@ -1238,8 +2080,12 @@ void graphics_draw_rectangle_rounded(struct graphics *this_, struct graphics_gc
 void graphics_draw_text(struct graphics *this_, struct graphics_gc *gc1, struct graphics_gc *gc2,
                         struct graphics_font *font, char *text, struct point *p, int dx, int dy) {
     struct point p_scaled;
+    enum graphics_phase phase;
     p_scaled = graphics_dpi_scale_point(this_,p);
+    graphics_batch_flush(this_);
+    phase=graphics_phase_set(graphics_phase_draw);
     this_->meth.draw_text(this_->priv, gc1->priv, gc2 ? gc2->priv : NULL, font->priv, text, &p_scaled, dx, dy);
+    graphics_phase_set(phase);
 }
 
 
@@ -1282,8 +2128,12 @@ int  graphics_is_disabled(struct graphics *this_) {
 */
 void graphics_draw_image(struct graphics *this_, struct graphics_gc *gc, struct point *p, struct graphics_image *img) {
     struct point p_scaled;
+    enum graphics_phase phase;
     p_scaled = graphics_dpi_scale_point(this_,p);
+    graphics_batch_flush(this_);
+    phase=graphics_phase_set(graphics_phase_draw);
     this_->meth.draw_image(this_->priv, gc->priv, &p_scaled, img->priv);
+    graphics_phase_set(phase);
 }
 
 /**
@@ -1297,6 +2147,7 @@ static void graphics_draw_image_warp(struct graphics *this_, struct graphics_gc
     if(this_->meth.draw_image_warp) {
         struct point * p_scaled;
         int a;
+        enum graphics_phase phase;
         if(count < ALLOCA_COORD_LIMIT)
             p_scaled =  g_alloca(sizeof (struct point)*count);
         else
@@ -1304,7 +2155,10 @@ static void graphics_draw_image_warp(struct graphics *this_, struct graphics_gc
 
         for(a=0; a < count; a ++)
             p_scaled[a] = graphics_dpi_scale_point(this_,&(p[a]));
+        graphics_batch_flush(this_);
+        phase=graphics_phase_set(graphics_phase_draw);
         this_->meth.draw_image_warp(this_->priv, gc->priv, p_scaled, count, img->priv);
+        graphics_phase_set(phase);
         if(count >= ALLOCA_COORD_LIMIT)
             g_free(p_scaled);
     } else {
@@ -1321,7 +2175,12 @@ int graphics_draw_drag(struct graphics *this_, struct point *p) {
     struct point p_scaled;
     if (!this_->meth.draw_drag)
         return 0;
+    if (this_->tiles)
+        graphics_tiles_drag(this_->tiles, p);
+    if (this_->dynamic)
+        graphics_dynamic_drag(this_->dynamic, p);
     p_scaled = graphics_dpi_scale_point(this_,p);
+    graphics_batch_flush(this_);
     this_->meth.draw_drag(this_->priv, &p_scaled);
     return 1;
 }
@@ -1431,8 +2290,8 @@ struct displayitem_poly_holes {
  * The graphics item passes the ap items and other items with this structure
  * to the graphics drawing routines. The struct is only a stub. It is allocated
  * including "count -1" struct coord's following c[0], if "holes" not NULL, by a
- * polygon hole structure, and if label != NULL, a series of zero terminated
- * strings followed by another zero for label.
+ * polygon hole structure. If label != NULL, it points to the text of a
+ * {@code struct displaylist_label} shared with other displayitems.
 */
 struct displayitem {
     struct displayitem *next;
@@ -1441,10 +2300,123 @@ struct displayitem {
     struct displayitem_poly_holes * holes;
     int z_order;
     int flags;
+    int *significance; /**< Douglas-Peucker significance of each coordinate, computed on first use, NULL if not yet computed */
+    struct displayitem_poly_cache *poly_cache; /**< Screen geometry if the item is a polygon with holes, NULL if none */
+    int dynamic; /**< Whether the item is from a dynamic map, see {@code displaylist_map_is_static()} */
+    struct coord_rect bbox; /**< Bounding box of the coordinates */
     int count;
     struct coord c[0];
 };
 
+/**
+ * @brief Key of a {@code struct displaylist_label}
+ */
+struct displaylist_label_key {
+    struct map *map;    /**< Map the strings were read from if it requires charset conversion, NULL otherwise */
+    char *label;        /**< Label as read from the map, "" if none */
+    char *icon;         /**< Icon source as read from the map, "" if none */
+};
+
+/**
+ * @brief Label strings shared by all displayitems with the same label
+ *
+ * Labels are converted to UTF-8 once when first seen and then referenced by every displayitem using them,
+ * instead of being converted and copied for each item. An entry is freed with the last displayitem using it.
+ */
+struct displaylist_label {
+    struct displaylist_label_key key;
+    int refcount;       /**< Number of displayitems using this label */
+    char text[0];       /**< Label, followed by the icon source, both zero terminated and in UTF-8 */
+};
+
+static guint displaylist_label_hash(gconstpointer key) {
+    const struct displaylist_label_key *k=key;
+    return (g_str_hash(k->label)*31+g_str_hash(k->icon))^GPOINTER_TO_UINT(k->map);
+}
+
+static gboolean displaylist_label_equal(gconstpointer a, gconstpointer b) {
+    const struct displaylist_label_key *ka=a,*kb=b;
+    return ka->map == kb->map && !strcmp(ka->label, kb->label) && !strcmp(ka->icon, kb->icon);
+}
+
+/**
+ * @brief Returns the shared UTF-8 text of a label, converting it if it is not known yet.
+ *
+ * @param dl The displaylist
+ * @param m The map the strings were read from
+ * @param conv Whether the map requires charset conversion
+ * @param label The label as read from the map, may be NULL
+ * @param icon The icon source as read from the map, may be NULL
+ * @return The label followed by the icon source, to be released with {@code displaylist_label_release()}
+ */
+static char *displaylist_label_get(struct displaylist *dl, struct map *m, int conv, char *label, char *icon) {
+    struct displaylist_label_key key;
+    struct displaylist_label *l;
+    char *text[2];
+    int i,len[2],raw_len;
+
+    key.map=conv ? m : NULL;
+    key.label=label ? label : "";
+    key.icon=icon ? icon : "";
+    if (!dl->label_strings)
+        dl->label_strings=g_hash_table_new(displaylist_label_hash, displaylist_label_equal);
+    l=g_hash_table_lookup(dl->label_strings, &key);
+    if (l) {
+        l->refcount++;
+        return l->text;
+    }
+    text[0]=key.label;
+    text[1]=key.icon;
+    raw_len=0;
+    for (i = 0 ; i < 2 ; i++) {
+        if (conv) {
+            raw_len+=strlen(text[i])+1;
+            text[i]=map_convert_dup(map_convert_string_tmp(m, text[i]));
+        }
+        len[i]=strlen(text[i])+1;
+    }
+    l=g_malloc(sizeof(*l)+len[0]+len[1]+raw_len);
+    l->refcount=1;
+    l->key.map=key.map;
+    memcpy(l->text, text[0], len[0]);
+    memcpy(l->text+len[0], text[1], len[1]);
+    if (conv) {
+        for (i = 0 ; i < 2 ; i++)
+            map_convert_free(text[i]);
+        l->key.label=l->text+len[0]+len[1];
+        strcpy(l->key.label, key.label);
+        l->key.icon=l->key.label+strlen(key.label)+1;
+        strcpy(l->key.icon, key.icon);
+    } else {
+        l->key.label=l->text;
+        l->key.icon=l->text+len[0];
+    }
+    g_hash_table_insert(dl->label_strings, &l->key, l);
+    return l->text;
+}
+
+/**
+ * @brief Releases a label obtained from {@code displaylist_label_get()}
+ */
+static void displaylist_label_release(struct displaylist *dl, char *text) {
+    struct displaylist_label *l=(struct displaylist_label *)(text-offsetof(struct displaylist_label, text));
+    if (--l->refcount)
+        return;
+    g_hash_table_remove(dl->label_strings, &l->key);
+    g_free(l);
+}
+
+/**
+ * @brief Frees a displayitem along with its cached data.
+ */
+static void displayitem_free(struct displaylist *dl, struct displayitem *di) {
+    if (di->label)
+        displaylist_label_release(dl, di->label);
+    g_free(di->significance);
+    g_free(di->poly_cache);
+    g_free(di);
+}
+
 /**
  * FIXME
  * @param <>
@@ -1453,11 +2425,13 @@ struct displayitem {
 */
 static void xdisplay_free(struct displaylist *dl) {
     int i;
+    displaylist_grid_free(dl);
+    dl->static_seq++;
     for (i = 0 ; i < HASH_SIZE ; i++) {
         struct displayitem *di=dl->hash_entries[i].di;
         while (di) {
             struct displayitem *next=di->next;
-            g_free(di);
+            displayitem_free(dl, di);
             di=next;
         }
         dl->hash_entries[i].di=NULL;
@@ -1465,78 +2439,232 @@ static void xdisplay_free(struct displaylist *dl) {
 }
 
 /**
- * @brief add the holes structure into preallocated area after displayitem
+ * @brief Checks whether the items of a map can be kept in the displaylist across loads.
  *
- * @param item to extract holes from
- * @param hole_count precounted number of holes
- * @param p changeable pointer to buffer. Advanced by the size used
- * @returns pointer to newly created holes structure
+ * This is the case for local binfile maps, whose contents do not change while navit is running. Items of
+ * all other maps are fetched again on every load.
  */
-static inline struct displayitem_poly_holes *  display_add_holes(struct item *item,int hole_count,  char ** p) {
+static int displaylist_map_is_static(struct map *m) {
     struct attr attr;
-    struct displayitem_poly_holes* holes;
-    holes=(struct displayitem_poly_holes *) *p;
-    *p+=sizeof(*holes);
-    holes->count=0;
-    holes->ccount = (int *) *p;
-    *p+=hole_count * sizeof(int);
-    holes->coords = (struct coord **)*p;
-    *p+=hole_count * sizeof(struct coord *);
-    item_attr_rewind(item);
-    while(item_attr_get(item, attr_poly_hole, &attr)) {
-        holes->coords[holes->count] = (struct coord *)*p;
-        holes->ccount[holes->count] = attr.u.poly_hole->coord_count;
-        memcpy(holes->coords[holes->count], attr.u.poly_hole->coord, holes->ccount[holes->count] * sizeof(struct coord));
-        *p += holes->ccount[holes->count] * sizeof(struct coord);
-        holes->count ++;
-    }
-    return holes;
+    if (!map_get_attr(m, attr_type, &attr, NULL) || !attr.u.str || strcmp(attr.u.str, "binfile"))
+        return 0;
+    return !map_get_attr(m, attr_url, &attr, NULL);
 }
 
-/**
- * FIXME
- * @param <>
- * @returns <>
- * @author Martin Schaller (04/2008)
-*/
-static void display_add(struct hash_entry *entry, struct item *item, int count, struct coord *c, char **label,
-                        int label_count) {
-    struct displayitem *di;
-    int len,i;
-    char *p;
-    struct attr attr;
-    int hole_count=0;
-    int hole_total_coords=0;
-    int holes_length;
-    int flags=0;
+static int displayitem_intersects_selection(struct displayitem *di, struct map_selection *sel) {
+    struct coord_rect r;
+    int i;
 
-    /* calculate number of bytes required */
-    /* own length */
-    len=sizeof(*di)+count*sizeof(*c);
-    /* add length of lables including closing zero */
-    if (label && label_count) {
-        for (i = 0 ; i < label_count ; i++) {
-            if (label[i])
-                len+=strlen(label[i])+1;
-            else
-                len++;
-        }
-    }
-    /* check for and remember flags (for underground drawing) */
-    item_attr_rewind(item);
-    if(item_attr_get(item, attr_flags, &attr)) {
-        flags = attr.u.num;
-    }
-    /* add length for holes */
-    item_attr_rewind(item);
-    while(item_attr_get(item, attr_poly_hole, &attr)) {
-        hole_count ++;
-        hole_total_coords += attr.u.poly_hole->coord_count;
+    if (!di->count)
+        return 0;
+    r.lu=r.rl=di->c[0];
+    for (i = 1 ; i < di->count ; i++)
+        coord_rect_extend(&r, &di->c[i]);
+    while (sel) {
+        if (coord_rect_overlap(&r, &sel->u.c_rect))
+            return 1;
+        sel=sel->next;
     }
-    holes_length = sizeof(struct displayitem_poly_holes) + hole_count * sizeof(int) + hole_count * sizeof(
-                       struct coord *) + hole_total_coords * sizeof(struct coord);
-    if(hole_count > 0)
-        dbg(lvl_debug,"got %d holes with %d coords total", hole_count, hole_total_coords);
+    return 0;
+}
+
+/**
+ * @brief Keeps the items of the last load which are still needed for a new one and frees all others.
+ *
+ * Items of static maps (see {@code displaylist_map_is_static()}) which intersect the new selection and whose type
+ * is still drawn by the layout at the new order are kept and remembered in {@code dl->reused}, so {@code do_draw()}
+ * doesn't have to build them again. The hash is switched to the new order, which may place the types differently.
+ *
+ * @param dl The displaylist
+ * @param ms The mapset to be loaded
+ * @param sel The selection to be loaded, in the projection of the transformation
+ * @param order The order to be loaded
+ * @return True if the types drawn at the new order were all drawn at the old one, so no type is missing from the
+ * kept items
+ */
+static int displaylist_reuse_items(struct displaylist *dl, struct mapset *ms, struct map_selection *sel, int order) {
+    GHashTable *static_maps=g_hash_table_new(g_direct_hash, g_direct_equal);
+    struct mapset_handle *msh=mapset_open(ms);
+    struct layout_compiled *lc=layout_get_compiled(dl->layout, order);
+    struct displayitem *kept_items=NULL,**kept_tail=&kept_items,**tails[HASH_SIZE];
+    struct map *m;
+    int i,covered=1,kept=0,freed=0;
+
+    while ((m=mapset_next(msh, 1)))
+        if (displaylist_map_is_static(m))
+            g_hash_table_insert(static_maps, m, m);
+    mapset_close(msh);
+    for (i = 0 ; i < lc->slot_count ; i++)
+        if (!get_hash_entry(dl, lc->slots[i].type))
+            covered=0;
+    dl->reused=item_hash_new();
+    displaylist_grid_free(dl);
+    /* take the candidates out of the hash, keeping their order */
+    for (i = 0 ; i < HASH_SIZE ; i++) {
+        struct displayitem *di=dl->hash_entries[i].di;
+        dl->hash_entries[i].di=NULL;
+        while (di) {
+            struct displayitem *next=di->next;
+            if (g_hash_table_lookup(static_maps, di->item.map) && displayitem_intersects_selection(di, sel)) {
+                *kept_tail=di;
+                kept_tail=&di->next;
+            } else {
+                if (!di->dynamic)
+                    dl->static_seq++;
+                displayitem_free(dl, di);
+                freed++;
+            }
+            di=next;
+        }
+    }
+    *kept_tail=NULL;
+    g_hash_table_destroy(static_maps);
+    dl->order=order;
+    displaylist_update_hash(dl);
+    dl->order_hashed=dl->order;
+    dl->layout_hashed=dl->layout;
+    for (i = 0 ; i < HASH_SIZE ; i++)
+        tails[i]=&dl->hash_entries[i].di;
+    while (kept_items) {
+        struct displayitem *di=kept_items;
+        struct hash_entry *entry=get_hash_entry(dl, di->item.type);
+        kept_items=di->next;
+        if (!entry) {
+            if (!di->dynamic)
+                dl->static_seq++;
+            displayitem_free(dl, di);
+            freed++;
+            continue;
+        }
+        di->next=NULL;
+        *tails[entry-dl->hash_entries]=di;
+        tails[entry-dl->hash_entries]=&di->next;
+        item_hash_insert(dl->reused, &di->item, di);
+        displaylist_grid_add(dl, di);
+        kept++;
+    }
+    dbg(lvl_debug,"kept %d items, freed %d", kept, freed);
+    return covered;
+}
+
+/**
+ * @brief Returns the parts of a selection not covered by another one.
+ *
+ * @param sel The selection
+ * @param covered The selection to remove from {@code sel}
+ * @return A new selection, NULL if {@code covered} covers all of {@code sel}
+ */
+static struct map_selection *displaylist_selection_subtract(struct map_selection *sel, struct map_selection *covered) {
+    struct map_selection *ret=map_selection_dup(sel);
+
+    while (covered) {
+        struct coord_rect *o=&covered->u.c_rect;
+        struct map_selection *in=ret,*next;
+        ret=NULL;
+        for ( ; in ; in=next) {
+            struct coord_rect n=in->u.c_rect;
+            struct coord_rect parts[4];
+            int count=0,top,bottom,j;
+            next=in->next;
+            if (!coord_rect_overlap(&n, o)) {
+                in->next=ret;
+                ret=in;
+                continue;
+            }
+            top=n.lu.y < o->lu.y ? n.lu.y : o->lu.y;
+            bottom=n.rl.y > o->rl.y ? n.rl.y : o->rl.y;
+            if (n.lu.y > o->lu.y) {
+                parts[count]=n;
+                parts[count++].rl.y=o->lu.y;
+            }
+            if (n.rl.y < o->rl.y) {
+                parts[count]=n;
+                parts[count++].lu.y=o->rl.y;
+            }
+            if (n.lu.x < o->lu.x) {
+                parts[count].lu.x=n.lu.x;
+                parts[count].rl.x=o->lu.x;
+                parts[count].lu.y=top;
+                parts[count++].rl.y=bottom;
+            }
+            if (n.rl.x > o->rl.x) {
+                parts[count].lu.x=o->rl.x;
+                parts[count].rl.x=n.rl.x;
+                parts[count].lu.y=top;
+                parts[count++].rl.y=bottom;
+            }
+            for (j = 0 ; j < count ; j++) {
+                struct map_selection *part=g_new(struct map_selection, 1);
+                *part=*in;
+                part->u.c_rect=parts[j];
+                part->next=ret;
+                ret=part;
+            }
+            g_free(in);
+        }
+        covered=covered->next;
+    }
+    return ret;
+}
+
+/**
+ * @brief add the holes structure into preallocated area after displayitem
+ *
+ * @param holes the poly_hole attributes of the item
+ * @param hole_count number of holes
+ * @param p changeable pointer to buffer. Advanced by the size used
+ * @returns pointer to newly created holes structure
+ */
+static inline struct displayitem_poly_holes *display_add_holes(struct attr *holes, int hole_count, char ** p) {
+    struct displayitem_poly_holes* ret;
+    int i;
+    ret=(struct displayitem_poly_holes *) *p;
+    *p+=sizeof(*ret);
+    ret->count=hole_count;
+    ret->ccount = (int *) *p;
+    *p+=hole_count * sizeof(int);
+    ret->coords = (struct coord **)*p;
+    *p+=hole_count * sizeof(struct coord *);
+    for (i = 0 ; i < hole_count ; i++) {
+        ret->coords[i] = (struct coord *)*p;
+        ret->ccount[i] = holes[i].u.poly_hole->coord_count;
+        memcpy(ret->coords[i], holes[i].u.poly_hole->coord, ret->ccount[i] * sizeof(struct coord));
+        *p += ret->ccount[i] * sizeof(struct coord);
+    }
+    return ret;
+}
+
+/**
+ * @brief Adds an item to a hash entry of the displaylist
+ *
+ * @param entry The hash entry for the type of the item
+ * @param item The item, only type, ids and map are used
+ * @param count Number of coordinates
+ * @param c The coordinates
+ * @param label The label, owned by the displaylist, or NULL
+ * @param flags The flags attribute of the item
+ * @param holes The poly_hole attributes of the item
+ * @param hole_count Number of entries in holes
+ * @return The new displayitem
+ */
+static struct displayitem *display_add(struct hash_entry *entry, struct item *item, int count, struct coord *c,
+                                        char *label, int flags, struct attr *holes, int hole_count) {
+    struct displayitem *di;
+    int len,i;
+    char *p;
+    int hole_total_coords=0;
+    int holes_length;
+
+    /* calculate number of bytes required */
+    /* own length */
+    len=sizeof(*di)+count*sizeof(*c);
+    /* add length for holes */
+    for (i = 0 ; i < hole_count ; i++)
+        hole_total_coords += holes[i].u.poly_hole->coord_count;
+    holes_length = sizeof(struct displayitem_poly_holes) + hole_count * sizeof(int) + hole_count * sizeof(
+                       struct coord *) + hole_total_coords * sizeof(struct coord);
+    if(hole_count > 0)
+        dbg(lvl_debug,"got %d holes with %d coords total", hole_count, hole_total_coords);
     len += holes_length;
 
     p=g_malloc(len);
@@ -1546,36 +2674,474 @@ static void display_add(struct hash_entry *entry, struct item *item, int count,
     di->item=*item;
     di->z_order=0;
     di->flags=flags;
+    di->significance=NULL;
+    di->poly_cache=NULL;
+    di->dynamic=0;
     di->holes=NULL;
     if(hole_count > 0) {
-        di->holes = display_add_holes(item, hole_count, &p);
-    }
-    if (label && label_count) {
-        di->label=p;
-        for (i = 0 ; i < label_count ; i++) {
-            if (label[i]) {
-                strcpy(p, label[i]);
-                p+=strlen(label[i])+1;
-            } else
-                *p++='\0';
-        }
-    } else
-        di->label=NULL;
+        di->holes = display_add_holes(holes, hole_count, &p);
+    }
+    di->label=label;
     di->count=count;
     memcpy(di->c, c, count*sizeof(*c));
+    if (count) {
+        int i;
+        di->bbox.lu=di->bbox.rl=c[0];
+        for (i = 1 ; i < count ; i++)
+            coord_rect_extend(&di->bbox, &c[i]);
+    } else
+        memset(&di->bbox, 0, sizeof(di->bbox));
     di->next=entry->di;
     entry->di=di;
+    return di;
 }
 
+/* number of buckets of the hit test grid, a power of 2 */
+#define HIT_GRID_BUCKETS 4096
+/* size of the cells of the hit test grid, in pixels at the scale of the first item added */
+#define HIT_GRID_CELL 64
+/* items covering more cells than this are not put into cells, but checked by every query */
+#define HIT_GRID_MAX_CELLS 16
+
+struct displaylist_grid_bucket {
+    int count,size;
+    struct displayitem **items;
+};
 
 /**
- * FIXME
- * @param <>
- * @returns <>
- * @author Martin Schaller (04/2008)
-*/
-static void label_line(struct graphics *gra, struct graphics_gc *fg, struct graphics_gc *bg, struct graphics_font *font,
-                       struct point *p, int count, char *label) {
+ * @brief Index of the items of a displaylist for hit testing.
+ *
+ * A uniform grid in map coordinates, so it stays valid while the map is moved and can be filled while the items are
+ * loaded. Cells are hashed into a fixed number of buckets, an item is put into the buckets of all cells its bounding
+ * box covers.
+ */
+struct displaylist_grid {
+    int cell;                                               /**< Size of the cells in map units */
+    struct displaylist_grid_bucket buckets[HIT_GRID_BUCKETS];
+    struct displaylist_grid_bucket large;                   /**< Items covering too many cells */
+};
+
+static int displaylist_grid_index(int c, int cell) {
+    return c >= 0 ? c/cell : -((-c-1)/cell)-1;
+}
+
+static struct displaylist_grid_bucket *displaylist_grid_bucket(struct displaylist_grid *grid, int x, int y) {
+    return &grid->buckets[((unsigned int)x*73856093U ^ (unsigned int)y*19349663U) & (HIT_GRID_BUCKETS-1)];
+}
+
+static void displaylist_grid_bucket_add(struct displaylist_grid_bucket *bucket, struct displayitem *di) {
+    if (bucket->count == bucket->size) {
+        bucket->size=bucket->size ? bucket->size*2 : 8;
+        bucket->items=g_renew(struct displayitem *, bucket->items, bucket->size);
+    }
+    bucket->items[bucket->count++]=di;
+}
+
+/**
+ * @brief Returns the cells covered by a displayitem
+ *
+ * @return false if the item covers too many cells to be put into them
+ */
+static int displaylist_grid_cells(struct displaylist_grid *grid, struct displayitem *di, struct point_rect *r) {
+    r->lu.x=displaylist_grid_index(di->bbox.lu.x, grid->cell);
+    r->rl.x=displaylist_grid_index(di->bbox.rl.x, grid->cell);
+    r->lu.y=displaylist_grid_index(di->bbox.rl.y, grid->cell);
+    r->rl.y=displaylist_grid_index(di->bbox.lu.y, grid->cell);
+    return (long long)(r->rl.x-r->lu.x+1)*(r->rl.y-r->lu.y+1) <= HIT_GRID_MAX_CELLS;
+}
+
+/**
+ * @brief Adds a displayitem to the hit test index of a displaylist
+ */
+static void displaylist_grid_add(struct displaylist *dl, struct displayitem *di) {
+    struct displaylist_grid *grid=dl->grid;
+    struct point_rect r;
+    int x,y;
+
+    if (!di->count)
+        return;
+    if (!grid) {
+        grid=dl->grid=g_new0(struct displaylist_grid, 1);
+        grid->cell=MAX(1, transform_get_scale(dl->dc.trans)*HIT_GRID_CELL/16);
+    }
+    if (!displaylist_grid_cells(grid, di, &r)) {
+        displaylist_grid_bucket_add(&grid->large, di);
+        return;
+    }
+    for (x = r.lu.x ; x <= r.rl.x ; x++)
+        for (y = r.lu.y ; y <= r.rl.y ; y++)
+            displaylist_grid_bucket_add(displaylist_grid_bucket(grid, x, y), di);
+}
+
+static void displaylist_grid_free(struct displaylist *dl) {
+    int i;
+    if (!dl->grid)
+        return;
+    for (i = 0 ; i < HIT_GRID_BUCKETS ; i++)
+        g_free(dl->grid->buckets[i].items);
+    g_free(dl->grid->large.items);
+    g_free(dl->grid);
+    dl->grid=NULL;
+}
+
+
+/* size of the cells of the label occupancy grid, in pixels */
+#define LABEL_GRID_CELL 64
+
+/**
+ * @brief A label waiting for placement.
+ */
+struct label_candidate {
+    struct item item;               /**< Item the label belongs to, only type, ids and map are valid */
+    int seq;                        /**< Position in drawing order */
+    int placed_before;              /**< Whether a label of this item was placed in the previous frame */
+    struct graphics_font *font;
+    struct color fg,bg;             /**< Colors, bg.a is 0 if there is no background */
+    char *text;                     /**< Label text, owned by the displayitem */
+    struct point p;                 /**< Start of the baseline */
+    int dx,dy;                      /**< Direction of the baseline, as passed to graphics_draw_text() */
+    struct point box[4];            /**< Corners of the area covered by the label */
+};
+
+struct label_grid_cell {
+    int count,size;
+    int *placed;                    /**< Indices into {@code label_placement->placed} */
+};
+
+/**
+ * @brief Label placement state of a displaylist.
+ *
+ * Street and area labels are not drawn as their elements are processed. Instead they are collected as
+ * candidates while a frame is drawn and placed after the last layer, in order of priority. A label is
+ * only drawn if it does not overlap a label already placed, which is checked against a screen-space
+ * occupancy grid.
+ *
+ * Priority comes from label_priority(), which ranks streets by road class above other ways, areas and
+ * lines, and then from drawing order. If the transformation only moved since the previous frame, labels placed in that frame
+ * go first, so labels stay where they are while panning.
+ */
+struct label_placement {
+    struct label_candidate *candidates; /**< Candidates of the current frame */
+    int candidates_count,candidates_size;
+    struct point *placed;           /**< Boxes of the labels placed in the current frame, 4 points each */
+    int placed_count,placed_size;
+    struct label_grid_cell *cells;
+    int cells_x,cells_y,cells_size;
+    struct point_rect r;            /**< Screen area covered by the grid */
+    struct item_hash *placed_items; /**< Items with a label placed in the previous frame */
+    int scale,yaw,pitch,order;      /**< Transformation of the previous frame */
+};
+
+static void label_placement_destroy(struct label_placement *lp) {
+    int i;
+    if (!lp)
+        return;
+    for (i = 0 ; i < lp->cells_size ; i++)
+        g_free(lp->cells[i].placed);
+    g_free(lp->cells);
+    g_free(lp->candidates);
+    g_free(lp->placed);
+    if (lp->placed_items)
+        item_hash_destroy(lp->placed_items);
+    g_free(lp);
+}
+
+/**
+ * @brief Starts collecting the labels of a frame.
+ *
+ * @param dl The displaylist about to be drawn
+ * @param gra The graphics the frame is drawn on
+ * @param order The order of the frame
+ */
+static void label_placement_begin(struct displaylist *dl, struct graphics *gra, int order) {
+    struct label_placement *lp=dl->labels;
+    struct transformation *t=dl->dc.trans;
+    int i,size;
+
+    if (!lp) {
+        lp=g_new0(struct label_placement, 1);
+        dl->labels=lp;
+    }
+    if (lp->placed_items && (transform_get_scale(t) != lp->scale || transform_get_yaw(t) != lp->yaw
+                             || transform_get_pitch(t) != lp->pitch || order != lp->order)) {
+        item_hash_destroy(lp->placed_items);
+        lp->placed_items=NULL;
+    }
+    lp->scale=transform_get_scale(t);
+    lp->yaw=transform_get_yaw(t);
+    lp->pitch=transform_get_pitch(t);
+    lp->order=order;
+    lp->r=gra->r;
+    lp->cells_x=(lp->r.rl.x-lp->r.lu.x)/LABEL_GRID_CELL+1;
+    lp->cells_y=(lp->r.rl.y-lp->r.lu.y)/LABEL_GRID_CELL+1;
+    size=lp->cells_x*lp->cells_y;
+    if (size > lp->cells_size) {
+        lp->cells=g_renew(struct label_grid_cell, lp->cells, size);
+        memset(lp->cells+lp->cells_size, 0, (size-lp->cells_size)*sizeof(*lp->cells));
+        lp->cells_size=size;
+    }
+    for (i = 0 ; i < lp->cells_size ; i++)
+        lp->cells[i].count=0;
+    lp->candidates_count=0;
+    lp->placed_count=0;
+    dl->dc.labels=lp;
+}
+
+/**
+ * @brief Checks whether an axis of box {@code a} separates it from box {@code b}.
+ */
+static int label_box_separated(struct point *a, struct point *b) {
+    int i,j;
+    for (i = 0 ; i < 2 ; i++) {
+        double nx=a[i].y-a[i+1].y,ny=a[i+1].x-a[i].x;
+        double amin=0,amax=0,bmin=0,bmax=0;
+        for (j = 0 ; j < 4 ; j++) {
+            double pa=nx*a[j].x+ny*a[j].y,pb=nx*b[j].x+ny*b[j].y;
+            if (!j || pa < amin)
+                amin=pa;
+            if (!j || pa > amax)
+                amax=pa;
+            if (!j || pb < bmin)
+                bmin=pb;
+            if (!j || pb > bmax)
+                bmax=pb;
+        }
+        if (amax <= bmin || bmax <= amin)
+            return 1;
+    }
+    return 0;
+}
+
+static void label_box_cells(struct label_placement *lp, struct point *box, struct point_rect *cells) {
+    int i;
+    struct point_rect r;
+    r.lu=r.rl=box[0];
+    for (i = 1 ; i < 4 ; i++) {
+        r.lu.x=MIN(r.lu.x, box[i].x);
+        r.lu.y=MIN(r.lu.y, box[i].y);
+        r.rl.x=MAX(r.rl.x, box[i].x);
+        r.rl.y=MAX(r.rl.y, box[i].y);
+    }
+    cells->lu.x=MAX(0, (r.lu.x-lp->r.lu.x)/LABEL_GRID_CELL);
+    cells->lu.y=MAX(0, (r.lu.y-lp->r.lu.y)/LABEL_GRID_CELL);
+    cells->rl.x=MIN(lp->cells_x-1, (r.rl.x-lp->r.lu.x)/LABEL_GRID_CELL);
+    cells->rl.y=MIN(lp->cells_y-1, (r.rl.y-lp->r.lu.y)/LABEL_GRID_CELL);
+}
+
+/**
+ * @brief Places a label if it does not overlap any label placed before.
+ *
+ * @return true if the label was placed
+ */
+static int label_placement_try(struct label_placement *lp, struct point *box) {
+    struct point_rect cells;
+    int x,y,i,idx;
+
+    label_box_cells(lp, box, &cells);
+    for (y = cells.lu.y ; y <= cells.rl.y ; y++) {
+        for (x = cells.lu.x ; x <= cells.rl.x ; x++) {
+            struct label_grid_cell *cell=&lp->cells[y*lp->cells_x+x];
+            for (i = 0 ; i < cell->count ; i++) {
+                struct point *other=lp->placed+cell->placed[i]*4;
+                if (!label_box_separated(box, other) && !label_box_separated(other, box))
+                    return 0;
+            }
+        }
+    }
+    if (lp->placed_count == lp->placed_size) {
+        lp->placed_size=lp->placed_size ? lp->placed_size*2 : 64;
+        lp->placed=g_renew(struct point, lp->placed, lp->placed_size*4);
+    }
+    idx=lp->placed_count++;
+    memcpy(lp->placed+idx*4, box, sizeof(struct point)*4);
+    for (y = cells.lu.y ; y <= cells.rl.y ; y++) {
+        for (x = cells.lu.x ; x <= cells.rl.x ; x++) {
+            struct label_grid_cell *cell=&lp->cells[y*lp->cells_x+x];
+            if (cell->count == cell->size) {
+                cell->size=cell->size ? cell->size*2 : 4;
+                cell->placed=g_renew(int, cell->placed, cell->size);
+            }
+            cell->placed[cell->count++]=idx;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Returns the placement priority of the label of an item
+ *
+ * Streets rank by road class, followed by rivers and the remaining ways such as paths and tracks. Area labels
+ * and all other lines (height lines, power lines, ...) come last.
+ *
+ * @param item The item, only its type is used
+ * @return The priority, higher values are placed first
+ */
+static int label_priority(const struct item *item) {
+    switch (item->type) {
+    case type_highway_land:
+    case type_highway_city:
+    case type_street_n_lanes:
+        return 10;
+    case type_street_4_land:
+    case type_street_4_city:
+        return 9;
+    case type_street_3_land:
+    case type_street_3_city:
+        return 8;
+    case type_street_2_land:
+    case type_street_2_city:
+        return 7;
+    case type_street_1_land:
+    case type_street_1_city:
+    case type_ramp:
+        return 6;
+    case type_street_0:
+    case type_street_nopass:
+    case type_living_street:
+    case type_street_service:
+        return 5;
+    case type_water_river:
+    case type_water_canal:
+        return 4;
+    default:
+        break;
+    }
+    if (item_is_street(*item))
+        return 3;
+    if (item_is_poly_place(*item))
+        return 2;
+    return item_type_is_area(item->type) ? 1 : 0;
+}
+
+static int label_candidate_compare(const void *a, const void *b) {
+    const struct label_candidate *ca=a,*cb=b;
+    int pa,pb;
+    if (ca->placed_before != cb->placed_before)
+        return ca->placed_before ? -1 : 1;
+    pa=label_priority(&ca->item);
+    pb=label_priority(&cb->item);
+    if (pa != pb)
+        return pa > pb ? -1 : 1;
+    if (ca->seq != cb->seq)
+        return ca->seq < cb->seq ? -1 : 1;
+    return 0;
+}
+
+/**
+ * @brief Places and draws the labels collected since {@code label_placement_begin()}.
+ *
+ * @param dl The displaylist
+ * @param gra The graphics to draw on
+ */
+static void label_placement_flush(struct displaylist *dl, struct graphics *gra) {
+    struct label_placement *lp=dl->labels;
+    struct graphics_gc *fg=NULL,*bg=NULL;
+    struct color fg_color,bg_color;
+    int i,drawn=0,bg_set=0;
+
+    dl->dc.labels=NULL;
+    if (!lp)
+        return;
+    qsort(lp->candidates, lp->candidates_count, sizeof(*lp->candidates), label_candidate_compare);
+    if (lp->placed_items)
+        item_hash_destroy(lp->placed_items);
+    lp->placed_items=item_hash_new();
+    for (i = 0 ; i < lp->candidates_count ; i++) {
+        struct label_candidate *c=&lp->candidates[i];
+        if (!label_placement_try(lp, c->box))
+            continue;
+        if (!fg) {
+            fg=graphics_gc_new(gra);
+            bg=graphics_gc_new(gra);
+        }
+        if (!drawn || memcmp(&fg_color, &c->fg, sizeof(c->fg))) {
+            fg_color=c->fg;
+            graphics_gc_set_foreground(fg, &fg_color);
+        }
+        if (c->bg.a && (!bg_set || memcmp(&bg_color, &c->bg, sizeof(c->bg)))) {
+            bg_color=c->bg;
+            graphics_gc_set_foreground(bg, &bg_color);
+            bg_set=1;
+        }
+        graphics_draw_text(gra, fg, c->bg.a ? bg : NULL, c->font, c->text, &c->p, c->dx, c->dy);
+        if (!item_hash_lookup(lp->placed_items, &c->item))
+            item_hash_insert(lp->placed_items, &c->item, lp);
+        drawn++;
+    }
+    if (fg) {
+        graphics_gc_destroy(fg);
+        graphics_gc_destroy(bg);
+    }
+    dbg(lvl_debug,"placed %d of %d labels", drawn, lp->candidates_count);
+}
+
+/**
+ * @brief Draws a label along a line, or queues it for placement.
+ *
+ * @param dc The display context
+ * @param di The displayitem the label belongs to
+ * @param bg The background gc, NULL for none
+ * @param font The font to use
+ * @param p Start of the baseline
+ * @param dx Direction of the baseline, as passed to graphics_draw_text()
+ * @param dy Direction of the baseline, as passed to graphics_draw_text()
+ * @param tl Text length in pixels
+ * @param th Text height in pixels
+ */
+static void label_add(struct display_context *dc, struct displayitem *di, struct graphics_gc *bg,
+                      struct graphics_font *font, struct point *p, int dx, int dy, int tl, int th) {
+    struct label_placement *lp=dc->labels;
+    struct label_candidate *c;
+    /* baseline and upward vectors of the label, in pixels */
+    int ux=(long long)dx*tl/0x10000,uy=(long long)dy*tl/0x10000;
+    int nx=(long long)dy*th/0x10000,ny=-(long long)dx*th/0x10000;
+
+    if (!lp) {
+        graphics_draw_text(dc->gra, dc->gc, bg, font, di->label, p, dx, dy);
+        return;
+    }
+    if (lp->candidates_count == lp->candidates_size) {
+        lp->candidates_size=lp->candidates_size ? lp->candidates_size*2 : 64;
+        lp->candidates=g_renew(struct label_candidate, lp->candidates, lp->candidates_size);
+    }
+    c=&lp->candidates[lp->candidates_count];
+    c->item=di->item;
+    c->seq=lp->candidates_count++;
+    c->placed_before=lp->placed_items && item_hash_lookup(lp->placed_items, &di->item);
+    c->font=font;
+    c->fg=dc->e->color;
+    c->bg=dc->e->u.text.background_color;
+    if (!bg)
+        c->bg.a=0;
+    c->text=di->label;
+    c->p=*p;
+    c->dx=dx;
+    c->dy=dy;
+    /* leave a quarter of the text height below the baseline for descenders */
+    c->box[0].x=p->x-nx/4;
+    c->box[0].y=p->y-ny/4;
+    c->box[1].x=c->box[0].x+ux;
+    c->box[1].y=c->box[0].y+uy;
+    c->box[2].x=p->x+ux+nx;
+    c->box[2].y=p->y+uy+ny;
+    c->box[3].x=p->x+nx;
+    c->box[3].y=p->y+ny;
+}
+
+/**
+ * @brief Labels a line along each of its segments long enough to hold the label.
+ *
+ * @param dc The display context
+ * @param di The displayitem whose label to draw
+ * @param bg The background gc, NULL for none
+ * @param font The font to use
+ * @param p The points of the line, in screen coordinates
+ * @param count The number of points
+ */
+static void label_line(struct display_context *dc, struct displayitem *di, struct graphics_gc *bg,
+                       struct graphics_font *font, struct point *p, int count) {
+    struct graphics *gra=dc->gra;
+    char *label=di->label;
     int i,x,y,tl,tlm,th,thm,tlsq,l;
     float lsq;
     double dx,dy;
@@ -1616,7 +3182,7 @@ static void label_line(struct graphics *gra, struct graphics_gc *fg, struct grap
             p_t.x=x;
             p_t.y=y;
             if (x < gra->r.rl.x && x + tl > gra->r.lu.x && y + tl > gra->r.lu.y && y - tl < gra->r.rl.y)
-                graphics_draw_text(gra, fg, bg, font, label, &p_t, dx*0x10000/l, dy*0x10000/l);
+                label_add(dc, di, bg, font, &p_t, dx*0x10000/l, dy*0x10000/l, tl, th);
         }
     }
 }
@@ -2199,6 +3765,7 @@ void graphics_draw_polyline_clipped(struct graphics *gra, struct graphics_gc *gc
     int clip_result;
     int r_width, r_height;
     struct point_rect r=gra->r;
+    enum graphics_phase phase=graphics_phase_set(graphics_phase_clip);
 
     if(count < ALLOCA_COORD_LIMIT) {
         points_to_draw=g_alloca(sizeof(struct point)*(count+1));
@@ -2262,6 +3829,7 @@ void graphics_draw_polyline_clipped(struct graphics *gra, struct graphics_gc *gc
         g_free(points_to_draw);
         g_free(w);
     }
+    graphics_phase_set(phase);
 }
 
 static int is_inside(struct point *p, struct point_rect *r, int edge) {
@@ -2303,116 +3871,242 @@ static void poly_intersection(struct point *p1, struct point *p2, struct point_r
 }
 
 /**
- * @brief clip a polygon inside a rectangle
- *
- * This function clippes a given polygon inside a rectangle. It writes the result into provided buffer.
+ * @brief State of a streaming polygon clipper
  *
- * @param[in] r rectangle to clip into
- * @param[in] pin point array of input polygon
- * @param[in] count_in number of points in pin
- * @param[out] out preallocated buffer of at least count_in *8 +1 points size
- * @param[out] count_out size of out number of points, number of points used in out at return
- */
-static void graphics_clip_polygon(struct point_rect * r, struct point * in, int count_in, struct point *out,
-                                  int* count_out) {
-    /* get a temp buffer to store points after one direction clipping.
-     * since we are clipping 4 directions, result is always in out at the end*/
-    struct point *temp;
-    struct point *pout;
-    struct point *pin;
-    int edge;
-    int count;
+ * Each of the four stages clips against one edge of the rectangle and passes its output point by point to the
+ * next stage, so no intermediate buffers are needed.
+ */
+struct polygon_clipper {
+    struct point_rect *r;       /**< The rectangle to clip into */
+    struct point first[4];      /**< First point each stage has seen */
+    struct point prev[4];       /**< Last point each stage has seen */
+    int started[4];             /**< Whether each stage has seen a point yet */
+    int ready;                  /**< Number of leading stages that have seen a point */
+    int passed;                 /**< Number of leading stages the last point passed through, -1 if none */
+    int outcode;                /**< Outcode of the last point */
+    struct point *out;          /**< Output buffer */
+    int count;                  /**< Number of points written to {@code out} */
+};
 
-    /* sanity check */
-    if((r == NULL) || (in == NULL) || (out == NULL) || (count_out == NULL) || (*count_out < count_in*8+1)) {
+static void polygon_clipper_segment(struct polygon_clipper *c, int edge, struct point *s, struct point *p);
+
+/**
+ * @brief Feeds a point into a stage of the clipper
+ *
+ * @param c The clipper
+ * @param edge The stage, 4 means the point has passed all stages and is written out
+ * @param p The point
+ */
+static void polygon_clipper_add(struct polygon_clipper *c, int edge, struct point *p) {
+    if (edge == 4) {
+        c->out[c->count++]=*p;
         return;
     }
+    if (c->started[edge])
+        polygon_clipper_segment(c, edge, &c->prev[edge], p);
+    else {
+        c->first[edge]=*p;
+        c->started[edge]=1;
+        while (c->ready < 4 && c->started[c->ready])
+            c->ready++;
+    }
+    c->prev[edge]=*p;
+}
 
-    /* prepare buffers. We have two buffers that we flip over.
-     * 1. the output buffer
-     * 2. temp
-     */
-    if (count_in < ALLOCA_COORD_LIMIT) {
-        temp=g_alloca(sizeof(struct point) * (count_in < ALLOCA_COORD_LIMIT ? count_in*8+1:0));
-    } else {
-        /* too big. Allocate a buffer (slower) */
-        temp=g_new(struct point, count_in*8+1);
-    }
-    /* use temp as first buffer. So we get the final result in out*/
-    pout = temp;
-    /* start with input polygon */
-    pin=in;
-    /* start with number of points of source polygon*/
-    count=count_in;
-
-    /* clip all four directions of a rectangle */
-    for (edge = 0 ; edge < 4 ; edge++) {
-        int i;
-        /* p is first element in current buffer */
-        struct point *p=pin;
-        /* s is lasst element in current buffer */
-        struct point *s=pin+count-1;
-        /* nothing written yet */
-        *count_out=0;
-
-        /* iterate all points in current buffer */
-        for (i = 0 ; i < count ; i++) {
-            if (is_inside(p, r, edge)) {
-                if (! is_inside(s, r, edge)) {
-                    struct point pi;
-                    /* current segment crosses border from outside to inside. Add crossing point with border first */
-                    poly_intersection(s,p,r,edge,&pi);
-                    pout[(*count_out)++]=pi;
-                }
-                /* add point if inside */
-                pout[(*count_out)++]=*p;
-            } else {
-                if (is_inside(s, r, edge)) {
-                    struct point pi;
-                    /*current segment crosses border from inside to outside. Add crossing point with border */
-                    poly_intersection(p,s,r,edge,&pi);
-                    pout[(*count_out)++]=pi;
-                }
-                /* skip point if outside */
-            }
-            /* move one coordinate forward */
-            s=p;
-            p++;
+/**
+ * @brief Returns which edges of a rectangle a point is outside of
+ *
+ * @return A bit mask, with bit n set if the point is outside edge n as used by {@code is_inside()}
+ */
+static int polygon_clipper_outcode(struct point *p, struct point_rect *r) {
+    return (p->x < r->lu.x) | ((p->x > r->rl.x) << 1) | ((p->y < r->lu.y) << 2) | ((p->y > r->rl.y) << 3);
+}
+
+/**
+ * @brief Clips the segment from s to p against one edge, feeding the result into the next stage
+ */
+static void polygon_clipper_segment(struct polygon_clipper *c, int edge, struct point *s, struct point *p) {
+    struct point pi;
+    if (is_inside(p, c->r, edge)) {
+        if (! is_inside(s, c->r, edge)) {
+            /* segment crosses border from outside to inside. Add crossing point with border first */
+            poly_intersection(s,p,c->r,edge,&pi);
+            polygon_clipper_add(c, edge+1, &pi);
         }
-        /* use result of last clipping for next */
-        count=*count_out;
+        polygon_clipper_add(c, edge+1, p);
+    } else if (is_inside(s, c->r, edge)) {
+        /* segment crosses border from inside to outside. Add crossing point with border */
+        poly_intersection(p,s,c->r,edge,&pi);
+        polygon_clipper_add(c, edge+1, &pi);
+    }
+}
 
-        /* switch buffer */
-        if(pout == temp) {
-            pout=out;
-            pin=temp;
+/**
+ * @brief Feeds a run of points into the clipper
+ *
+ * Stages in which both the last and the current point lie inside just pass the current point on. So if the last
+ * point has reached the first stage where something happens, the current point is fed directly to it. Runs of
+ * points inside the rectangle, or outside the same edge, are handled without going through the stages at all.
+ *
+ * @param c The clipper
+ * @param p The points
+ * @param count The number of points in @p p
+ */
+static void polygon_clipper_feed(struct polygon_clipper *c, struct point *p, int count) {
+    static const char lowest_edge[16]= {4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0};
+    struct point *end=p+count;
+    while (p < end) {
+        int oc=polygon_clipper_outcode(p, c->r);
+        int either=oc|c->outcode;
+        int edge=either ? lowest_edge[either] : 4;
+        int passed=c->ready;
+        if (edge > c->passed)
+            polygon_clipper_add(c, 0, p);
+        else if (edge == 4) {
+            /* inside the rectangle, like the last point */
+            do {
+                c->out[c->count++]=*p++;
+            } while (p < end && !(oc=polygon_clipper_outcode(p, c->r)));
+            c->prev[0]=c->prev[1]=c->prev[2]=c->prev[3]=p[-1];
+            c->passed=passed;
+            c->outcode=0;
+            continue;
+        } else if (oc & c->outcode & (1 << edge)) {
+            /* outside the same edge as the last point, and inside all edges before it */
+            int mask=(2 << edge)-1,e;
+            while (p+1 < end && (polygon_clipper_outcode(p+1, c->r) & mask) == (1 << edge))
+                p++;
+            oc=polygon_clipper_outcode(p, c->r);
+            for (e = 0 ; e <= edge ; e++)
+                c->prev[e]=*p;
         } else {
-            pin=out;
-            pout=temp;
+            int e;
+            for (e = 0 ; e < edge ; e++)
+                c->prev[e]=*p;
+            polygon_clipper_add(c, edge, p);
         }
+        c->passed=passed;
+        c->outcode=oc;
+        p++;
     }
+}
 
-    /* have clipped poly in out. And number of points now in *count_out */
-
-    /* if we had to allocate the buffer, we need to free it */
-    if (count_in >= ALLOCA_COORD_LIMIT) {
-        g_free(temp);
+/**
+ * @brief Tests the bounding box of a polygon against a rectangle
+ *
+ * @param r The rectangle
+ * @param in The points of the polygon
+ * @param count The number of points in @p in
+ * @return 1 if the polygon is completely inside the rectangle, -1 if it is completely outside, 0 if it needs clipping
+ */
+static int graphics_polygon_bbox_test(struct point_rect *r, struct point *in, int count) {
+    struct point_rect bbox;
+    int i;
+    if (count <= 0)
+        return -1;
+    bbox.lu=bbox.rl=in[0];
+    for (i = 1 ; i < count ; i++) {
+        if (in[i].x < bbox.lu.x)
+            bbox.lu.x=in[i].x;
+        if (in[i].x > bbox.rl.x)
+            bbox.rl.x=in[i].x;
+        if (in[i].y < bbox.lu.y)
+            bbox.lu.y=in[i].y;
+        if (in[i].y > bbox.rl.y)
+            bbox.rl.y=in[i].y;
     }
-    return;
+    if (bbox.rl.x < r->lu.x || bbox.lu.x > r->rl.x || bbox.rl.y < r->lu.y || bbox.lu.y > r->rl.y)
+        return -1;
+    if (bbox.lu.x >= r->lu.x && bbox.rl.x <= r->rl.x && bbox.lu.y >= r->lu.y && bbox.rl.y <= r->rl.y)
+        return 1;
+    return 0;
 }
 
 /**
- * @brief Draw a plain polygon on the display
+ * @brief clip a polygon inside a rectangle
  *
- * @param gra The graphics instance on which to draw
- * @param gc The graphics context
- * @param[in] pin An array of points forming the polygon
- * @param count_in The number of elements inside @p pin
+ * This function clips a given polygon inside a rectangle. Polygons completely inside the rectangle are not
+ * copied, and polygons completely outside yield no points. All others are clipped in a single pass over
+ * the input, writing the result into the provided buffer.
+ *
+ * @param[in] r rectangle to clip into
+ * @param[in] in point array of input polygon
+ * @param[in] count_in number of points in in
+ * @param[out] out preallocated buffer of at least count_in *8 +1 points size
+ * @param[out] count_out size of out number of points, number of points in the result at return
+ * @return The clipped polygon, either {@code in} or {@code out}
+ */
+static struct point *graphics_clip_polygon(struct point_rect * r, struct point * in, int count_in, struct point *out,
+        int* count_out) {
+    struct polygon_clipper c;
+    int edge,test,start,seeded;
+
+    /* sanity check */
+    if((r == NULL) || (in == NULL) || (out == NULL) || (count_out == NULL) || (*count_out < count_in*8+1)) {
+        return out;
+    }
+    /* trivially reject polygons outside and accept those inside the rectangle */
+    test=graphics_polygon_bbox_test(r, in, count_in);
+    if (test) {
+        *count_out=test > 0 ? count_in : 0;
+        return test > 0 ? in : out;
+    }
+
+    memset(&c, 0, sizeof(c));
+    c.r=r;
+    c.out=out;
+    /* Start at a point inside the rectangle if there is one. Every stage would pass it on, so all of them can
+     * start with it, and it is written out when the polygon is closed. */
+    for (start = 0 ; start < count_in ; start++) {
+        if (!polygon_clipper_outcode(&in[start], r))
+            break;
+    }
+    if (start < count_in) {
+        for (edge = 0 ; edge < 4 ; edge++) {
+            c.first[edge]=c.prev[edge]=in[start];
+            c.started[edge]=1;
+        }
+        c.ready=4;
+        seeded=1;
+    } else {
+        start=0;
+        seeded=0;
+    }
+    c.passed=seeded ? 4 : -1;
+    polygon_clipper_feed(&c, in+start+seeded, count_in-start-seeded);
+    polygon_clipper_feed(&c, in, start);
+    /* Close the polygon in every stage, from the first to the last one. If all stages started with the same
+     * point, closing the first stage passes that point through all others, closing them as well. */
+    for (edge = 0 ; edge < (seeded ? 1 : 4) ; edge++) {
+        if (c.started[edge])
+            polygon_clipper_segment(&c, edge, &c.prev[edge], &c.first[edge]);
+    }
+    *count_out=c.count;
+    return out;
+}
+
+/**
+ * @brief Draw a plain polygon on the display
+ *
+ * @param gra The graphics instance on which to draw
+ * @param gc The graphics context
+ * @param[in] pin An array of points forming the polygon
+ * @param count_in The number of elements inside @p pin
  */
 void graphics_draw_polygon_clipped(struct graphics *gra, struct graphics_gc *gc, struct point *pin, int count_in) {
     struct point_rect r=gra->r;
     struct point *clipped;
     int count_out = count_in*8+1;
+    enum graphics_phase phase=graphics_phase_set(graphics_phase_clip);
+    int test=graphics_polygon_bbox_test(&r, pin, count_in);
+
+    /* no need for a buffer if the polygon is completely inside or outside */
+    if (test) {
+        if (test > 0)
+            graphics_draw_polygon(gra, gc, pin, count_in);
+        graphics_phase_set(phase);
+        return;
+    }
 
     /* prepare buffer */
     if (count_in < ALLOCA_COORD_LIMIT) {
@@ -2424,12 +4118,14 @@ void graphics_draw_polygon_clipped(struct graphics *gra, struct graphics_gc *gc,
     }
 
     graphics_clip_polygon(&r, pin, count_in, clipped, &count_out);
-    graphics_draw_polygon(gra, gc, clipped, count_out);
+    if (count_out)
+        graphics_draw_polygon(gra, gc, clipped, count_out);
 
     /* if we had to allocate buffer, free it */
     if (count_in >= ALLOCA_COORD_LIMIT) {
         g_free(clipped);
     }
+    graphics_phase_set(phase);
 }
 
 /**
@@ -2456,6 +4152,14 @@ static void graphics_draw_polygon_with_holes_clipped(struct graphics *gra, struc
     int *found_ccount;
     struct point ** found_holes;
     int need_free;
+    struct point *outer;
+    enum graphics_phase phase=graphics_phase_set(graphics_phase_clip);
+
+    /* nothing to draw if the outer polygon is not visible at all */
+    if (graphics_polygon_bbox_test(&r, pin, count_in) < 0) {
+        graphics_phase_set(phase);
+        return;
+    }
     /* get total node count for polygon plus all holes */
     total_count_in = count_in;
     for(i = 0; i < hole_count; i ++) {
@@ -2487,15 +4191,17 @@ static void graphics_draw_polygon_with_holes_clipped(struct graphics *gra, struc
     }
     found_hole_count=0;
 
-    /* clip outer polygon */
-    graphics_clip_polygon(&r, pin, count_in, clipped, &count_out);
-    count_used += count_out;
+    /* clip outer polygon, only using up buffer space if the result was copied there */
+    outer=graphics_clip_polygon(&r, pin, count_in, clipped, &count_out);
+    if (outer == clipped)
+        count_used += count_out;
     /* clip the holes */
     for (i=0; i < hole_count; i ++) {
         struct point* buffer = clipped + count_used;
         int count = total_count_in*8+1+hole_count - count_used;
-        graphics_clip_polygon(&r, holes[i], ccount[i], buffer, &count);
-        count_used +=count;
+        buffer=graphics_clip_polygon(&r, holes[i], ccount[i], buffer, &count);
+        if (buffer != holes[i])
+            count_used +=count;
         if(count > 0) {
             /* only if there are points left after clipping */
             found_ccount[found_hole_count]=count;
@@ -2504,7 +4210,8 @@ static void graphics_draw_polygon_with_holes_clipped(struct graphics *gra, struc
         }
     }
     /* call drawing function */
-    graphics_draw_polygon_with_holes(gra, gc, clipped, count_out, found_hole_count, found_ccount, found_holes);
+    if (count_out)
+        graphics_draw_polygon_with_holes(gra, gc, outer, count_out, found_hole_count, found_ccount, found_holes);
     if(hole_count >= ALLOCA_COORD_LIMIT) {
         g_free(found_ccount);
         g_free(found_holes);
@@ -2513,6 +4220,7 @@ static void graphics_draw_polygon_with_holes_clipped(struct graphics *gra, struc
     if (need_free) {
         g_free(clipped);
     }
+    graphics_phase_set(phase);
 }
 
 static void display_context_free(struct display_context *dc) {
@@ -2617,6 +4325,93 @@ static int limit_count(struct coord *c, int count) {
     return count;
 }
 
+/* items with fewer coordinates are always transformed in full */
+#define SIMPLIFY_MIN_COUNT 32
+
+static double displayitem_segment_dist(struct coord *c, struct coord *a, struct coord *b) {
+    double dx=b->x-a->x,dy=b->y-a->y,px=c->x-a->x,py=c->y-a->y,len=dx*dx+dy*dy,u;
+
+    if (len > 0) {
+        u=(px*dx+py*dy)/len;
+        if (u > 1)
+            u=1;
+        if (u > 0) {
+            px-=u*dx;
+            py-=u*dy;
+        }
+    }
+    return sqrt(px*px+py*py);
+}
+
+/**
+ * @brief Computes the significance of each coordinate of a displayitem.
+ *
+ * The significance of a coordinate is the distance (in map units) at which Douglas-Peucker simplification
+ * would drop it. It is capped at the significance of the coordinate which caused its segment to be split, so
+ * the coordinates kept for any tolerance always form the same polyline Douglas-Peucker would produce. The end
+ * points are never dropped.
+ */
+static int *displayitem_significance(struct displayitem *di) {
+    int *sig,*stack,sp=0,i;
+
+    sig=g_new(int, di->count);
+    stack=g_new(int, di->count*3);
+    for (i = 1 ; i < di->count-1 ; i++)
+        sig[i]=0;
+    sig[0]=sig[di->count-1]=INT_MAX;
+    stack[sp++]=0;
+    stack[sp++]=di->count-1;
+    stack[sp++]=INT_MAX;
+    while (sp) {
+        int cap=stack[--sp],last=stack[--sp],first=stack[--sp],idx=-1;
+        double max=-1;
+        for (i = first+1 ; i < last ; i++) {
+            double d=displayitem_segment_dist(&di->c[i], &di->c[first], &di->c[last]);
+            if (d > max) {
+                max=d;
+                idx=i;
+            }
+        }
+        if (idx < 0)
+            continue;
+        sig[idx]=max < cap ? (int)max : cap;
+        stack[sp++]=first;
+        stack[sp++]=idx;
+        stack[sp++]=sig[idx];
+        stack[sp++]=idx;
+        stack[sp++]=last;
+        stack[sp++]=sig[idx];
+    }
+    g_free(stack);
+    return sig;
+}
+
+/**
+ * @brief Drops the coordinates of a displayitem which would not be visible at the current scale.
+ *
+ * @param di The displayitem
+ * @param dc The display context, providing the transformation
+ * @param out Buffer of at least {@code di->count} coordinates receiving the result
+ * @return The number of coordinates in {@code out}, 0 if the item is to be drawn unsimplified
+ */
+static int displayitem_simplify(struct displayitem *di, struct display_context *dc, struct coord *out) {
+    int tolerance,count=0,i;
+
+    if (di->count < SIMPLIFY_MIN_COUNT || !dc->mindist || transform_get_pitch(dc->trans)
+            || dc->pro != transform_get_projection(dc->trans))
+        return 0;
+    /* half a pixel, transform_get_scale() returns map units per 16 pixels */
+    tolerance=transform_get_scale(dc->trans)/32;
+    if (tolerance < 1)
+        return 0;
+    if (!di->significance)
+        di->significance=displayitem_significance(di);
+    for (i = 0 ; i < di->count ; i++)
+        if (di->significance[i] > tolerance)
+            out[count++]=di->c[i];
+    return count;
+}
+
 /**
  * @brief Draw a multi-line text next to a specified point @p pref
  *
@@ -2722,6 +4517,96 @@ static void displayitem_free_holes(struct displayitem_poly_holes * holes) {
     }
 }
 
+/**
+ * @brief Screen geometry of a polygon with holes, kept across frames
+ *
+ * Without pitch, moving the map only shifts the screen coordinates of an item. So the outline and holes are transformed
+ * and simplified once, and then only shifted, as long as scale, orientation, projections and minimum point distance
+ * stay the same.
+ */
+struct displayitem_poly_cache {
+    long scale;
+    int yaw;
+    enum projection pro,map_pro;
+    int mindist;
+    struct point origin;                    /**< Screen position of the first coordinate of the item */
+    int count;                              /**< Number of points of the outline */
+    int total;                              /**< Number of points of the outline and all holes */
+    struct displayitem_poly_holes holes;    /**< Holes, holding {@code struct point} instead of {@code struct coord} */
+    struct point p[0];                      /**< Outline, followed by the holes */
+};
+
+/**
+ * @brief Returns the screen geometry of a polygon with holes
+ *
+ * @param di The displayitem, which must have holes
+ * @param dc The display context, which must not have pitch
+ * @param pa Buffer for transforming the outline, of at least {@code di->count} points
+ * @param simple Buffer for simplifying the outline, of at least {@code di->count} coordinates
+ * @return The geometry, owned by the displayitem
+ */
+static struct displayitem_poly_cache *displayitem_poly_cache_get(struct displayitem *di, struct display_context *dc,
+        struct point *pa, struct coord *simple) {
+    struct displayitem_poly_cache *pc=di->poly_cache;
+    struct displayitem_poly_holes t_holes;
+    struct point origin,*p;
+    int count,simple_count,mindist=dc->mindist,total,i;
+
+    transform(dc->trans, dc->pro, di->c, &origin, 1, 0, 0, NULL);
+    if (pc && pc->scale == transform_get_scale(dc->trans) && pc->yaw == transform_get_yaw(dc->trans)
+            && pc->pro == transform_get_projection(dc->trans) && pc->map_pro == dc->pro && pc->mindist == dc->mindist) {
+        int dx=origin.x-pc->origin.x,dy=origin.y-pc->origin.y;
+        if (dx || dy) {
+            for (i = 0 ; i < pc->total ; i++) {
+                pc->p[i].x+=dx;
+                pc->p[i].y+=dy;
+            }
+            pc->origin=origin;
+        }
+        graphics_counters.poly_hits++;
+        return pc;
+    }
+    g_free(pc);
+    graphics_counters.poly_misses++;
+
+    /* same as in displayitem_draw() */
+    displayitem_transform_holes(dc->trans, dc->pro, di->holes, &t_holes, mindist);
+    if (dc->type == type_poly_water_tiled)
+        mindist=0;
+    simple_count=mindist ? displayitem_simplify(di, dc, simple) : 0;
+    if (simple_count)
+        count=transform(dc->trans, dc->pro, simple, pa, simple_count, mindist, 0, NULL);
+    else
+        count=transform(dc->trans, dc->pro, di->c, pa, di->count, mindist, 0, NULL);
+
+    total=count;
+    for (i = 0 ; i < t_holes.count ; i++)
+        total+=t_holes.ccount[i];
+    pc=g_malloc(sizeof(*pc)+total*sizeof(struct point)+t_holes.count*(sizeof(struct coord *)+sizeof(int)));
+    pc->scale=transform_get_scale(dc->trans);
+    pc->yaw=transform_get_yaw(dc->trans);
+    pc->pro=transform_get_projection(dc->trans);
+    pc->map_pro=dc->pro;
+    pc->mindist=dc->mindist;
+    pc->origin=origin;
+    pc->count=count;
+    pc->total=total;
+    pc->holes.count=t_holes.count;
+    pc->holes.coords=(struct coord **)(pc->p+total);
+    pc->holes.ccount=(int *)(pc->holes.coords+t_holes.count);
+    memcpy(pc->p, pa, count*sizeof(struct point));
+    p=pc->p+count;
+    for (i = 0 ; i < t_holes.count ; i++) {
+        memcpy(p, t_holes.coords[i], t_holes.ccount[i]*sizeof(struct point));
+        pc->holes.coords[i]=(struct coord *)p;
+        pc->holes.ccount[i]=t_holes.ccount[i];
+        p+=t_holes.ccount[i];
+    }
+    displayitem_free_holes(&t_holes);
+    di->poly_cache=pc;
+    return pc;
+}
+
 
 static inline void displayitem_draw_polygon (struct display_context * dc, struct graphics * gra,
         struct point * pa, int count, struct displayitem_poly_holes * holes) {
@@ -2734,8 +4619,11 @@ static inline void displayitem_draw_polygon (struct display_context * dc, struct
         texture = graphics_image_new_scaled_rotated(gra, path, dc->e->u.polygon.width, dc->e->u.polygon.height,
                   dc->e->u.polygon.rotation);
         g_free(path);
-        if(texture != NULL)
+        if(texture != NULL) {
+            /* the driver copies the texture into the gc */
             graphics_gc_set_texture(dc->gc, texture);
+            graphics_image_free(gra, texture);
+        }
     }
     if((holes != NULL) && (holes->count > 0))
         graphics_draw_polygon_with_holes_clipped(gra, dc->gc, pa, count, holes->count, holes->ccount,
@@ -2796,10 +4684,10 @@ static inline void displayitem_draw_text(struct displayitem *di,struct display_c
         }
         if (font) {
             int a;
-            label_line(gra, dc->gc, gc_background, font, pa, count, di->label);
+            label_line(dc, di, gc_background, font, pa, count);
             if(holes != NULL) {
                 for(a = 0; a < holes->count; a ++)
-                    label_line(gra, dc->gc, gc_background, font, (struct point *)holes->coords[a], holes->ccount[a], di->label);
+                    label_line(dc, di, gc_background, font, (struct point *)holes->coords[a], holes->ccount[a]);
             }
         } else
             dbg(lvl_error,"Failed to get font with size %d",e->text_size);
@@ -2824,8 +4712,10 @@ static inline void displayitem_draw_icon(struct displayitem *di,struct display_c
             if (item_is_custom_poi(di->item)) {
                 char *icon;
                 char *src;
-                if (img)
+                if (img) {
                     graphics_image_free(dc->gra, img);
+                    dc->img=NULL;
+                }
                 src=e->u.icon.src;
                 if (!src || !src[0])
                     src="%s";
@@ -2861,8 +4751,10 @@ static inline void displayitem_draw_image (struct displayitem *di, struct displa
     struct graphics_image *img=dc->img;
     if (gra->meth.draw_image_warp) {
         img=graphics_image_new_scaled_rotated(gra, di->label, IMAGE_W_H_UNSET, IMAGE_W_H_UNSET, 0);
-        if (img)
+        if (img) {
             graphics_draw_image_warp(gra, gra->gc[0], pa, count, img);
+            graphics_image_free(gra, img);
+        }
     } else
         dbg(lvl_error,"draw_image_warp not supported by graphics driver drawing '%s'", di->label);
 }
@@ -2883,22 +4775,53 @@ static void displayitem_draw(struct displayitem *di, struct layout *l, struct di
     struct graphics *gra=dc->gra;
     struct element *e=dc->e;
     int draw_underground=0;
+    struct coord *simple;
+    int size=dc->maxlen,need_free=0;
 
-    if (dc->maxlen < ALLOCA_COORD_LIMIT) {
-        width=g_alloca(sizeof(int)*dc->maxlen);
-        pa=g_alloca(sizeof(struct point)*dc->maxlen);
+    if (size < ALLOCA_COORD_LIMIT) {
+        width=g_alloca(sizeof(int)*size);
+        pa=g_alloca(sizeof(struct point)*size);
+        simple=g_alloca(sizeof(struct coord)*size);
     } else {
-        width=g_malloc(sizeof(int)*dc->maxlen);
-        pa=g_malloc(sizeof(struct point)*dc->maxlen);
+        width=g_malloc(sizeof(int)*size);
+        pa=g_malloc(sizeof(struct point)*size);
+        simple=g_malloc(sizeof(struct coord)*size);
+        need_free=1;
     }
 
     while (di) {
         int count=di->count,mindist=dc->mindist;
+        struct coord *c=di->c;
         struct displayitem_poly_holes t_holes;
+        enum graphics_phase phase;
         t_holes.count=0;
 
+        /* items may have more coordinates than dc->maxlen */
+        if (count > size) {
+            if (need_free) {
+                g_free(width);
+                g_free(pa);
+                g_free(simple);
+            }
+            size=count;
+            width=g_malloc(sizeof(int)*size);
+            pa=g_malloc(sizeof(struct point)*size);
+            simple=g_malloc(sizeof(struct coord)*size);
+            need_free=1;
+        }
+
+        if (dc->maps != display_maps_all && di->dynamic != (dc->maps == display_maps_dynamic)) {
+            di=di->next;
+            continue;
+        }
+
         di->z_order=++(gra->current_z_order);
 
+        if (dc->cull && !coord_rect_overlap(dc->cull, &di->bbox)) {
+            di=di->next;
+            continue;
+        }
+
         /* Skip elements that are to be drawn on oneway streets only
          * if street is not oneway or roundabout */
         if((e->oneway) && ((!(di->flags & AF_ONEWAY)) || (di->flags & AF_ROUNDABOUT))) {
@@ -2930,18 +4853,45 @@ static void displayitem_draw(struct displayitem *di, struct layout *l, struct di
         if (item_type_is_area(dc->type) && (dc->e->type == element_polyline || dc->e->type == element_text))
             limit = 0;
 
+        phase=graphics_phase_set(graphics_phase_transform);
+        if (e->type == element_polygon && di->holes && di->holes->count && !limit && !transform_get_pitch(dc->trans)) {
+            struct displayitem_poly_cache *pc=displayitem_poly_cache_get(di, dc, pa, simple);
+            graphics_phase_set(phase);
+            if (dc->stats) {
+                dc->stats->items++;
+                dc->stats->vertices+=pc->total;
+            }
+            displayitem_draw_polygon(dc, gra, pc->p, pc->count, &pc->holes);
+            di=di->next;
+            continue;
+        }
         displayitem_transform_holes(dc->trans, dc->pro, di->holes, &t_holes, mindist);
 
         if (limit)
             count=limit_count(di->c, count);
         if (dc->type == type_poly_water_tiled)
             mindist=0;
+        else if (!limit && (e->type == element_polygon || e->type == element_polyline)) {
+            int simple_count=displayitem_simplify(di, dc, simple);
+            if (simple_count) {
+                c=simple;
+                count=simple_count;
+            }
+        }
         if (dc->e->type == element_polyline)
-            count=transform(dc->trans, dc->pro, di->c, pa, count, mindist, e->u.polyline.width, width);
+            count=transform(dc->trans, dc->pro, c, pa, count, mindist, e->u.polyline.width, width);
         else if (dc->e->type == element_arrows)
-            count=transform(dc->trans, dc->pro, di->c, pa, count, mindist, e->u.arrows.width, width);
+            count=transform(dc->trans, dc->pro, c, pa, count, mindist, e->u.arrows.width, width);
         else
-            count=transform(dc->trans, dc->pro, di->c, pa, count, mindist, 0, NULL);
+            count=transform(dc->trans, dc->pro, c, pa, count, mindist, 0, NULL);
+        graphics_phase_set(phase);
+        if (dc->stats) {
+            int i;
+            dc->stats->items++;
+            dc->stats->vertices+=count;
+            for (i = 0 ; i < t_holes.count ; i++)
+                dc->stats->vertices+=t_holes.ccount[i];
+        }
         switch (e->type) {
         case element_polygon:
             displayitem_draw_polygon(dc, gra, pa, count, &t_holes);
@@ -2973,42 +4923,12 @@ static void displayitem_draw(struct displayitem *di, struct layout *l, struct di
 
         di=di->next;
     }
-    if (dc->maxlen >= ALLOCA_COORD_LIMIT) {
+    if (need_free) {
         g_free(width);
         g_free(pa);
+        g_free(simple);
     }
 }
-/**
- * FIXME
- * @param <>
- * @returns <>
- * @author Martin Schaller (04/2008)
-*/
-static void xdisplay_draw_elements(struct graphics *gra, struct displaylist *display_list, struct itemgra *itm,
-                                   struct layout * l) {
-    struct element *e;
-    GList *es,*types;
-    struct display_context *dc=&display_list->dc;
-    struct hash_entry *entry;
-
-    es=itm->elements;
-    while (es) {
-        e=es->data;
-        dc->e=e;
-        types=itm->type;
-        while (types) {
-            dc->type=GPOINTER_TO_INT(types->data);
-            entry=get_hash_entry(display_list, dc->type);
-            if (entry && entry->di) {
-                displayitem_draw(entry->di, l, dc);
-                display_context_free(dc);
-            }
-            types=g_list_next(types);
-        }
-        es=g_list_next(es);
-    }
-}
-
 void graphics_draw_itemgra(struct graphics *gra, struct itemgra *itm, struct transformation *t, char *label) {
     GList *es;
     struct display_context dc;
@@ -3030,6 +4950,9 @@ void graphics_draw_itemgra(struct graphics *gra, struct itemgra *itm, struct tra
     di->z_order=0;
     di->label=label;
     di->holes=NULL;
+    di->significance=NULL;
+    di->poly_cache=NULL;
+    di->dynamic=0;
     dc.gra=gra;
     dc.gc=NULL;
     dc.gc_background=NULL;
@@ -3039,6 +4962,11 @@ void graphics_draw_itemgra(struct graphics *gra, struct itemgra *itm, struct tra
     dc.trans=t;
     dc.type=type_none;
     dc.maxlen=max_coord;
+    dc.labels=NULL;
+    dc.stats=NULL;
+    dc.maps=display_maps_all;
+    dc.elements=display_elements_all;
+    dc.cull=NULL;
     while (es) {
         struct element *e=es->data;
         if (e->coord_count) {
@@ -3064,86 +4992,671 @@ void graphics_draw_itemgra(struct graphics *gra, struct itemgra *itm, struct tra
     }
 }
 
+/**
+ * @brief Draws the items of a displaylist following the layout compiled for an order
+ */
+static void xdisplay_draw(struct displaylist *display_list, struct graphics *gra, struct layout *l, int order) {
+    struct layout_compiled *lc=layout_get_compiled(l, order);
+    struct display_context *dc=&display_list->dc;
+    /* labels of dynamic items are drawn on top of the base map as they are */
+    int place_labels=dc->elements != display_elements_no_text && dc->maps != display_maps_dynamic;
+    int i;
+
+    /* dynamic items are drawn on top of the base map, and numbered that way */
+    if (dc->maps != display_maps_dynamic)
+        gra->current_z_order=0;
+    if (place_labels)
+        label_placement_begin(display_list, gra, order);
+    graphics_batch_begin(gra);
+    for (i = 0 ; i < lc->step_count ; i++) {
+        struct layout_draw_step *step=&lc->steps[i];
+        struct hash_entry *entry;
+        if ((dc->elements == display_elements_no_text && step->e->type == element_text)
+                || (dc->elements == display_elements_text && step->e->type != element_text))
+            continue;
+        /* the hash of the displaylist may have been set up before the layout was changed */
+        if (step->hashidx >= 0 && display_list->hash_entries[step->hashidx].type == step->type)
+            entry=&display_list->hash_entries[step->hashidx];
+        else
+            entry=get_hash_entry(display_list, step->type);
+        if (entry && entry->di) {
+            dc->e=step->e;
+            dc->type=step->type;
+            if (display_list->framing && step->layer < display_list->frame.layer_count)
+                dc->stats=&display_list->frame.layers[step->layer];
+            displayitem_draw(entry->di, l, dc);
+            display_context_free(dc);
+            dc->stats=NULL;
+        }
+    }
+    graphics_batch_end(gra);
+    if (place_labels)
+        label_placement_flush(display_list, gra);
+}
+
 /**
  * FIXME
  * @param <>
  * @returns <>
  * @author Martin Schaller (04/2008)
 */
-static void xdisplay_draw_layer(struct displaylist *display_list, struct graphics *gra, struct layer *lay, int order,
-                                struct layout * l) {
-    GList *itms;
-    struct itemgra *itm;
+extern void *route_selection;
+
+/* edge length of the tiles of the raster tile cache, in pixels */
+#define TILE_SIZE 256
+/* distance in pixels by which items may be drawn outside of their coordinates */
+#define TILE_MARGIN 32
+
+/**
+ * @brief A tile of the raster tile cache.
+ */
+struct graphics_tile {
+    struct graphics *gra;           /**< Overlay holding the tile */
+    struct graphics_gc *background;
+    int x,y;                        /**< Position in the tile grid */
+    int valid;                      /**< Whether the overlay holds the rendered tile */
+    int shown;                      /**< Whether the overlay is enabled */
+    unsigned int signature;         /**< Signature of the dynamic items in the tile when it was rendered */
+    unsigned int frame;             /**< Frame the tile was last used in */
+    struct point p;                 /**< Screen position of the tile in the last frame */
+};
+
+/**
+ * @brief Raster tile cache of a graphics.
+ *
+ * The map is rendered into overlays of TILE_SIZE pixels, aligned to a grid which is anchored at a map
+ * coordinate. When the map is panned, tiles which are still visible are moved instead of being rendered
+ * again. A tile is only rendered again if the items of dynamic maps within it, such as the route or traffic,
+ * have changed. Labels along lines depend on the visible area (see {@code struct label_placement}), so they
+ * are drawn into an overlay of their own on top of the tiles on every frame.
+ *
+ * All tiles are discarded if scale, order, layout or the active layers change. Rotated or pitched views are
+ * drawn without the cache.
+ *
+ * The cache is enabled by setting the {@code cache_size} attribute of the graphics to the number of bytes
+ * the tiles may use.
+ */
+struct graphics_tiles {
+    struct graphics *gra;           /**< Graphics the tiles are shown on */
+    int count,max;                  /**< Number of tiles allocated, and allowed by the memory budget */
+    struct graphics_tile *tile;
+    struct graphics *labels;        /**< Overlay holding the labels */
+    struct graphics_gc *labels_background;
+    struct coord anchor;            /**< Map coordinate of the top left corner of tile 0,0 */
+    enum projection pro;            /**< Projection of {@code anchor} */
+    long scale;
+    int order;
+    struct layout *layout;
+    unsigned int layers;            /**< Signature of the active layers */
+    struct point origin;            /**< Screen position of {@code anchor} in the current frame */
+    struct point_rect visible;      /**< Range of tiles visible in the current frame */
+    unsigned int frame;
+    int active;                     /**< Whether the last frame was drawn through the cache */
+};
+
+static struct graphics_tiles *graphics_tiles_new(struct graphics *gra) {
+    struct graphics_tiles *tiles;
+    struct attr *attr;
+    struct point p= {0,0};
+    struct color transparent= {0,0,0,0};
+
+    if (gra->parent || !gra->attrs || !gra->meth.overlay_new || !gra->meth.overlay_resize)
+        return NULL;
+    attr=attr_search(gra->attrs, attr_cache_size);
+    if (!attr || attr->u.num < TILE_SIZE*TILE_SIZE*4)
+        return NULL;
+    /* Created before any tile, so drivers which draw older overlays on top of newer ones keep the labels on top */
+    p.x=gra->r.lu.x;
+    p.y=gra->r.lu.y;
+    tiles=g_new0(struct graphics_tiles, 1);
+    tiles->labels=graphics_overlay_new(gra, &p, gra->r.rl.x-gra->r.lu.x, gra->r.rl.y-gra->r.lu.y, 0);
+    if (!tiles->labels) {
+        g_free(tiles);
+        return NULL;
+    }
+    graphics_overlay_disable(tiles->labels, 1);
+    tiles->labels_background=graphics_gc_new(tiles->labels);
+    graphics_gc_set_foreground(tiles->labels_background, &transparent);
+    tiles->gra=gra;
+    tiles->max=attr->u.num/(TILE_SIZE*TILE_SIZE*4);
+    tiles->tile=g_new0(struct graphics_tile, tiles->max);
+    dbg(lvl_debug,"tile cache of %d tiles", tiles->max);
+    return tiles;
+}
 
-    itms=lay->itemgras;
-    while (itms) {
-        itm=itms->data;
-        if (order >= itm->order.min && order <= itm->order.max)
-            xdisplay_draw_elements(gra, display_list, itm, l);
-        itms=g_list_next(itms);
+static void graphics_tiles_destroy(struct graphics_tiles *tiles) {
+    int i;
+    if (!tiles)
+        return;
+    for (i = 0 ; i < tiles->count ; i++) {
+        graphics_gc_destroy(tiles->tile[i].background);
+        graphics_free(tiles->tile[i].gra);
     }
+    graphics_gc_destroy(tiles->labels_background);
+    graphics_free(tiles->labels);
+    g_free(tiles->tile);
+    g_free(tiles);
 }
 
+static void graphics_tiles_hide(struct graphics_tiles *tiles) {
+    int i;
+    for (i = 0 ; i < tiles->count ; i++) {
+        if (tiles->tile[i].shown) {
+            graphics_overlay_disable(tiles->tile[i].gra, 1);
+            tiles->tile[i].shown=0;
+        }
+    }
+    if (tiles->active)
+        graphics_overlay_disable(tiles->labels, 1);
+    tiles->active=0;
+}
 
 /**
- * FIXME
- * @param <>
- * @returns <>
- * @author Martin Schaller (04/2008)
-*/
-static void xdisplay_draw(struct displaylist *display_list, struct graphics *gra, struct layout *l, int order) {
-    GList *lays;
-    struct layer *lay;
+ * @brief Moves the tiles along with the map while it is dragged.
+ *
+ * @param tiles The tile cache
+ * @param p The offset of the drag, NULL to return to the positions of the last frame
+ */
+static void graphics_tiles_drag(struct graphics_tiles *tiles, struct point *p) {
+    struct point off= {0,0},pos;
+    int i;
 
-    gra->current_z_order=0;
-    lays=l->layers;
-    while (lays) {
-        lay=lays->data;
-        if (lay->active) {
-            if (lay->ref)
-                lay=lay->ref;
-            xdisplay_draw_layer(display_list, gra, lay, order, l);
+    if (!tiles->active)
+        return;
+    if (p)
+        off=*p;
+    for (i = 0 ; i < tiles->count ; i++) {
+        if (tiles->tile[i].shown) {
+            pos.x=tiles->tile[i].p.x+off.x;
+            pos.y=tiles->tile[i].p.y+off.y;
+            graphics_overlay_resize(tiles->tile[i].gra, &pos, TILE_SIZE, TILE_SIZE, 0);
         }
-        lays=g_list_next(lays);
     }
+    pos.x=tiles->gra->r.lu.x+off.x;
+    pos.y=tiles->gra->r.lu.y+off.y;
+    graphics_overlay_resize(tiles->labels, &pos, tiles->gra->r.rl.x-tiles->gra->r.lu.x,
+                            tiles->gra->r.rl.y-tiles->gra->r.lu.y, 0);
+}
+
+static int graphics_tiles_index(int px) {
+    return px >= 0 ? px/TILE_SIZE : -((TILE_SIZE-1-px)/TILE_SIZE);
 }
 
 /**
- * FIXME
- * @param <>
- * @returns <>
- * @author Martin Schaller (04/2008)
-*/
-extern void *route_selection;
+ * @brief Prepares the tile grid for a frame, creating the tile cache if it is enabled.
+ *
+ * @param gra The graphics to draw on
+ * @param t The transformation of the frame
+ * @param l The layout, NULL if none
+ * @param order The order of the frame, including the order delta of the layout
+ * @return true if the frame is to be drawn through the tile cache
+ */
+static int graphics_tiles_setup(struct graphics *gra, struct transformation *t, struct layout *l, int order) {
+    struct graphics_tiles *tiles;
+    struct point_rect *r=&gra->r;
+    unsigned int layers;
+    int i,needed;
+
+    if (!gra->tiles)
+        gra->tiles=graphics_tiles_new(gra);
+    tiles=gra->tiles;
+    if (!tiles)
+        return 0;
+    needed=((r->rl.x-r->lu.x)/TILE_SIZE+2)*((r->rl.y-r->lu.y)/TILE_SIZE+2);
+    if (!l || route_selection || transform_get_yaw(t) || transform_get_pitch(t) || needed > tiles->max) {
+        graphics_tiles_hide(tiles);
+        return 0;
+    }
+    layers=layout_layers_signature(l);
+    if (transform_get_scale(t) != tiles->scale || order != tiles->order || l != tiles->layout || layers != tiles->layers
+            || transform_get_projection(t) != tiles->pro || abs(tiles->origin.x) > 1<<24 || abs(tiles->origin.y) > 1<<24) {
+        tiles->scale=transform_get_scale(t);
+        tiles->order=order;
+        tiles->layout=l;
+        tiles->layers=layers;
+        tiles->pro=transform_get_projection(t);
+        tiles->anchor=*transform_get_center(t);
+        for (i = 0 ; i < tiles->count ; i++)
+            tiles->tile[i].valid=0;
+    }
+    transform(t, tiles->pro, &tiles->anchor, &tiles->origin, 1, 0, 0, NULL);
+    tiles->visible.lu.x=graphics_tiles_index(r->lu.x-tiles->origin.x);
+    tiles->visible.lu.y=graphics_tiles_index(r->lu.y-tiles->origin.y);
+    tiles->visible.rl.x=graphics_tiles_index(r->rl.x-1-tiles->origin.x);
+    tiles->visible.rl.y=graphics_tiles_index(r->rl.y-1-tiles->origin.y);
+    return 1;
+}
 
-static void displaylist_update_layers(struct displaylist *displaylist, GList *layers, int order) {
-    while (layers) {
-        struct layer *layer=layers->data;
-        GList *itemgras;
-        if (layer->ref)
-            layer=layer->ref;
-        itemgras=layer->itemgras;
-        while (itemgras) {
-            struct itemgra *itemgra=itemgras->data;
-            GList *types=itemgra->type;
-            if (itemgra->order.min <= order && itemgra->order.max >= order) {
-                while (types) {
-                    enum item_type type=(enum item_type) types->data;
-                    set_hash_entry(displaylist, type);
-                    types=g_list_next(types);
-                }
+/**
+ * @brief Extends the area loaded by a transformation to all of the visible tiles.
+ *
+ * Tiles are rendered in full, so items in the parts of them outside the screen have to be loaded as well.
+ */
+static void graphics_tiles_extend_selection(struct graphics_tiles *tiles, struct transformation *t) {
+    struct point_rect r;
+
+    r.lu.x=tiles->origin.x+tiles->visible.lu.x*TILE_SIZE;
+    r.lu.y=tiles->origin.y+tiles->visible.lu.y*TILE_SIZE;
+    r.rl.x=tiles->origin.x+(tiles->visible.rl.x+1)*TILE_SIZE;
+    r.rl.y=tiles->origin.y+(tiles->visible.rl.y+1)*TILE_SIZE;
+    transform_set_source_rect(t, &r);
+}
+
+/**
+ * @brief Computes the signature of the items of dynamic maps in each visible tile.
+ *
+ * @param tiles The tile cache
+ * @param dl The displaylist
+ * @param sig Receives the signatures, one per visible tile, row by row
+ */
+static void graphics_tiles_signatures(struct graphics_tiles *tiles, struct displaylist *dl, unsigned int *sig) {
+    GHashTable *maps=g_hash_table_new(g_direct_hash, g_direct_equal);
+    int w=tiles->visible.rl.x-tiles->visible.lu.x+1;
+    int i,j,x,y;
+
+    for (i = 0 ; i < HASH_SIZE ; i++) {
+        struct displayitem *di;
+        for (di=dl->hash_entries[i].di ; di ; di=di->next) {
+            int is_static=GPOINTER_TO_INT(g_hash_table_lookup(maps, di->item.map));
+            struct coord c[2];
+            struct point p[2];
+            unsigned int hash;
+            char *label;
+
+            if (!is_static) {
+                is_static=displaylist_map_is_static(di->item.map) ? 1 : 2;
+                g_hash_table_insert(maps, di->item.map, GINT_TO_POINTER(is_static));
+            }
+            if (is_static == 1 || !di->count)
+                continue;
+            hash=di->item.type*31+di->item.id_hi;
+            hash=hash*31+di->item.id_lo;
+            c[0]=c[1]=di->c[0];
+            for (j = 0 ; j < di->count ; j++) {
+                hash=(hash*31+di->c[j].x)*31+di->c[j].y;
+                c[0].x=MIN(c[0].x, di->c[j].x);
+                c[0].y=MAX(c[0].y, di->c[j].y);
+                c[1].x=MAX(c[1].x, di->c[j].x);
+                c[1].y=MIN(c[1].y, di->c[j].y);
             }
-            itemgras=g_list_next(itemgras);
+            for (label=di->label ; label && *label ; label++)
+                hash=hash*31+(unsigned char)*label;
+            transform(dl->dc.trans, tiles->pro, &c[0], &p[0], 1, 0, 0, NULL);
+            transform(dl->dc.trans, tiles->pro, &c[1], &p[1], 1, 0, 0, NULL);
+            for (y=MAX(tiles->visible.lu.y, graphics_tiles_index(p[0].y-TILE_MARGIN-tiles->origin.y)) ;
+                    y <= MIN(tiles->visible.rl.y, graphics_tiles_index(p[1].y+TILE_MARGIN-tiles->origin.y)) ; y++)
+                for (x=MAX(tiles->visible.lu.x, graphics_tiles_index(p[0].x-TILE_MARGIN-tiles->origin.x)) ;
+                        x <= MIN(tiles->visible.rl.x, graphics_tiles_index(p[1].x+TILE_MARGIN-tiles->origin.x)) ; x++)
+                    sig[(y-tiles->visible.lu.y)*w+x-tiles->visible.lu.x]+=hash;
         }
-        layers=g_list_next(layers);
     }
+    g_hash_table_destroy(maps);
 }
 
-static void displaylist_update_hash(struct displaylist *displaylist) {
-    displaylist->max_offset=0;
-    clear_hash(displaylist);
-    displaylist_update_layers(displaylist, displaylist->layout->layers, displaylist->order);
-    dbg(lvl_debug,"max offset %d",displaylist->max_offset);
+/**
+ * @brief Returns the tile at a grid position, taking the least recently used one if it is not cached.
+ *
+ * @return The tile, NULL if no tile is available
+ */
+static struct graphics_tile *graphics_tiles_get(struct graphics_tiles *tiles, int x, int y) {
+    struct graphics_tile *tile=NULL;
+    struct point p= {0,0};
+    int i;
+
+    for (i = 0 ; i < tiles->count ; i++)
+        if (tiles->tile[i].valid && tiles->tile[i].x == x && tiles->tile[i].y == y)
+            return &tiles->tile[i];
+    if (tiles->count < tiles->max) {
+        tile=&tiles->tile[tiles->count];
+        tile->gra=graphics_overlay_new(tiles->gra, &p, TILE_SIZE, TILE_SIZE, 0);
+        if (tile->gra) {
+            graphics_overlay_disable(tile->gra, 1);
+            /* icons are drawn with the default graphics contexts */
+            graphics_init(tile->gra);
+            tile->background=graphics_gc_new(tile->gra);
+            tiles->count++;
+        } else
+            tile=NULL;
+    }
+    if (!tile) {
+        for (i = 0 ; i < tiles->count ; i++)
+            if (tiles->tile[i].frame != tiles->frame && (!tile || tiles->tile[i].frame < tile->frame))
+                tile=&tiles->tile[i];
+        if (!tile)
+            return NULL;
+    }
+    tile->x=x;
+    tile->y=y;
+    tile->valid=0;
+    return tile;
+}
+
+/**
+ * @brief Makes an overlay of the tile cache use the fonts of the graphics it is shown on.
+ */
+static void graphics_tiles_set_font(struct graphics *overlay, struct graphics *gra) {
+    if (overlay->font_size == gra->font_size && !overlay->default_font == !gra->default_font
+            && (!gra->default_font || !strcmp(overlay->default_font, gra->default_font)))
+        return;
+    graphics_font_destroy_all(overlay);
+    overlay->font_size=gra->font_size;
+    g_free(overlay->default_font);
+    overlay->default_font=g_strdup(gra->default_font);
+}
+
+/**
+ * @brief Renders a tile.
+ *
+ * Only the items whose bounding box reaches into the tile, extended by TILE_MARGIN, are drawn.
+ */
+static void graphics_tiles_render(struct graphics_tiles *tiles, struct graphics_tile *tile, struct displaylist *dl,
+                                  struct layout *l, int order) {
+    struct transformation *t=dl->dc.trans,*tt=transform_dup(t);
+    struct point p= {0,0},center,corner;
+    struct coord c;
+    struct coord_rect cull;
+
+    /* move the tile to the top left corner of the screen */
+    transform(t, tiles->pro, transform_get_center(t), &center, 1, 0, 0, NULL);
+    center.x-=tile->p.x;
+    center.y-=tile->p.y;
+    transform_set_screen_offset(tt, &center);
+    /* tiles are only used without rotation, so two corners give the area of the tile */
+    corner.x=corner.y=-TILE_MARGIN;
+    transform_reverse(tt, &corner, &c);
+    cull.lu=cull.rl=c;
+    corner.x=corner.y=TILE_SIZE+TILE_MARGIN;
+    transform_reverse(tt, &corner, &c);
+    coord_rect_extend(&cull, &c);
+    graphics_tiles_set_font(tile->gra, tiles->gra);
+    graphics_gc_set_foreground(tile->background, &l->color);
+    graphics_draw_mode(tile->gra, draw_mode_begin);
+    graphics_draw_rectangle(tile->gra, tile->background, &p, TILE_SIZE, TILE_SIZE);
+    dl->dc.trans=tt;
+    dl->dc.gra=tile->gra;
+    dl->dc.elements=display_elements_no_text;
+    dl->dc.cull=&cull;
+    xdisplay_draw(dl, tile->gra, l, order);
+    dl->dc.trans=t;
+    dl->dc.gra=tiles->gra;
+    dl->dc.elements=display_elements_all;
+    dl->dc.cull=NULL;
+    graphics_draw_mode(tile->gra, draw_mode_end);
+    transform_destroy(tt);
+}
+
+/**
+ * @brief Draws a frame through the tile cache.
+ *
+ * @param tiles The tile cache, prepared by {@code graphics_tiles_setup()}
+ * @param dl The displaylist to draw
+ * @param l The layout
+ * @param order The order of the frame, including the order delta of the layout
+ * @return true on success, false if the frame has to be drawn directly
+ */
+static int graphics_tiles_draw(struct graphics_tiles *tiles, struct displaylist *dl, struct layout *l, int order) {
+    struct graphics *gra=tiles->gra;
+    int w=tiles->visible.rl.x-tiles->visible.lu.x+1,h=tiles->visible.rl.y-tiles->visible.lu.y+1;
+    unsigned int *sig=g_new0(unsigned int, w*h);
+    struct point_rect r;
+    int x,y,i,rendered=0;
+
+    tiles->frame++;
+    graphics_tiles_signatures(tiles, dl, sig);
+    /* keep visible tiles from being taken for others */
+    for (i = 0 ; i < tiles->count ; i++) {
+        struct graphics_tile *tile=&tiles->tile[i];
+        if (tile->valid && tile->x >= tiles->visible.lu.x && tile->x <= tiles->visible.rl.x
+                && tile->y >= tiles->visible.lu.y && tile->y <= tiles->visible.rl.y)
+            tile->frame=tiles->frame;
+    }
+    for (y = tiles->visible.lu.y ; y <= tiles->visible.rl.y ; y++) {
+        for (x = tiles->visible.lu.x ; x <= tiles->visible.rl.x ; x++) {
+            struct graphics_tile *tile=graphics_tiles_get(tiles, x, y);
+            unsigned int s=sig[(y-tiles->visible.lu.y)*w+x-tiles->visible.lu.x];
+            if (!tile) {
+                g_free(sig);
+                graphics_tiles_hide(tiles);
+                return 0;
+            }
+            tile->frame=tiles->frame;
+            tile->p.x=tiles->origin.x+x*TILE_SIZE;
+            tile->p.y=tiles->origin.y+y*TILE_SIZE;
+            graphics_overlay_resize(tile->gra, &tile->p, TILE_SIZE, TILE_SIZE, 0);
+            if (!tile->valid || tile->signature != s) {
+                graphics_tiles_render(tiles, tile, dl, l, order);
+                tile->signature=s;
+                tile->valid=1;
+                rendered++;
+                graphics_counters.tiles_rendered++;
+            } else
+                graphics_counters.tiles_reused++;
+            if (!tile->shown) {
+                graphics_overlay_disable(tile->gra, 0);
+                tile->shown=1;
+            }
+        }
+    }
+    g_free(sig);
+    for (i = 0 ; i < tiles->count ; i++) {
+        if (tiles->tile[i].shown && tiles->tile[i].frame != tiles->frame) {
+            graphics_overlay_disable(tiles->tile[i].gra, 1);
+            tiles->tile[i].shown=0;
+        }
+    }
+
+    r.lu.x=0;
+    r.lu.y=0;
+    r.rl.x=gra->r.rl.x-gra->r.lu.x;
+    r.rl.y=gra->r.rl.y-gra->r.lu.y;
+    graphics_overlay_resize(tiles->labels, &gra->r.lu, r.rl.x, r.rl.y, 0);
+    graphics_set_rect(tiles->labels, &r);
+    graphics_tiles_set_font(tiles->labels, gra);
+    graphics_draw_mode(tiles->labels, draw_mode_begin);
+    graphics_draw_rectangle(tiles->labels, tiles->labels_background, &r.lu, r.rl.x, r.rl.y);
+    dl->dc.gra=tiles->labels;
+    dl->dc.elements=display_elements_text;
+    xdisplay_draw(dl, tiles->labels, l, order);
+    dl->dc.gra=gra;
+    dl->dc.elements=display_elements_all;
+    graphics_draw_mode(tiles->labels, draw_mode_end);
+    if (!tiles->active)
+        graphics_overlay_disable(tiles->labels, 0);
+    tiles->active=1;
+    dbg(lvl_debug,"rendered %d of %d tiles", rendered, w*h);
+    return 1;
+}
+
+/**
+ * @brief Overlay holding the items of dynamic maps
+ *
+ * The items of dynamic maps (see {@code displaylist_map_is_static()}), such as the route, traffic or tracking maps,
+ * are drawn into an overlay on top of the base map, which holds the items of all other maps. As long as the base map
+ * would look the same, only the overlay is drawn again, so a new route or a traffic update doesn't cost drawing the
+ * whole map. The base map is drawn again if the transformation, the layout or its active layers or the items of static
+ * maps have changed, or if anything else has drawn on the graphics in the meantime.
+ *
+ * Items of dynamic maps end up above all of the base map, including its labels. The graphics driver has to keep what
+ * has been drawn on the graphics until it is drawn again, and has to composite overlays on its own (see
+ * {@code graphics_methods.composites_overlays}), as the graphics itself is not drawn while only the overlay changes.
+ * The overlay is enabled by setting the {@code dynamic_overlay} attribute of the graphics. Frames drawn through the tile cache don't use it, as the tile cache only renders those
+ * tiles again whose dynamic items have changed.
+ */
+struct graphics_dynamic {
+    struct graphics *gra;           /**< Graphics the overlay is shown on */
+    struct graphics *overlay;
+    struct graphics_gc *background; /**< Transparent, for clearing the overlay */
+    int shown;                      /**< Whether the overlay is enabled */
+    int valid;                      /**< Whether the base map of the last frame is still shown */
+    /* state the base map was drawn in */
+    struct displaylist *dl;
+    struct layout *layout;
+    unsigned int layers;
+    int order;
+    unsigned int static_seq;
+    unsigned int draw_count;
+    long scale;
+    int yaw;
+    int pitch;
+    enum projection pro;
+    struct coord center;
+    struct point_rect r;
+};
+
+static struct graphics_dynamic *graphics_dynamic_new(struct graphics *gra) {
+    struct graphics_dynamic *dyn;
+    struct attr *attr;
+    struct point p;
+    struct color transparent= {0,0,0,0};
+
+    if (gra->parent || !gra->attrs || !gra->meth.overlay_new || !gra->meth.overlay_resize
+            || !gra->meth.composites_overlays)
+        return NULL;
+    attr=attr_search(gra->attrs, attr_dynamic_overlay);
+    if (!attr || !attr->u.num)
+        return NULL;
+    p=gra->r.lu;
+    dyn=g_new0(struct graphics_dynamic, 1);
+    dyn->overlay=graphics_overlay_new(gra, &p, gra->r.rl.x-gra->r.lu.x, gra->r.rl.y-gra->r.lu.y, 0);
+    if (!dyn->overlay) {
+        g_free(dyn);
+        return NULL;
+    }
+    graphics_overlay_disable(dyn->overlay, 1);
+    graphics_init(dyn->overlay);
+    dyn->background=graphics_gc_new(dyn->overlay);
+    graphics_gc_set_foreground(dyn->background, &transparent);
+    dyn->gra=gra;
+    return dyn;
+}
+
+static void graphics_dynamic_destroy(struct graphics_dynamic *dyn) {
+    if (!dyn)
+        return;
+    graphics_gc_destroy(dyn->background);
+    graphics_free(dyn->overlay);
+    g_free(dyn);
+}
+
+static void graphics_dynamic_hide(struct graphics_dynamic *dyn) {
+    if (dyn->shown)
+        graphics_overlay_disable(dyn->overlay, 1);
+    dyn->shown=0;
+    dyn->valid=0;
+}
+
+/**
+ * @brief Moves the overlay along with the map while it is dragged.
+ *
+ * @param dyn The overlay
+ * @param p The offset of the drag, NULL to return to the position of the last frame
+ */
+static void graphics_dynamic_drag(struct graphics_dynamic *dyn, struct point *p) {
+    struct point pos=dyn->gra->r.lu;
+
+    if (!dyn->shown)
+        return;
+    if (p) {
+        pos.x+=p->x;
+        pos.y+=p->y;
+        /* the driver may have moved the base map as well */
+        dyn->valid=0;
+    }
+    graphics_overlay_resize(dyn->overlay, &pos, dyn->gra->r.rl.x-dyn->gra->r.lu.x, dyn->gra->r.rl.y-dyn->gra->r.lu.y, 0);
+}
+
+/**
+ * @brief Decides whether a frame is drawn with the overlay of dynamic maps, creating it if it is enabled.
+ *
+ * @param gra The graphics to draw on
+ * @param dl The displaylist to draw
+ * @param l The layout, NULL if none
+ * @param flags The flags of {@code graphics_displaylist_draw()}
+ * @return true if the frame is to be drawn with the overlay
+ */
+static int graphics_dynamic_setup(struct graphics *gra, struct displaylist *dl, struct layout *l, int flags) {
+    if (!gra->dynamic)
+        gra->dynamic=graphics_dynamic_new(gra);
+    if (!gra->dynamic)
+        return 0;
+    /* intermediate frames are drawn as they are, and the caller may continue drawing on the frame */
+    if (!l || dl->busy || route_selection || (flags & 4)) {
+        graphics_dynamic_hide(gra->dynamic);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Checks whether the base map shown is the one a frame would draw.
+ */
+static int graphics_dynamic_base_valid(struct graphics_dynamic *dyn, struct displaylist *dl, struct layout *l,
+                                       int order) {
+    struct transformation *t=dl->dc.trans;
+    struct coord *center=transform_get_center(t);
+    struct point_rect *r=&dyn->gra->r;
+
+    return dyn->valid && dyn->dl == dl && dyn->layout == l && dyn->layers == layout_layers_signature(l)
+           && dyn->order == order && dyn->static_seq == dl->static_seq && dyn->draw_count == dyn->gra->draw_count
+           && dyn->scale == transform_get_scale(t) && dyn->yaw == transform_get_yaw(t)
+           && dyn->pitch == transform_get_pitch(t) && dyn->pro == transform_get_projection(t)
+           && dyn->center.x == center->x && dyn->center.y == center->y
+           && !memcmp(&dyn->r, r, sizeof(*r));
+}
+
+/**
+ * @brief Remembers the state the base map has just been drawn in.
+ */
+static void graphics_dynamic_base_drawn(struct graphics_dynamic *dyn, struct displaylist *dl, struct layout *l,
+                                        int order) {
+    struct transformation *t=dl->dc.trans;
+
+    dyn->dl=dl;
+    dyn->layout=l;
+    dyn->layers=layout_layers_signature(l);
+    dyn->order=order;
+    dyn->static_seq=dl->static_seq;
+    dyn->draw_count=dyn->gra->draw_count;
+    dyn->scale=transform_get_scale(t);
+    dyn->yaw=transform_get_yaw(t);
+    dyn->pitch=transform_get_pitch(t);
+    dyn->pro=transform_get_projection(t);
+    dyn->center=*transform_get_center(t);
+    dyn->r=dyn->gra->r;
+    dyn->valid=1;
+}
+
+/**
+ * @brief Draws the items of the dynamic maps of a displaylist into the overlay.
+ *
+ * @param dyn The overlay
+ * @param dl The displaylist
+ * @param l The layout
+ * @param order The order of the frame, including the order delta of the layout
+ */
+static void graphics_dynamic_draw(struct graphics_dynamic *dyn, struct displaylist *dl, struct layout *l, int order) {
+    struct graphics *gra=dyn->gra;
+    struct point_rect r;
+
+    r.lu.x=0;
+    r.lu.y=0;
+    r.rl.x=gra->r.rl.x-gra->r.lu.x;
+    r.rl.y=gra->r.rl.y-gra->r.lu.y;
+    graphics_overlay_resize(dyn->overlay, &gra->r.lu, r.rl.x, r.rl.y, 0);
+    graphics_set_rect(dyn->overlay, &r);
+    graphics_tiles_set_font(dyn->overlay, gra);
+    graphics_draw_mode(dyn->overlay, draw_mode_begin);
+    graphics_draw_rectangle(dyn->overlay, dyn->background, &r.lu, r.rl.x, r.rl.y);
+    dyn->overlay->current_z_order=gra->current_z_order;
+    dl->dc.gra=dyn->overlay;
+    dl->dc.maps=display_maps_dynamic;
+    xdisplay_draw(dl, dyn->overlay, l, order);
+    dl->dc.gra=gra;
+    dl->dc.maps=display_maps_all;
+    graphics_draw_mode(dyn->overlay, draw_mode_end);
+    if (!dyn->shown)
+        graphics_overlay_disable(dyn->overlay, 0);
+    dyn->shown=1;
 }
 
 
@@ -3169,6 +5682,74 @@ static int displaylist_cmp_zorder(const struct displayitem *a, const struct disp
     return 0;
 }
 
+/**
+ * @brief Returns the displayitems within a distance of a screen position
+ *
+ * Only the items in the cells of the hit test index around the position are checked, unless the area around the
+ * position can't be mapped back to the map, e.g. above the horizon.
+ *
+ * @param displaylist The displaylist
+ * @param p The screen position
+ * @param radius The distance in pixels
+ * @return GList of displayitems in no particular order, to be freed with {@code g_list_free()}
+ */
+GList *displaylist_get_items_within_dist(struct displaylist *displaylist, struct point *p, int radius) {
+    struct displaylist_grid *grid=displaylist->grid;
+    struct coord_rect r;
+    struct point_rect cells;
+    GHashTable *seen;
+    GList *l=NULL;
+    int i,x,y;
+
+    if (!grid || !displaylist->dc.trans)
+        return NULL;
+    for (i = 0 ; i < 4 ; i++) {
+        struct point corner;
+        struct coord c;
+        corner.x=p->x+(i & 1 ? radius : -radius);
+        corner.y=p->y+(i & 2 ? radius : -radius);
+        if (!transform_reverse(displaylist->dc.trans, &corner, &c))
+            break;
+        if (i)
+            coord_rect_extend(&r, &c);
+        else
+            r.lu=r.rl=c;
+    }
+    if (i < 4 || (long long)(displaylist_grid_index(r.rl.x, grid->cell)-displaylist_grid_index(r.lu.x, grid->cell)+1)
+            *(displaylist_grid_index(r.lu.y, grid->cell)-displaylist_grid_index(r.rl.y, grid->cell)+1) > HIT_GRID_BUCKETS) {
+        struct displaylist_handle *dlh=graphics_displaylist_open(displaylist);
+        struct displayitem *di;
+        while ((di=graphics_displaylist_next(dlh)))
+            if (graphics_displayitem_within_dist(displaylist, di, p, radius))
+                l=g_list_prepend(l, di);
+        graphics_displaylist_close(dlh);
+        return l;
+    }
+    cells.lu.x=displaylist_grid_index(r.lu.x, grid->cell);
+    cells.rl.x=displaylist_grid_index(r.rl.x, grid->cell);
+    cells.lu.y=displaylist_grid_index(r.rl.y, grid->cell);
+    cells.rl.y=displaylist_grid_index(r.lu.y, grid->cell);
+    seen=g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (i = 0 ; i < grid->large.count ; i++)
+        if (graphics_displayitem_within_dist(displaylist, grid->large.items[i], p, radius))
+            l=g_list_prepend(l, grid->large.items[i]);
+    for (x = cells.lu.x ; x <= cells.rl.x ; x++) {
+        for (y = cells.lu.y ; y <= cells.rl.y ; y++) {
+            struct displaylist_grid_bucket *bucket=displaylist_grid_bucket(grid, x, y);
+            for (i = 0 ; i < bucket->count ; i++) {
+                struct displayitem *di=bucket->items[i];
+                if (g_hash_table_lookup(seen, di))
+                    continue;
+                g_hash_table_insert(seen, di, di);
+                if (graphics_displayitem_within_dist(displaylist, di, p, radius))
+                    l=g_list_prepend(l, di);
+            }
+        }
+    }
+    g_hash_table_destroy(seen);
+    return l;
+}
+
 /**
  * @brief Returns list of displayitems clicked at given coordinates. The deeper item is in current layout, the deeper it will be in the list.
  * @param displaylist
@@ -3177,37 +5758,351 @@ static int displaylist_cmp_zorder(const struct displayitem *a, const struct disp
  * @returns GList of displayitems
  */
 GList *displaylist_get_clicked_list(struct displaylist *displaylist, struct point *p, int radius) {
-    GList *l=NULL;
-    struct displayitem *di;
-    struct displaylist_handle *dlh=graphics_displaylist_open(displaylist);
+    GList *l=displaylist_get_items_within_dist(displaylist, p, radius),*curr=l;
 
-    while ((di=graphics_displaylist_next(dlh))) {
-        if (di->z_order>0 && graphics_displayitem_within_dist(displaylist, di, p,radius))
-            l=g_list_insert_sorted(l,(gpointer) di, (GCompareFunc) displaylist_cmp_zorder);
+    while (curr) {
+        GList *next=g_list_next(curr);
+        if (((struct displayitem *)curr->data)->z_order <= 0)
+            l=g_list_delete_link(l, curr);
+        curr=next;
     }
+    return g_list_sort(l, (GCompareFunc) displaylist_cmp_zorder);
+}
 
-    graphics_displaylist_close(dlh);
 
-    return l;
+
+/**
+ * @brief Checks whether an idle callback of an asynchronous load has done its share of work
+ *
+ * @param displaylist The displaylist being loaded
+ * @param workload Number of items loaded in this callback so far
+ * @param start Time the callback started
+ * @return true if the callback should return
+ */
+static int displaylist_slice_done(struct displaylist *displaylist, int workload, struct timeval *start) {
+    struct timeval now;
+    if (!displaylist->budget)
+        return workload == displaylist->workload;
+    /* don't ask the clock for every item */
+    if (workload & 15)
+        return 0;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec-start->tv_sec)*1000+(now.tv_usec-start->tv_usec)/1000 >= displaylist->budget;
+}
+
+/**
+ * @brief Completes the coarse pass of a progressive load
+ *
+ * The coarse items loaded so far are drawn as an intermediate frame and remembered in {@code displaylist->reused},
+ * so loading the rest of the items skips them. Dynamic maps were loaded completely during the coarse pass.
+ */
+static void displaylist_coarse_done(struct displaylist *displaylist, int flags) {
+    int i;
+    if (!displaylist->reused)
+        displaylist->reused=item_hash_new();
+    for (i = 0 ; i < HASH_SIZE ; i++) {
+        struct displayitem *di;
+        for (di=displaylist->hash_entries[i].di ; di ; di=di->next)
+            if (displaylist_map_is_static(di->item.map))
+                item_hash_insert(displaylist->reused, &di->item, di);
+    }
+    displaylist->progressive=2;
+    graphics_displaylist_draw(displaylist->dc.gra, displaylist, displaylist->dc.trans, displaylist->layout, flags);
 }
 
+/** Attributes read along with the items of a displaylist, see displaylist_add_record() */
+static enum attr_type displaylist_batch_attrs[]= {attr_label, attr_icon_src, attr_flags, attr_none};
+static enum attr_type displaylist_batch_repeated[]= {attr_poly_hole, attr_none};
+
+static int displaylist_batch_filter(void *priv, enum item_type type) {
+    return get_hash_entry(priv, type) != NULL;
+}
 
+#ifdef HAVE_PTHREAD
+/**
+ * @brief Reads a map with several threads
+ *
+ * The selection is split into stripes side by side, each of which is read through a map rect of its own. In every
+ * round, the batches of all stripes are filled at the same time, the one of the first stripe by the main thread.
+ * Then the main thread adds the items to the displaylist stripe by stripe while the other threads wait for the next
+ * round. So the items end up in the same order however the threads are scheduled, and no other thread runs while
+ * the displaylist is changed.
+ */
+struct displaylist_loader {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int round;                      /**< Incremented to start a round */
+    int running;                    /**< Number of threads still filling their batch in the current round */
+    int stop;                       /**< Set to end the threads */
+    int count;                      /**< Number of stripes */
+    int started;                    /**< Number of stripes with a thread of their own */
+    int current;                    /**< Stripe the items of which are being added, {@code count} before a round */
+    struct displaylist_stripe *stripes;
+    struct item_hash *added;        /**< Items added so far, as stripes can share tiles of the map */
+};
+
+struct displaylist_stripe {
+    struct displaylist_loader *loader;
+    struct map_selection *sel;
+    struct map_rect *mr;
+    struct map_item_batch *batch;
+    pthread_t thread;               /**< Reads the stripe, except for the first one which the main thread reads */
+};
+
+static void *displaylist_stripe_run(void *data) {
+    struct displaylist_stripe *stripe=data;
+    struct displaylist_loader *loader=stripe->loader;
+    int round=0;
+
+    pthread_mutex_lock(&loader->mutex);
+    for (;;) {
+        while (loader->round == round && !loader->stop)
+            pthread_cond_wait(&loader->cond, &loader->mutex);
+        if (loader->stop)
+            break;
+        round=loader->round;
+        pthread_mutex_unlock(&loader->mutex);
+        map_rect_get_items(stripe->mr, stripe->batch);
+        pthread_mutex_lock(&loader->mutex);
+        if (!--loader->running)
+            pthread_cond_broadcast(&loader->cond);
+    }
+    pthread_mutex_unlock(&loader->mutex);
+    return NULL;
+}
+
+/* Returns the ith of count stripes of a selection, which cover the rectangles of the selection from left to right */
+static struct map_selection *displaylist_selection_stripe(struct map_selection *sel, int i, int count) {
+    struct map_selection *ret=map_selection_dup(sel),*curr;
+
+    for (curr=ret ; curr ; curr=curr->next) {
+        struct coord_rect *r=&curr->u.c_rect;
+        long long w=(long long)r->rl.x-r->lu.x;
+        int x=r->lu.x;
+        r->lu.x=x+w*i/count;
+        r->rl.x=x+w*(i+1)/count;
+    }
+    return ret;
+}
+
+static void displaylist_loader_destroy(struct displaylist_loader *loader) {
+    int i;
+
+    pthread_mutex_lock(&loader->mutex);
+    loader->stop=1;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->mutex);
+    for (i = 1 ; i < loader->started ; i++)
+        pthread_join(loader->stripes[i].thread, NULL);
+    for (i = 0 ; i < loader->count ; i++) {
+        struct displaylist_stripe *stripe=&loader->stripes[i];
+        if (stripe->mr)
+            map_rect_destroy(stripe->mr);
+        map_selection_destroy(stripe->sel);
+        map_item_batch_destroy(stripe->batch);
+    }
+    item_hash_destroy(loader->added);
+    pthread_cond_destroy(&loader->cond);
+    pthread_mutex_destroy(&loader->mutex);
+    g_free(loader->stripes);
+    g_free(loader);
+}
+
+/**
+ * @brief Starts reading the map being loaded into a displaylist with {@code displaylist->threads} threads
+ *
+ * @return The loader, or NULL if the map can't be read this way
+ */
+static struct displaylist_loader *displaylist_loader_new(struct displaylist *displaylist) {
+    struct displaylist_loader *loader=g_new0(struct displaylist_loader, 1);
+    int i;
+
+    pthread_mutex_init(&loader->mutex, NULL);
+    pthread_cond_init(&loader->cond, NULL);
+    loader->count=displaylist->threads;
+    loader->current=loader->count;
+    loader->started=1;
+    loader->stripes=g_new0(struct displaylist_stripe, loader->count);
+    loader->added=item_hash_new();
+    for (i = 0 ; i < loader->count ; i++) {
+        struct displaylist_stripe *stripe=&loader->stripes[i];
+        stripe->loader=loader;
+        stripe->sel=displaylist_selection_stripe(displaylist->sel, i, loader->count);
+        stripe->mr=map_rect_new(displaylist->m, stripe->sel);
+        stripe->batch=map_item_batch_new(256, 16384, 16384, displaylist_batch_attrs, displaylist_batch_repeated);
+        stripe->batch->filter=displaylist_batch_filter;
+        stripe->batch->filter_priv=displaylist;
+        if (!stripe->mr) {
+            displaylist_loader_destroy(loader);
+            return NULL;
+        }
+    }
+    for (i = 1 ; i < loader->count ; i++) {
+        if (pthread_create(&loader->stripes[i].thread, NULL, displaylist_stripe_run, &loader->stripes[i])) {
+            dbg(lvl_error,"failed to start a thread, reading the map on the main thread");
+            displaylist_loader_destroy(loader);
+            return NULL;
+        }
+        loader->started++;
+    }
+    return loader;
+}
+
+/* Fills the batches of all stripes, returns false if there are no more items */
+static int displaylist_loader_round(struct displaylist_loader *loader) {
+    int i;
+
+    pthread_mutex_lock(&loader->mutex);
+    loader->running=loader->count-1;
+    loader->round++;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->mutex);
+    map_rect_get_items(loader->stripes[0].mr, loader->stripes[0].batch);
+    pthread_mutex_lock(&loader->mutex);
+    while (loader->running)
+        pthread_cond_wait(&loader->cond, &loader->mutex);
+    pthread_mutex_unlock(&loader->mutex);
+    for (i = 0 ; i < loader->count ; i++)
+        if (loader->stripes[i].batch->count)
+            return 1;
+    return 0;
+}
+
+/* Moves on to the next batch with items, returns false if all items of the map have been read */
+static int displaylist_loader_next(struct displaylist_loader *loader) {
+    for (;;) {
+        while (++loader->current < loader->count)
+            if (loader->stripes[loader->current].batch->count)
+                return 1;
+        if (!displaylist_loader_round(loader))
+            return 0;
+        loader->current=-1;
+    }
+}
+#endif
+
+/* Starts reading the map being loaded within the selection of the displaylist */
+static void displaylist_map_open(struct displaylist *displaylist) {
+    if (!displaylist->sel)
+        return;
+#ifdef HAVE_PTHREAD
+    if (displaylist->threads > 1 && !displaylist->dynamic && map_allows_concurrent_rects(displaylist->m)
+            && (displaylist->loader=displaylist_loader_new(displaylist)))
+        return;
+#endif
+    displaylist->mr=map_rect_new(displaylist->m, displaylist->sel);
+}
+
+static void displaylist_map_close(struct displaylist *displaylist) {
+#ifdef HAVE_PTHREAD
+    if (displaylist->loader)
+        displaylist_loader_destroy(displaylist->loader);
+#endif
+    displaylist->loader=NULL;
+    map_rect_destroy(displaylist->mr);
+    displaylist->mr=NULL;
+    displaylist->batch->count=displaylist->batch_pos=0;
+}
+
+/* Returns the batch of the map being loaded the items of which are being added */
+static struct map_item_batch *displaylist_batch(struct displaylist *displaylist) {
+#ifdef HAVE_PTHREAD
+    struct displaylist_loader *loader=displaylist->loader;
+    if (loader && loader->current < loader->count)
+        return loader->stripes[loader->current].batch;
+#endif
+    return displaylist->batch;
+}
+
+/* Reads the next items of the map being loaded, returns false if there are no more */
+static int displaylist_fetch(struct displaylist *displaylist) {
+#ifdef HAVE_PTHREAD
+    if (displaylist->loader)
+        return displaylist_loader_next(displaylist->loader);
+#endif
+    return map_rect_get_items(displaylist->mr, displaylist->batch) || displaylist->batch->busy;
+}
+
+/**
+ * @brief Adds an item read from the map being loaded to the displaylist
+ *
+ * Items outside of the selection of the displaylist and items kept from the last load are skipped.
+ * The coordinates of the record are transformed to {@code pro} in place.
+ *
+ * @param displaylist The displaylist
+ * @param rec The item, read with the attributes in {@code displaylist_batch_attrs}
+ * @param pro Projection of the displaylist
+ * @return The new displayitem, or NULL if the item was skipped
+ */
+static struct displayitem *displaylist_add_record(struct displaylist *displaylist, struct map_item_record *rec,
+        enum projection pro) {
+    struct hash_entry *entry;
+    struct displayitem *di;
+    struct map_selection *sel;
+    struct coord_rect bbox;
+    struct item item;
+    char *label=NULL,*icon=NULL;
+    int i,count=rec->count;
+
+    entry=get_hash_entry(displaylist, rec->type);
+    if (!entry || count <= 0)
+        return NULL;
+    memset(&item, 0, sizeof(item));
+    item.type=rec->type;
+    item.id_hi=rec->id_hi;
+    item.id_lo=rec->id_lo;
+    item.map=displaylist->m;
+    if (displaylist->reused && item_hash_lookup(displaylist->reused, &item))
+        return NULL;
+#ifdef HAVE_PTHREAD
+    if (displaylist->loader && item_hash_lookup(displaylist->loader->added, &item))
+        return NULL;
+#endif
+    /* points are drawn at their first coordinate */
+    if (item.type < type_line)
+        count=1;
+    /* skip items with no coordinates within the selection at all */
+    bbox.lu=bbox.rl=rec->c[0];
+    for (i = 1 ; i < count ; i++)
+        coord_rect_extend(&bbox, &rec->c[i]);
+    for (sel=displaylist->sel ; sel ; sel=sel->next)
+        if (coord_rect_overlap(&bbox, &sel->u.c_rect))
+            break;
+    if (displaylist->sel && !sel)
+        return NULL;
+    if (displaylist->dc.pro != pro)
+        transform_from_to_count(rec->c, displaylist->dc.pro, rec->c, pro, count);
+
+    if (item_is_custom_poi(item) && rec->attrs[1].type == attr_icon_src)
+        icon=rec->attrs[1].u.str;
+    if (rec->attrs[0].type == attr_label)
+        label=rec->attrs[0].u.str;
+    if (label || item_is_custom_poi(item))
+        label=displaylist_label_get(displaylist, displaylist->m, displaylist->conv, label, icon);
+    di=display_add(entry, &item, count, rec->c, label, rec->attrs[2].type == attr_flags ? rec->attrs[2].u.num : 0,
+                   rec->repeated, rec->repeated_count);
+    di->dynamic=displaylist->dynamic;
+    if (!di->dynamic)
+        displaylist->static_seq++;
+    displaylist_grid_add(displaylist, di);
+#ifdef HAVE_PTHREAD
+    if (displaylist->loader)
+        item_hash_insert(displaylist->loader->added, &item, di);
+#endif
+    return di;
+}
 
 static void do_draw(struct displaylist *displaylist, int cancel, int flags) {
-    struct item *item;
-    int count,max=displaylist->dc.maxlen,workload=0;
-    int used=0;
-    struct coord *ca;
-    struct attr attr,attr2;
+    struct map_item_batch *batch;
+    int workload=0;
+    struct timeval start;
     enum projection pro;
-    int need_free=0;
+    enum graphics_phase phase;
 
-    if (max < ALLOCA_COORD_LIMIT) {
-        ca=g_alloca(sizeof(struct coord)*max);
-        need_free=0;
-    } else {
-        ca=g_malloc(sizeof(struct coord)*max);
-        need_free=1;
+    if (!displaylist->batch) {
+        displaylist->batch=map_item_batch_new(256, 16384, 16384, displaylist_batch_attrs, displaylist_batch_repeated);
+        displaylist->batch->filter=displaylist_batch_filter;
+        displaylist->batch->filter_priv=displaylist;
     }
 
     if (displaylist->order != displaylist->order_hashed || displaylist->layout != displaylist->layout_hashed) {
@@ -3216,6 +6111,9 @@ static void do_draw(struct displaylist *displaylist, int cancel, int flags) {
         displaylist->layout_hashed=displaylist->layout;
     }
     profile(0,NULL);
+    if (displaylist->budget)
+        gettimeofday(&start, NULL);
+    phase=graphics_phase_set(graphics_phase_fetch);
     pro=transform_get_projection(displaylist->dc.trans);
     while (!cancel) {
         if (!displaylist->msh)
@@ -3225,114 +6123,73 @@ static void do_draw(struct displaylist *displaylist, int cancel, int flags) {
             if (!displaylist->m) {
                 mapset_close(displaylist->msh);
                 displaylist->msh=NULL;
+                if (displaylist->progressive == 1) {
+                    graphics_phase_set(phase);
+                    displaylist_coarse_done(displaylist, flags);
+                    if (displaylist->workload) {
+                        /* let the intermediate frame show up */
+                        return;
+                    }
+                    graphics_phase_set(graphics_phase_fetch);
+                    continue;
+                }
                 break;
             }
+            if (displaylist->progressive == 2 && !displaylist_map_is_static(displaylist->m)) {
+                displaylist->m=NULL;
+                continue;
+            }
             displaylist->dc.pro=map_projection(displaylist->m);
             displaylist->conv=map_requires_conversion(displaylist->m);
+            displaylist->dynamic=!displaylist_map_is_static(displaylist->m);
             if (route_selection)
                 displaylist->sel=route_selection;
+            else if (displaylist->progressive == 1 && displaylist_map_is_static(displaylist->m))
+                displaylist->sel=transform_get_selection(displaylist->dc.trans, displaylist->dc.pro, displaylist->coarse_order);
             else
                 displaylist->sel=displaylist_get_selection(displaylist);
-            displaylist->mr=map_rect_new(displaylist->m, displaylist->sel);
-        }
-        if (displaylist->mr) {
-            while ((item=map_rect_get_item(displaylist->mr))) {
-                int label_count=0;
-                char *labels[2];
-                struct hash_entry *entry;
-                int coords_left;
-                if (item == &busy_item) {
-                    if (displaylist->workload) {
-                        if (need_free) {
-                            g_free(ca);
-                        }
+            if (displaylist->reused && displaylist->trans_loaded && displaylist_map_is_static(displaylist->m)) {
+                /* Only fetch what was not visible in the last load */
+                struct map_selection *loaded=transform_get_selection(displaylist->trans_loaded, displaylist->dc.pro,
+                                             displaylist->order);
+                struct map_selection *exposed=displaylist_selection_subtract(displaylist->sel, loaded);
+                map_selection_destroy(loaded);
+                map_selection_destroy(displaylist->sel);
+                displaylist->sel=exposed;
+            }
+            displaylist_map_open(displaylist);
+        }
+        if (displaylist->mr || displaylist->loader) {
+            for (;;) {
+                batch=displaylist_batch(displaylist);
+                if (displaylist->batch_pos == batch->count) {
+                    if (batch->busy && displaylist->workload) {
+                        /* the map is waiting for data, draw what is there in the meantime */
+                        batch->busy=0;
+                        graphics_phase_set(phase);
                         return;
-                    } else
-                        continue;
-                }
-                entry=get_hash_entry(displaylist, item->type);
-                if (!entry)
-                    continue;
-                count=item_coord_get_within_selection(item, ca, item->type < type_line ? 1: max, displaylist->sel);
-                /* abort if no coordinates within selection at all */
-                if (! count)
-                    continue;
-                /* handle overflow */
-                if (count == max) {
-                    /* get required space */
-                    item_coord_rewind(item);
-                    coords_left=item_coords_left(item);
-                    /* increase to required space, or double space if we couldn't get required space */
-                    if(coords_left > 0) {
-                        displaylist->dc.maxlen=(coords_left+2);
-                    } else {
-                        displaylist->dc.maxlen=max*2;
-                    }
-                    dbg(lvl_error,"point count overflow %d for %s "ITEM_ID_FMT". Increase to %d", count,item_to_name(item->type),
-                        ITEM_ID_ARGS(*item), displaylist->dc.maxlen);
-                    /* remember the new maximum */
-                    max=displaylist->dc.maxlen;
-                    /* get more memory */
-                    if(need_free)
-                        g_free(ca);
-                    ca=g_malloc(sizeof(struct coord)*(displaylist->dc.maxlen));
-                    need_free=1;
-                    /* try again to get coordinates */
-                    item_coord_rewind(item);
-                    count=item_coord_get_within_selection(item, ca, item->type < type_line ? 1: max, displaylist->sel);
-                    /* check if we got valid coordinates in second attempt. If not don't try to draw this at all */
-                    if(count <= 0) {
-                        continue;
                     }
+                    displaylist->batch_pos=0;
+                    if (!displaylist_fetch(displaylist))
+                        break;
+                    continue;
                 }
-                /* transform the coordinates */
-                if (displaylist->dc.pro != pro)
-                    transform_from_to_count(ca, displaylist->dc.pro, ca, pro, count);
-
-                /* remember the peak coordinates actually used */
-                if(used < count)
-                    used=count;
-
-                if (item_is_custom_poi(*item)) {
-                    if (item_attr_get(item, attr_icon_src, &attr2))
-                        labels[1]=map_convert_string(displaylist->m, attr2.u.str);
-                    else
-                        labels[1]=NULL;
-                    label_count=2;
-                } else {
-                    labels[1]=NULL;
-                    label_count=0;
-                }
-                if (item_attr_get(item, attr_label, &attr)) {
-                    labels[0]=attr.u.str;
-                    if (!label_count)
-                        label_count=2;
-                } else
-                    labels[0]=NULL;
-                if (displaylist->conv && label_count) {
-                    labels[0]=map_convert_string(displaylist->m, labels[0]);
-                    display_add(entry, item, count, ca, labels, label_count);
-                    map_convert_free(labels[0]);
-                } else
-                    display_add(entry, item, count, ca, labels, label_count);
-                if (labels[1])
-                    map_convert_free(labels[1]);
+                if (!displaylist_add_record(displaylist, &batch->items[displaylist->batch_pos++], pro))
+                    continue;
                 workload++;
-                if (workload == displaylist->workload) {
-                    if (need_free) {
-                        g_free(ca);
-                    }
+                if (displaylist_slice_done(displaylist, workload, &start)) {
+                    graphics_phase_set(phase);
                     return;
                 }
             }
-            map_rect_destroy(displaylist->mr);
+            displaylist_map_close(displaylist);
         }
         if (!route_selection)
             map_selection_destroy(displaylist->sel);
-        displaylist->mr=NULL;
         displaylist->sel=NULL;
         displaylist->m=NULL;
     }
+    graphics_phase_set(phase);
     profile(1,"process_selection\n");
     if (displaylist->idle_ev)
         event_remove_idle(displaylist->idle_ev);
@@ -3340,29 +6197,31 @@ static void do_draw(struct displaylist *displaylist, int cancel, int flags) {
     callback_destroy(displaylist->idle_cb);
     displaylist->idle_cb=NULL;
     displaylist->busy=0;
+    if (cancel)
+        graphics_frame_drop(displaylist->dc.gra, displaylist);
+    if (displaylist->reused) {
+        item_hash_destroy(displaylist->reused);
+        displaylist->reused=NULL;
+    }
+    if (displaylist->trans_loaded)
+        transform_destroy(displaylist->trans_loaded);
+    /* a progressive load keeps what it has fetched when it is cancelled, the next load only has to add the rest */
+    displaylist->partial=cancel && displaylist->budget;
+    displaylist->trans_loaded=cancel && !displaylist->partial ? NULL : transform_dup(displaylist->dc.trans);
+    displaylist->progressive=0;
+    displaylist_map_close(displaylist);
     graphics_process_selection(displaylist->dc.gra, displaylist);
     profile(1,"draw\n");
     if (! cancel)
         graphics_displaylist_draw(displaylist->dc.gra, displaylist, displaylist->dc.trans, displaylist->layout, flags);
-    map_rect_destroy(displaylist->mr);
     if (!route_selection)
         map_selection_destroy(displaylist->sel);
     mapset_close(displaylist->msh);
-    displaylist->mr=NULL;
     displaylist->sel=NULL;
     displaylist->m=NULL;
     displaylist->msh=NULL;
     profile(1,"callback\n");
     callback_call_1(displaylist->cb, cancel);
-    /* check if we can shrink item buffer next time */
-    if((displaylist->dc.maxlen > ALLOCA_COORD_LIMIT) && (used < ALLOCA_COORD_LIMIT)) {
-        dbg(lvl_debug, "Shrink memory. %d actually used", used);
-        displaylist->dc.maxlen=ALLOCA_COORD_LIMIT;
-    }
-    /* clean up if required */
-    if (need_free) {
-        g_free(ca);
-    }
     profile(0,"end\n");
 }
 
@@ -3375,12 +6234,31 @@ static void do_draw(struct displaylist *displaylist, int cancel, int flags) {
 void graphics_displaylist_draw(struct graphics *gra, struct displaylist *displaylist, struct transformation *trans,
                                struct layout *l, int flags) {
     int order=transform_get_order(trans);
+    int tiles=0,dynamic;
+    /* redrawing without loading again is a frame of its own */
+    graphics_frame_begin(gra, displaylist, l, displaylist->order);
     if(displaylist->dc.trans && displaylist->dc.trans!=trans)
         transform_destroy(displaylist->dc.trans);
     if(displaylist->dc.trans!=trans)
         displaylist->dc.trans=transform_dup(trans);
     displaylist->dc.gra=gra;
     displaylist->dc.mindist=flags&512?15:2;
+    if (l) {
+        order+=l->order_delta;
+        if (order < 0)
+            order=0;
+        /* tiles are only rendered from completely loaded displaylists */
+        tiles=!displaylist->busy && graphics_tiles_setup(gra, displaylist->dc.trans, l, order);
+    }
+    dynamic=!tiles && graphics_dynamic_setup(gra, displaylist, l, flags);
+    if (tiles && gra->dynamic)
+        graphics_dynamic_hide(gra->dynamic);
+    /* if only items of dynamic maps have changed, only the overlay has to be drawn again */
+    if (dynamic && graphics_dynamic_base_valid(gra->dynamic, displaylist, l, order)) {
+        graphics_dynamic_draw(gra->dynamic, displaylist, l, order);
+        graphics_frame_end(gra, displaylist);
+        return;
+    }
     // FIXME find a better place to set the background color
     if (l) {
         graphics_gc_set_background(gra->gc[0], &l->color);
@@ -3395,18 +6273,35 @@ void graphics_displaylist_draw(struct graphics *gra, struct displaylist *display
     if (!(flags & 2))
         graphics_draw_rectangle(gra, gra->gc[0], &gra->r.lu, gra->r.rl.x-gra->r.lu.x, gra->r.rl.y-gra->r.lu.y);
     if (l)	{
-        order+=l->order_delta;
-        xdisplay_draw(displaylist, gra, l, order>0?order:0);
+        if (displaylist->busy) {
+            if (gra->tiles)
+                graphics_tiles_hide(gra->tiles);
+            xdisplay_draw(displaylist, gra, l, order);
+        } else if (!tiles || !graphics_tiles_draw(gra->tiles, displaylist, l, order)) {
+            if (dynamic)
+                displaylist->dc.maps=display_maps_static;
+            xdisplay_draw(displaylist, gra, l, order);
+            displaylist->dc.maps=display_maps_all;
+        }
     }
     if (flags & 1)
         callback_list_call_attr_0(gra->cbl, attr_postdraw);
     if (!(flags & 4))
         graphics_draw_mode(gra, draw_mode_end);
+    if (dynamic) {
+        graphics_dynamic_draw(gra->dynamic, displaylist, l, order);
+        graphics_dynamic_base_drawn(gra->dynamic, displaylist, l, order);
+    }
+    /* intermediate frames of a load are part of the frame of the load */
+    if (!displaylist->busy)
+        graphics_frame_end(gra, displaylist);
 }
 
 static void graphics_load_mapset(struct graphics *gra, struct displaylist *displaylist, struct mapset *mapset,
                                  struct transformation *trans, struct layout *l, int async, struct callback *cb, int flags) {
     int order=transform_get_order(trans);
+    struct attr *budget=attr_search(gra->attrs, attr_draw_budget);
+    struct attr *threads=attr_search(gra->attrs, attr_load_threads);
 
     dbg(lvl_debug,"enter");
     if (displaylist->busy) {
@@ -3414,21 +6309,52 @@ static void graphics_load_mapset(struct graphics *gra, struct displaylist *displ
             return;
         do_draw(displaylist, 1, flags);
     }
-    xdisplay_free(displaylist);
+    if (l)
+        order+=l->order_delta;
+    if (order < 0)
+        order=0;
+    graphics_frame_begin(gra, displaylist, l, order);
+    if(displaylist->dc.trans && displaylist->dc.trans!=trans)
+        transform_destroy(displaylist->dc.trans);
+    if(displaylist->dc.trans!=trans) {
+        displaylist->dc.trans=transform_dup(trans);
+        if (graphics_tiles_setup(gra, displaylist->dc.trans, l, order))
+            graphics_tiles_extend_selection(gra->tiles, displaylist->dc.trans);
+    }
+    /* Items of the last load can be kept if only the visible area or the order has changed, or the last load was
+     * cancelled */
+    if (displaylist->trans_loaded && !route_selection && displaylist->ms == mapset && displaylist->layout == l
+            && transform_get_projection(displaylist->trans_loaded) == transform_get_projection(trans)) {
+        struct map_selection *sel=transform_get_selection(displaylist->dc.trans, transform_get_projection(trans), order);
+        int old_order=displaylist->order;
+        int covered=displaylist_reuse_items(displaylist, mapset, sel, order);
+        map_selection_destroy(sel);
+        /* The area of a cancelled load isn't complete, so everything has to be fetched again. So it has when
+         * zooming in, where the maps return more items, or when the layout draws types at the new order which
+         * weren't loaded. Only zooming out to types already loaded is covered by the kept items. */
+        if (displaylist->partial || order > old_order || !covered) {
+            transform_destroy(displaylist->trans_loaded);
+            displaylist->trans_loaded=NULL;
+        }
+    } else {
+        xdisplay_free(displaylist);
+        if (displaylist->trans_loaded)
+            transform_destroy(displaylist->trans_loaded);
+        displaylist->trans_loaded=NULL;
+    }
+    displaylist->partial=0;
     dbg(lvl_debug,"order=%d", order);
 
     displaylist->dc.gra=gra;
     displaylist->ms=mapset;
-    if(displaylist->dc.trans && displaylist->dc.trans!=trans)
-        transform_destroy(displaylist->dc.trans);
-    if(displaylist->dc.trans!=trans)
-        displaylist->dc.trans=transform_dup(trans);
     displaylist->workload=async ? 100 : 0;
+    displaylist->budget=async && budget ? budget->u.num : 0;
+    displaylist->threads=threads ? threads->u.num : 1;
+    displaylist->progressive=displaylist->budget > 0 && !route_selection && order > PROGRESSIVE_ORDER_DELTA;
+    displaylist->coarse_order=order-PROGRESSIVE_ORDER_DELTA;
     displaylist->cb=cb;
     displaylist->seq++;
-    if (l)
-        order+=l->order_delta;
-    displaylist->order=order>0?order:0;
+    displaylist->order=order;
     displaylist->busy=1;
     displaylist->layout=l;
     if (async) {
@@ -3535,8 +6461,17 @@ struct displaylist * graphics_displaylist_new(void) {
 }
 
 void graphics_displaylist_destroy(struct displaylist *displaylist) {
+    xdisplay_free(displaylist);
+    if (displaylist->label_strings)
+        g_hash_table_destroy(displaylist->label_strings);
     if(displaylist->dc.trans)
         transform_destroy(displaylist->dc.trans);
+    if(displaylist->trans_loaded)
+        transform_destroy(displaylist->trans_loaded);
+    label_placement_destroy(displaylist->labels);
+    graphics_frame_free_layers(&displaylist->frame);
+    if (displaylist->batch)
+        map_item_batch_destroy(displaylist->batch);
     g_free(displaylist);
 
 }
@@ -3699,10 +6634,11 @@ int graphics_displayitem_within_dist(struct displaylist *displaylist, struct dis
     int result;
     struct point *pa;
     int count;
-    if (displaylist->dc.maxlen < ALLOCA_COORD_LIMIT) {
-        pa=g_alloca(sizeof(struct point)*displaylist->dc.maxlen);
+    int size=MAX(displaylist->dc.maxlen, di->count);
+    if (size < ALLOCA_COORD_LIMIT) {
+        pa=g_alloca(sizeof(struct point)*size);
     } else {
-        pa=g_malloc(sizeof(struct point)*displaylist->dc.maxlen);
+        pa=g_malloc(sizeof(struct point)*size);
     }
 
     count=transform(displaylist->dc.trans, displaylist->dc.pro, di->c, pa, di->count, 0, 0, NULL);
@@ -3714,7 +6650,7 @@ int graphics_displayitem_within_dist(struct displaylist *displaylist, struct dis
     } else
         result = within_dist_polygon(p, pa, count, dist);
 
-    if (displaylist->dc.maxlen >= ALLOCA_COORD_LIMIT) {
+    if (size >= ALLOCA_COORD_LIMIT) {
         g_free(pa);
     }
     return result;
@@ -46,6 +46,19 @@ enum draw_mode_num {
     draw_mode_begin, draw_mode_end, draw_mode_begin_clear
 };
 
+/**
+ * @brief Phases of drawing the map, for timing measurements.
+ * @see graphics_phase_timing()
+ */
+enum graphics_phase {
+    graphics_phase_none,        /**< Anything not covered by another phase */
+    graphics_phase_fetch,       /**< Fetching items from the maps into the displaylist */
+    graphics_phase_transform,   /**< Transforming coordinates to screen coordinates */
+    graphics_phase_clip,        /**< Clipping to the screen */
+    graphics_phase_draw,        /**< Drawing calls of the graphics driver */
+    graphics_phase_last,
+};
+
 struct graphics_priv;
 struct graphics_font_priv;
 struct graphics_image_priv;
@@ -115,6 +128,23 @@ struct padding {
     int bottom;
 };
 
+/**
+ * @brief Primitives drawn with the same graphics context, see {@code graphics_methods.draw_batch}
+ *
+ * The points of all primitives of one kind are stored one after the other.
+ */
+struct graphics_batch {
+    int lines_count;            /**< Number of polylines */
+    int *lines_len;             /**< Number of points of each polyline */
+    struct point *lines;        /**< Points of all polylines */
+    int polygons_count;         /**< Number of polygons */
+    int *polygons_len;          /**< Number of points of each polygon */
+    struct point *polygons;     /**< Points of all polygons */
+    int circles_count;          /**< Number of circles */
+    struct point *circles;      /**< Center of each circle */
+    int *circles_r;             /**< Radius of each circle */
+};
+
 struct graphics_methods {
     void (*graphics_destroy)(struct graphics_priv *gr);
     void (*draw_mode)(struct graphics_priv *gr, enum draw_mode_num mode);
@@ -162,6 +192,24 @@ struct graphics_methods {
     navit_float (*get_dpi)(struct graphics_priv * gr);
     void (*draw_polygon_with_holes) (struct graphics_priv *gr, struct graphics_gc_priv *gc, struct point *p, int count,
                                      int hole_count, int* ccount, struct point **holes);
+    /** @brief Draw a batch of primitives sharing one graphics context (optional).
+     *
+     * Must give the same result as calling draw_lines(), draw_polygon() and draw_circle() for each primitive.
+     * As all primitives use the same context, the order in which they are drawn does not matter.
+     * If not implemented, the primitives are drawn one by one.
+     *
+     * @param gr graphics object
+     * @param gc graphics context of all primitives
+     * @param batch the primitives to draw
+     */
+    void (*draw_batch)(struct graphics_priv *gr, struct graphics_gc_priv *gc, struct graphics_batch *batch);
+    /** @brief Whether enabled overlays are composited over the graphics whenever the screen is updated.
+     *
+     * If set, an overlay can be drawn again without drawing the graphics it is shown on, and the graphics never
+     * holds what its overlays show. Drivers which merge the overlays into the graphics when drawing it ends leave
+     * this unset.
+     */
+    int composites_overlays;
 };
 
 
@@ -261,6 +309,10 @@ struct graphics_image *graphics_image_new_scaled_rotated(struct graphics *gra, c
 struct graphics_image *graphics_image_new(struct graphics *gra, char *path);
 void graphics_image_free(struct graphics *gra, struct graphics_image *img);
 void graphics_draw_mode(struct graphics *this_, enum draw_mode_num mode);
+void graphics_batch_begin(struct graphics *this_);
+void graphics_batch_end(struct graphics *this_);
+void graphics_phase_timing(int enable);
+void graphics_phase_get(double *ms);
 void graphics_draw_lines(struct graphics *this_, struct graphics_gc *gc, struct point *p, int count);
 void graphics_draw_circle(struct graphics *this_, struct graphics_gc *gc, struct point *p, int r);
 void graphics_draw_rectangle(struct graphics *this_, struct graphics_gc *gc, struct point *p, int w, int h);
@@ -290,6 +342,7 @@ void graphics_displaylist_close(struct displaylist_handle *dlh);
 struct displaylist *graphics_displaylist_new(void);
 void graphics_displaylist_destroy(struct displaylist *displaylist);
 struct map_selection *displaylist_get_selection(struct displaylist *displaylist);
+GList *displaylist_get_items_within_dist(struct displaylist *displaylist, struct point *p, int radius);
 GList *displaylist_get_clicked_list(struct displaylist *displaylist, struct point *p, int radius);
 struct item *graphics_displayitem_get_item(struct displayitem *di);
 int graphics_displayitem_get_coord_count(struct displayitem *di);
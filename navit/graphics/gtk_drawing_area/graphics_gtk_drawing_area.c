@@ -1088,7 +1088,9 @@ static struct graphics_methods graphics_methods = {
     NULL, /* show_native_keyboard */
     NULL, /* hide_native_keyboard */
     get_dpi, /* get dpi */
-    draw_polygon_with_holes
+    draw_polygon_with_holes,
+    NULL, /* draw_batch */
+    1, /* composites_overlays */
 };
 
 static struct graphics_priv *graphics_gtk_drawing_area_new_helper(struct graphics_methods *meth) {
@@ -893,7 +893,9 @@ static struct graphics_methods graphics_methods = {
     NULL, //show_native_keyboard
     NULL, //hide_native_keyboard
     get_dpi,
-    draw_polygon_with_holes
+    draw_polygon_with_holes,
+    NULL, //draw_batch
+    1, //composites_overlays
 };
 
 /* create new graphics context on given context */
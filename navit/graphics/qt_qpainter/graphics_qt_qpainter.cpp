@@ -354,6 +354,39 @@ static void draw_circle(struct graphics_priv *gr, struct graphics_gc_priv *gc, s
     gr->painter->drawArc(p->x-r/2, p->y-r/2, r, r, 0, 360*16);
 }
 
+//##############################################################################################################
+//# Description: Draws a batch of lines, polygons and circles sharing one gc
+//# Comment: Pen and brush are only set once for the whole batch
+//##############################################################################################################
+static void draw_batch(struct graphics_priv *gr, struct graphics_gc_priv *gc, struct graphics_batch *batch) {
+    struct point *p;
+    int i,j;
+
+    gr->painter->setPen(*gc->pen);
+    p=batch->lines;
+    for (i = 0 ; i < batch->lines_count ; i++) {
+        QPolygon polygon;
+        for (j = 0 ; j < batch->lines_len[i] ; j++)
+            polygon.putPoints(j, 1, p[j].x, p[j].y);
+        gr->painter->drawPolyline(polygon);
+        p+=batch->lines_len[i];
+    }
+    for (i = 0 ; i < batch->circles_count ; i++) {
+        int r=batch->circles_r[i];
+        gr->painter->drawArc(batch->circles[i].x-r/2, batch->circles[i].y-r/2, r, r, 0, 360*16);
+    }
+    if (batch->polygons_count)
+        gr->painter->setBrush(*gc->brush);
+    p=batch->polygons;
+    for (i = 0 ; i < batch->polygons_count ; i++) {
+        QPolygon polygon;
+        for (j = 0 ; j < batch->polygons_len[i] ; j++)
+            polygon.putPoints(j, 1, p[j].x, p[j].y);
+        gr->painter->drawPolygon(polygon);
+        p+=batch->polygons_len[i];
+    }
+}
+
 //##############################################################################################################
 //# Description:
 //# Comment:
@@ -665,6 +698,9 @@ static struct graphics_methods graphics_methods = {
     set_attr,
     NULL, /* show_native_keyboard */
     NULL, /* hide_native_keyboard */
+    NULL, /* get_dpi */
+    NULL, /* draw_polygon_with_holes */
+    draw_batch,
 };
 
 //##############################################################################################################
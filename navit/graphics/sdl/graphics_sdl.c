@@ -284,12 +284,28 @@ static void image_free(struct graphics_priv *gr, struct graphics_image_priv * gi
     g_free(gi);
 }
 
+static int overlay_hidden(struct graphics_priv *gr) {
+    return (gr->overlay_parent && !gr->overlay_parent->overlay_enable) || (gr->overlay_parent
+            && gr->overlay_parent->overlay_enable && !gr->overlay_enable);
+}
+
+static Uint32 gc_color(struct graphics_priv *gr, struct graphics_gc_priv *gc) {
+    return SDL_MapRGBA(gr->screen->format, gc->fore_r, gc->fore_g, gc->fore_b, gc->fore_a);
+}
+
+static void raster_polygon_color(struct graphics_priv *gr, struct point *p, int count, int hole_count, int* ccount,
+                                 struct point **holes, Uint32 color) {
+    if(gr->aa)
+        raster_aapolygon_with_holes(gr->screen, p, count, hole_count, ccount, holes, color);
+    else
+        raster_polygon_with_holes(gr->screen, p, count, hole_count, ccount, holes, color);
+}
+
 static void draw_polygon_with_holes (struct graphics_priv *gr, struct graphics_gc_priv *gc, struct point *p, int count,
                                      int hole_count, int* ccount, struct point **holes) {
 
     dbg(lvl_debug, "draw_polygon_with_holes: %p ", gc);
-    if ((gr->overlay_parent && !gr->overlay_parent->overlay_enable) || (gr->overlay_parent
-            && gr->overlay_parent->overlay_enable && !gr->overlay_enable) ) {
+    if (overlay_hidden(gr)) {
         return;
     }
 
@@ -301,21 +317,7 @@ static void draw_polygon_with_holes (struct graphics_priv *gr, struct graphics_g
      * coordinates for SDL primitives there.
      */
 
-    if(gr->aa) {
-        raster_aapolygon_with_holes(gr->screen, p, count, hole_count, ccount, holes,
-                                    SDL_MapRGBA(gr->screen->format,
-                                                gc->fore_r,
-                                                gc->fore_g,
-                                                gc->fore_b,
-                                                gc->fore_a));
-    } else {
-        raster_polygon_with_holes(gr->screen, p, count, hole_count, ccount, holes,
-                                  SDL_MapRGBA(gr->screen->format,
-                                              gc->fore_r,
-                                              gc->fore_g,
-                                              gc->fore_b,
-                                              gc->fore_a));
-    }
+    raster_polygon_color(gr, p, count, hole_count, ccount, holes, gc_color(gr, gc));
 }
 
 static void draw_polygon(struct graphics_priv *gr, struct graphics_gc_priv *gc, struct point *p, int count) {
@@ -348,12 +350,7 @@ static void draw_rectangle(struct graphics_priv *gr, struct graphics_gc_priv *gc
                             gc->fore_a));
 }
 
-static void draw_circle(struct graphics_priv *gr, struct graphics_gc_priv *gc, struct point *p, int r) {
-    if ((gr->overlay_parent && !gr->overlay_parent->overlay_enable) || (gr->overlay_parent
-            && gr->overlay_parent->overlay_enable && !gr->overlay_enable) ) {
-        return;
-    }
-
+static void draw_circle_color(struct graphics_priv *gr, struct point *p, int r, Uint32 color) {
     /* FIXME: does not quite match gtk */
 
     /* hack for osd compass.. why is this needed!? */
@@ -362,29 +359,15 @@ static void draw_circle(struct graphics_priv *gr, struct graphics_gc_priv *gc, s
     }
 
     if(gr->aa) {
-        raster_aacircle(gr->screen, p->x, p->y, r,
-                        SDL_MapRGBA(gr->screen->format,
-                                    gc->fore_r,
-                                    gc->fore_g,
-                                    gc->fore_b,
-                                    gc->fore_a));
+        raster_aacircle(gr->screen, p->x, p->y, r, color);
     } else {
-        raster_circle(gr->screen, p->x, p->y, r,
-                      SDL_MapRGBA(gr->screen->format,
-                                  gc->fore_r,
-                                  gc->fore_g,
-                                  gc->fore_b,
-                                  gc->fore_a));
+        raster_circle(gr->screen, p->x, p->y, r, color);
     }
 }
 
 
-static void draw_lines(struct graphics_priv *gr, struct graphics_gc_priv *gc, struct point *p, int count) {
-    if ((gr->overlay_parent && !gr->overlay_parent->overlay_enable) || (gr->overlay_parent
-            && gr->overlay_parent->overlay_enable && !gr->overlay_enable) ) {
-        return;
-    }
-
+static void draw_lines_color(struct graphics_priv *gr, struct graphics_gc_priv *gc, struct point *p, int count,
+                             Uint32 color) {
     /* you might expect lines to be simpler than the other shapes.
        but, that would be wrong. 1 line can generate 1 polygon + 2 circles
        and even worse, we have to calculate their parameters!
@@ -409,19 +392,9 @@ static void draw_lines(struct graphics_priv *gr, struct graphics_gc_priv *gc, st
 
         if(lw == 1) {
             if(gr->aa) {
-                raster_aaline(gr->screen, p[i].x, p[i].y, p[i+1].x, p[i+1].y,
-                              SDL_MapRGBA(gr->screen->format,
-                                          gc->fore_r,
-                                          gc->fore_g,
-                                          gc->fore_b,
-                                          gc->fore_a));
+                raster_aaline(gr->screen, p[i].x, p[i].y, p[i+1].x, p[i+1].y, color);
             } else {
-                raster_line(gr->screen, p[i].x, p[i].y, p[i+1].x, p[i+1].y,
-                            SDL_MapRGBA(gr->screen->format,
-                                        gc->fore_r,
-                                        gc->fore_g,
-                                        gc->fore_b,
-                                        gc->fore_a));
+                raster_line(gr->screen, p[i].x, p[i].y, p[i+1].x, p[i+1].y, color);
             }
         } else {
             /* there is probably a much simpler way but this works ok */
@@ -466,7 +439,7 @@ static void draw_lines(struct graphics_priv *gr, struct graphics_gc_priv *gc, st
             vert[3].x = p[i+1].x + x_lw_adj;
             vert[3].y = p[i+1].y - y_lw_adj;
 
-            draw_polygon(gr, gc, vert, 4);
+            raster_polygon_color(gr, vert, 4, 0, NULL, NULL, color);
 
             /* draw small circles at the ends. this looks better than nothing, and slightly
              * better than the triangle used by graphics_opengl, but is more expensive.
@@ -478,15 +451,51 @@ static void draw_lines(struct graphics_priv *gr, struct graphics_gc_priv *gc, st
             /* now some circular endcaps, if the width is over 2 */
             if(lw > 2) {
                 if(i == 0) {
-                    draw_circle(gr, gc, &p[i], lw/2);
+                    draw_circle_color(gr, &p[i], lw/2, color);
                 }
                 /* we truncate on the divide on purpose, so we don't go outside the line */
-                draw_circle(gr, gc, &p[i+1], lw/2);
+                draw_circle_color(gr, &p[i+1], lw/2, color);
             }
         }
     }
 }
 
+static void draw_lines(struct graphics_priv *gr, struct graphics_gc_priv *gc, struct point *p, int count) {
+    if (overlay_hidden(gr)) {
+        return;
+    }
+    draw_lines_color(gr, gc, p, count, gc_color(gr, gc));
+}
+
+/**
+ * @brief Draws a batch of primitives sharing one gc
+ *
+ * The overlay visibility check and the color lookup are done once for the whole batch
+ * instead of once per primitive.
+ */
+static void draw_batch(struct graphics_priv *gr, struct graphics_gc_priv *gc, struct graphics_batch *batch) {
+    Uint32 color;
+    struct point *p;
+    int i;
+
+    if (overlay_hidden(gr)) {
+        return;
+    }
+    color=gc_color(gr, gc);
+    p=batch->lines;
+    for (i = 0 ; i < batch->lines_count ; i++) {
+        draw_lines_color(gr, gc, p, batch->lines_len[i], color);
+        p+=batch->lines_len[i];
+    }
+    p=batch->polygons;
+    for (i = 0 ; i < batch->polygons_count ; i++) {
+        raster_polygon_color(gr, p, batch->polygons_len[i], 0, NULL, NULL, color);
+        p+=batch->polygons_len[i];
+    }
+    for (i = 0 ; i < batch->circles_count ; i++)
+        draw_circle_color(gr, &batch->circles[i], batch->circles_r[i], color);
+}
+
 
 static void set_pixel(SDL_Surface *surface, int x, int y, Uint8 r2, Uint8 g2, Uint8 b2, Uint8 a2) {
     if(x<0 || y<0 || x>=surface->w || y>=surface->h) {
@@ -822,7 +831,8 @@ static struct graphics_methods graphics_methods = {
     NULL, /* show_native_keyboard */
     NULL, /* hide_native_keyboard */
     NULL, /* get_dpi */
-    draw_polygon_with_holes
+    draw_polygon_with_holes,
+    draw_batch,
 };
 
 static struct graphics_priv *overlay_new(struct graphics_priv *gr, struct graphics_methods *meth, struct point *p,
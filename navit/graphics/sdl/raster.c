@@ -17,6 +17,12 @@
 
 #include <math.h>
 #include <glib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
 
 #include "raster.h"
 
@@ -290,6 +296,42 @@ static void raster_PutPixel(SDL_Surface *surface, Sint16 x, Sint16 y, Uint32 col
     }
 }
 
+/* blend a 32 bit pixel, input color in destination format, as MODIFIED_ALPHA_PIXEL_ROUTINE */
+
+static inline void raster_blend32(SDL_PixelFormat *format, Uint32 *pixel, Uint32 color, Uint8 alpha) {
+    Uint32 Rmask = format->Rmask, Gmask = format->Gmask, Bmask = format->Bmask, Amask = format->Amask;
+    Uint32 R = 0, G = 0, B = 0, A = 0;
+
+    if (alpha == 255) {
+        *pixel = color;
+    } else {
+        Uint32 Rshift, Gshift, Bshift, Ashift;
+        Uint32 dc = *pixel;
+        Uint32 dR = (color & Rmask), dG = (color & Gmask), dB = (color & Bmask);
+        Uint32 surfaceAlpha, preMultR, preMultG, preMultB;
+        Uint32 aTmp;
+
+        Rshift = format->Rshift;
+        Gshift = format->Gshift;
+        Bshift = format->Bshift;
+        Ashift = format->Ashift;
+
+        preMultR = (alpha * (dR>>Rshift));
+        preMultG = (alpha * (dG>>Gshift));
+        preMultB = (alpha * (dB>>Bshift));
+
+        surfaceAlpha = ((dc & Amask) >> Ashift);
+        aTmp = (255 - alpha);
+        if ((A = 255 - ((aTmp * (255 - surfaceAlpha)) >> 8 ))) {
+            aTmp *= surfaceAlpha;
+            R = (preMultR + ((aTmp * ((dc & Rmask) >> Rshift)) >> 8)) / A << Rshift & Rmask;
+            G = (preMultG + ((aTmp * ((dc & Gmask) >> Gshift)) >> 8)) / A << Gshift & Gmask;
+            B = (preMultB + ((aTmp * ((dc & Bmask) >> Bshift)) >> 8)) / A << Bshift & Bmask;
+        }
+        *pixel = R | G | B | (A << Ashift & Amask);
+    }
+}
+
 /* PutPixel routine with alpha blending, input color in destination format */
 
 /* New, faster routine - default blending pixel */
@@ -416,36 +458,7 @@ static void raster_PutPixelAlpha(SDL_Surface * surface, Sint16 x, Sint16 y, Uint
 #ifdef MODIFIED_ALPHA_PIXEL_ROUTINE
 
         case 4: {		/* Probably :-) 32-bpp */
-            if (alpha == 255) {
-                *((Uint32 *) surface->pixels + y * surface->pitch / 4 + x) = color;
-            } else {
-                Uint32 Rshift, Gshift, Bshift, Ashift;
-                Uint32 *pixel = (Uint32 *) surface->pixels + y * surface->pitch / 4 + x;
-                Uint32 dc = *pixel;
-                Uint32 dR = (color & Rmask), dG = (color & Gmask), dB = (color & Bmask);
-                Uint32 surfaceAlpha, preMultR, preMultG, preMultB;
-                Uint32 aTmp;
-
-                Rshift = surface->format->Rshift;
-                Gshift = surface->format->Gshift;
-                Bshift = surface->format->Bshift;
-                Ashift = surface->format->Ashift;
-
-                preMultR = (alpha * (dR>>Rshift));
-                preMultG = (alpha * (dG>>Gshift));
-                preMultB = (alpha * (dB>>Bshift));
-
-                surfaceAlpha = ((dc & Amask) >> Ashift);
-                aTmp = (255 - alpha);
-                if ((A = 255 - ((aTmp * (255 - surfaceAlpha)) >> 8 ))) {
-                    aTmp *= surfaceAlpha;
-                    R = (preMultR + ((aTmp * ((dc & Rmask) >> Rshift)) >> 8)) / A << Rshift & Rmask;
-                    G = (preMultG + ((aTmp * ((dc & Gmask) >> Gshift)) >> 8)) / A << Gshift & Gmask;
-                    B = (preMultB + ((aTmp * ((dc & Bmask) >> Bshift)) >> 8)) / A << Bshift & Bmask;
-                }
-                *pixel = R | G | B | (A << Ashift & Amask);
-
-            }
+            raster_blend32(surface->format, (Uint32 *) surface->pixels + y * surface->pitch / 4 + x, color, alpha);
         }
         break;
 #endif
@@ -505,6 +518,22 @@ static int raster_pixelColorWeightNolock(SDL_Surface * dst, Sint16 x, Sint16 y,
 
 
 
+/* fill a span of a 32 bit surface, four pixels per store where SIMD is available */
+
+static inline void raster_span32(Uint32 *pixel, int w, Uint32 color) {
+#if defined(__SSE2__)
+    __m128i c = _mm_set1_epi32(color);
+    for (; w >= 4; w -= 4, pixel += 4)
+        _mm_storeu_si128((__m128i *)pixel, c);
+#elif defined(__ARM_NEON)
+    uint32x4_t c = vdupq_n_u32(color);
+    for (; w >= 4; w -= 4, pixel += 4)
+        vst1q_u32(pixel, c);
+#endif
+    while (w-- > 0)
+        *pixel++ = color;
+}
+
 static inline void raster_hline(SDL_Surface * dst, Sint16 x1, Sint16 x2, Sint16 y, Uint32 color) {
 #if 1
     SDL_Rect l;
@@ -516,6 +545,17 @@ static inline void raster_hline(SDL_Surface * dst, Sint16 x1, Sint16 x2, Sint16
         x2=tmp;
     }
 
+    /* 32 bit surfaces are filled directly, saving the per call overhead of SDL_FillRect for the short
+       spans polygons and circles are made of */
+    if (dst->format->BytesPerPixel == 4 && !SDL_MUSTLOCK(dst)) {
+        int left = clip_xmin(dst), right = clip_xmax(dst);
+        if (y < clip_ymin(dst) || y > clip_ymax(dst) || x2 < left || x1 > right)
+            return;
+        raster_span32((Uint32 *)((Uint8 *)dst->pixels + y * dst->pitch) + MAX(x1, left), MIN(x2, right) - MAX(x1, left) + 1,
+                      color);
+        return;
+    }
+
     l.x=x1;
     l.y=y;
     l.w=x2-x1+1;
@@ -937,12 +977,23 @@ void raster_line(SDL_Surface *dst, int16_t x1, int16_t y1, int16_t x2, int16_t y
 #define AAlevels 256
 #define AAbits 8
 
+/* weighted pixel of an anti-aliased line, blending inline on 32 bit surfaces */
+
+static inline void raster_aapixel(SDL_Surface * dst, Sint16 x, Sint16 y, Uint32 color, Uint8 weight, int bpp32) {
+    if (bpp32) {
+        if (x >= clip_xmin(dst) && x <= clip_xmax(dst) && y >= clip_ymin(dst) && y <= clip_ymax(dst))
+            raster_blend32(dst->format, (Uint32 *)((Uint8 *)dst->pixels + y * dst->pitch) + x, color, weight);
+    } else
+        raster_pixelColorWeightNolock(dst, x, y, color, weight);
+}
+
 static void raster_aalineColorInt(SDL_Surface * dst, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color,
                                   int draw_endpoint) {
     Sint32 xx0, yy0, xx1, yy1;
     Uint32 intshift, erracc, erradj;
     Uint32 erracctmp, wgt;
     int dx, dy, tmp, xdir, y0p1, x0pxdir;
+    int bpp32;
 
     /*
      * Check visibility of clipping rectangle
@@ -1038,6 +1089,11 @@ static void raster_aalineColorInt(SDL_Surface * dst, Sint16 x1, Sint16 y1, Sint1
      * Draw the initial pixel in the foreground color
      */
     raster_pixelColorNolock(dst, x1, y1, color);
+#ifdef MODIFIED_ALPHA_PIXEL_ROUTINE
+    bpp32 = dst->format->BytesPerPixel == 4;
+#else
+    bpp32 = 0;
+#endif
 
     /*
      * x-major or y-major?
@@ -1076,8 +1132,8 @@ static void raster_aalineColorInt(SDL_Surface * dst, Sint16 x1, Sint16 y1, Sint1
              * the paired pixel.
              */
             wgt = (erracc >> intshift) & 255;
-            raster_pixelColorWeightNolock (dst, xx0, yy0, color, 255 - wgt);
-            raster_pixelColorWeightNolock (dst, x0pxdir, yy0, color, wgt);
+            raster_aapixel (dst, xx0, yy0, color, 255 - wgt, bpp32);
+            raster_aapixel (dst, x0pxdir, yy0, color, wgt, bpp32);
         }
 
     } else {
@@ -1114,8 +1170,8 @@ static void raster_aalineColorInt(SDL_Surface * dst, Sint16 x1, Sint16 y1, Sint1
              * the paired pixel.
              */
             wgt = (erracc >> intshift) & 255;
-            raster_pixelColorWeightNolock (dst, xx0, yy0, color, 255 - wgt);
-            raster_pixelColorWeightNolock (dst, xx0, y0p1, color, wgt);
+            raster_aapixel (dst, xx0, yy0, color, 255 - wgt, bpp32);
+            raster_aapixel (dst, xx0, y0p1, color, wgt, bpp32);
         }
     }
 
@@ -2012,6 +2068,49 @@ void raster_aapolygon_with_holes (SDL_Surface *s, struct point *p, int count, in
     raster_polygon_with_holes(s, p, count, hole_count, ccount, holes, col);
 }
 
+/* edge of a polygon for raster_polygon_with_holes, with y1 < y2 */
+struct raster_edge {
+    int x1, y1;
+    int x2, y2;
+    int yend;       /* first scanline no longer crossing the edge */
+};
+
+/* edge table and active edges, only growing, like gfxPrimitivesPolyIntsGlobal */
+static struct raster_edge *raster_edges;
+static int *raster_active, *raster_ints;
+static int raster_edges_allocated;
+
+static int raster_edge_compare(const void *a, const void *b) {
+    return ((const struct raster_edge *) a)->y1 - ((const struct raster_edge *) b)->y1;
+}
+
+static int raster_add_edges(struct raster_edge *e, struct point *p, int count, int maxy) {
+    int i, n = 0;
+    struct point *p1, *p2 = &p[count-1];
+
+    for (i = 0; i < count; i++) {
+        p1 = p2;
+        p2 = &p[i];
+        if (p1->y == p2->y)
+            continue;
+        if (p1->y < p2->y) {
+            e[n].x1 = p1->x;
+            e[n].y1 = p1->y;
+            e[n].x2 = p2->x;
+            e[n].y2 = p2->y;
+        } else {
+            e[n].x1 = p2->x;
+            e[n].y1 = p2->y;
+            e[n].x2 = p1->x;
+            e[n].y2 = p1->y;
+        }
+        /* the last scanline also includes edges ending on it */
+        e[n].yend = e[n].y2 + (e[n].y2 == maxy);
+        n++;
+    }
+    return n;
+}
+
 /**
  * @brief render filled polygon with holes by raycasting along the y axis
  *
@@ -2025,6 +2124,10 @@ void raster_aapolygon_with_holes (SDL_Surface *s, struct point *p, int count, in
  * But this could be fixed by never starting a line on a vertex that came from a
  * hole intersection.
  *
+ * The edges are sorted by their upper end once, and each scanline only looks at the
+ * edges crossing it, whose intersections stay almost sorted from one scanline to the next.
+ * Scanlines outside the clipping rectangle are skipped.
+ *
  * @param s SDL surface to draw on
  * @param p Array of points containing the outer polygon
  * @param count Number of points in outer polygon
@@ -2035,11 +2138,12 @@ void raster_aapolygon_with_holes (SDL_Surface *s, struct point *p, int count, in
  */
 void raster_polygon_with_holes (SDL_Surface *s, struct point *p, int count, int hole_count, int* ccount,
                                 struct point **holes, uint32_t col) {
-    int vertex_max;
-    int vertex_count;
-    int * vertexes;
+    int edge_max;
+    int edge_count;
+    int active_count;
+    int next;
     int miny, maxy;
-    int i;
+    int i, j;
     int y;
 
     /* Check visibility of clipping rectangle */
@@ -2052,19 +2156,6 @@ void raster_polygon_with_holes (SDL_Surface *s, struct point *p, int count, int
         return;
     }
 
-    /*
-     * Prepare a buffer for vertexes. Maximum number of vertexes is the number of points
-     * of polygon and holes
-     */
-    vertex_max = count;
-    for(i =0; i < hole_count; i ++) {
-        vertex_max += ccount[i];
-    }
-    vertexes = g_malloc(sizeof(int) * vertex_max);
-    if(vertexes == NULL) {
-        return;
-    }
-
     /* calculate y min and max coordinate. We can ignore the holes, as we won't render hole
      * parts "bigger" than the surrounding polygon.*/
     miny = p[0].y;
@@ -2076,86 +2167,64 @@ void raster_polygon_with_holes (SDL_Surface *s, struct point *p, int count, int
             maxy = p[i].y;
         }
     }
+    if (miny > clip_ymax(s) || maxy < clip_ymin(s))
+        return;
 
-    /* scan y coordinates from miny to maxy */
-    for(y = miny; y <= maxy ; y ++) {
-        int h;
-        vertex_count=0;
-        /* calculate the intersecting points of the polygon with current y and add to vertexes array*/
-        for (i = 0; (i < count); i++) {
-            int ind1;
-            int ind2;
-            struct point p1;
-            struct point p2;
-
-            if (!i) {
-                ind1 = count - 1;
-                ind2 = 0;
-            } else {
-                ind1 = i - 1;
-                ind2 = i;
-            }
-            p1.y = p[ind1].y;
-            p2.y = p[ind2].y;
-            if (p1.y < p2.y) {
-                p1.x = p[ind1].x;
-                p2.x = p[ind2].x;
-            } else if (p1.y > p2.y) {
-                p2.y = p[ind1].y;
-                p1.y = p[ind2].y;
-                p2.x = p[ind1].x;
-                p1.x = p[ind2].x;
-            } else {
-                continue;
-            }
-            if ( ((y >= p1.y) && (y < p2.y)) || ((y == maxy) && (y > p1.y) && (y <= p2.y)) ) {
-                vertexes[vertex_count++] = ((65536 * (y - p1.y)) / (p2.y - p1.y)) * (p2.x - p1.x) + (65536 * p1.x);
-            }
+    /*
+     * Prepare the edge table. Maximum number of edges is the number of points
+     * of polygon and holes
+     */
+    edge_max = count;
+    for(i =0; i < hole_count; i ++) {
+        edge_max += ccount[i];
+    }
+    if (raster_edges_allocated < edge_max) {
+        raster_edges = g_renew(struct raster_edge, raster_edges, edge_max);
+        raster_active = g_renew(int, raster_active, edge_max);
+        raster_ints = g_renew(int, raster_ints, edge_max);
+        raster_edges_allocated = edge_max;
+    }
+    edge_count = raster_add_edges(raster_edges, p, count, maxy);
+    for(i = 0; i < hole_count; i ++) {
+        if (ccount[i] > 0)
+            edge_count += raster_add_edges(raster_edges + edge_count, holes[i], ccount[i], maxy);
+    }
+    qsort(raster_edges, edge_count, sizeof(struct raster_edge), raster_edge_compare);
+
+    /* scan y coordinates from miny to maxy, within the clipping rectangle */
+    y = MAX(miny, clip_ymin(s));
+    maxy = MIN(maxy, clip_ymax(s));
+    active_count = 0;
+    next = 0;
+    for(; y <= maxy ; y ++) {
+        /* activate the edges starting on or above this scanline */
+        while (next < edge_count && raster_edges[next].y1 <= y) {
+            if (raster_edges[next].yend > y)
+                raster_active[active_count++] = next;
+            next++;
         }
-        for(h= 0; h < hole_count; h ++) {
-            /* add the intersecting points from the holes as well */
-            for (i = 0; (i < ccount[h]); i++) {
-                int ind1;
-                int ind2;
-                struct point p1;
-                struct point p2;
-
-                if (!i) {
-                    ind1 = ccount[h] - 1;
-                    ind2 = 0;
-                } else {
-                    ind1 = i - 1;
-                    ind2 = i;
-                }
-                p1.y = holes[h][ind1].y;
-                p2.y = holes[h][ind2].y;
-                if (p1.y < p2.y) {
-                    p1.x = holes[h][ind1].x;
-                    p2.x = holes[h][ind2].x;
-                } else if (p1.y > p2.y) {
-                    p2.y = holes[h][ind1].y;
-                    p1.y = holes[h][ind2].y;
-                    p2.x = holes[h][ind1].x;
-                    p1.x = holes[h][ind2].x;
-                } else {
-                    continue;
-                }
-                if ( ((y >= p1.y) && (y < p2.y)) || ((y == maxy) && (y > p1.y) && (y <= p2.y)) ) {
-                    vertexes[vertex_count++] = ((65536 * (y - p1.y)) / (p2.y - p1.y)) * (p2.x - p1.x) + (65536 * p1.x);
-                }
-            }
+        /* calculate the intersecting points of the active edges with current y, dropping finished edges.
+           The intersections are kept sorted by insertion, as they rarely change order. */
+        for (i = 0, j = 0; i < active_count; i++) {
+            struct raster_edge *e = &raster_edges[raster_active[i]];
+            int x, k;
+            if (e->yend <= y)
+                continue;
+            raster_active[j] = raster_active[i];
+            x = ((65536 * (y - e->y1)) / (e->y2 - e->y1)) * (e->x2 - e->x1) + (65536 * e->x1);
+            for (k = j; k > 0 && raster_ints[k-1] > x; k--)
+                raster_ints[k] = raster_ints[k-1];
+            raster_ints[k] = x;
+            j++;
         }
-
-        /* sort the vertexes */
-        qsort(vertexes, vertex_count, sizeof(int), gfxPrimitivesCompareInt);
+        active_count = j;
         /* draw the lines between every second vertex */
-        for (i = 0; (i < vertex_count); i +=2) {
+        for (i = 0; i + 1 < active_count; i +=2) {
             Sint16 xa;
             Sint16 xb;
-            xa = (vertexes[i] >> 16);
-            xb = (vertexes[i+1] >> 16);
+            xa = (raster_ints[i] >> 16);
+            xb = (raster_ints[i+1] >> 16);
             raster_hline(s, xa+1, xb, y, col);
         }
     }
-    g_free(vertexes);
 }
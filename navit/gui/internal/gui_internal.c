@@ -2305,18 +2305,14 @@ static int gui_internal_set_attr(struct gui_priv *this, struct attr *attr) {
 }
 
 static void gui_internal_dbus_signal(struct gui_priv *this, struct point *p) {
-    struct displaylist_handle *dlh;
-    struct displaylist *display;
-    struct displayitem *di;
+    GList *l,*curr;
     struct attr cb,**attr_list=NULL;
     int valid=0;
 
-    display=navit_get_displaylist(this->nav);
-    dlh=graphics_displaylist_open(display);
-    while ((di=graphics_displaylist_next(dlh))) {
-        struct item *item=graphics_displayitem_get_item(di);
-        if (item_is_point(*item) && graphics_displayitem_get_displayed(di) &&
-                graphics_displayitem_within_dist(display, di, p, this->radius)) {
+    l=displaylist_get_items_within_dist(navit_get_displaylist(this->nav), p, this->radius);
+    for (curr=l ; curr ; curr=g_list_next(curr)) {
+        struct item *item=graphics_displayitem_get_item(curr->data);
+        if (item_is_point(*item) && graphics_displayitem_get_displayed(curr->data)) {
             struct map_rect *mr=map_rect_new(item->map, NULL);
             struct item *itemo=map_rect_get_item_byid(mr, item->id_hi, item->id_lo);
             struct attr attr;
@@ -2325,7 +2321,7 @@ static void gui_internal_dbus_signal(struct gui_priv *this, struct point *p) {
             map_rect_destroy(mr);
         }
     }
-    graphics_displaylist_close(dlh);
+    g_list_free(l);
     if (attr_list && navit_get_attr(this->nav, attr_callback_list, &cb, NULL))
         callback_list_call_attr_4(cb.u.callback_list, attr_command, "dbus_send_signal", attr_list, NULL, &valid);
     attr_list_free(attr_list);
@@ -123,16 +123,13 @@ private:
 #include "gui_qml.moc"
 
 static void gui_qml_dbus_signal(struct gui_priv *this_, struct point *p) {
-    struct displaylist_handle *dlh;
-    struct displaylist *display;
-    struct displayitem *di;
+    GList *l,*curr;
 
-    display=navit_get_displaylist(this_->nav);
-    dlh=graphics_displaylist_open(display);
-    while ((di=graphics_displaylist_next(dlh))) {
+    l=displaylist_get_items_within_dist(navit_get_displaylist(this_->nav), p, 10);
+    for (curr=l ; curr ; curr=g_list_next(curr)) {
+        struct displayitem *di=(struct displayitem *)curr->data;
         struct item *item=graphics_displayitem_get_item(di);
-        if (item_is_point(*item) && graphics_displayitem_get_displayed(di) &&
-                graphics_displayitem_within_dist(display, di, p, 10)) {
+        if (item_is_point(*item) && graphics_displayitem_get_displayed(di)) {
             struct map_rect *mr=map_rect_new(item->map, NULL);
             struct item *itemo=map_rect_get_item_byid(mr, item->id_hi, item->id_lo);
             struct attr attr;
@@ -148,7 +145,7 @@ static void gui_qml_dbus_signal(struct gui_priv *this_, struct point *p) {
             map_rect_destroy(mr);
         }
     }
-    graphics_displaylist_close(dlh);
+    g_list_free(l);
 }
 
 static void gui_qml_button(void *data, int pressed, int button, struct point *p) {
@@ -164,6 +164,36 @@ int item_coord_get(struct item *it, struct coord *c, int count) {
     return it->meth->item_coord_get(it->priv_data, c, count);
 }
 
+/**
+ * @brief Gets the next coordinates from an item, without copying them if possible
+ *
+ * If the map supports it, this function points {@code c} directly to the remaining coordinates of the item in map
+ * memory and returns all of them at once. Otherwise (e.g. on big-endian hosts or for maps which do not store
+ * coordinates as plain arrays), it behaves like {@code item_coord_get()}, copying up to {@code count} coordinates
+ * to {@code buf} and pointing {@code c} to it. In either case the "coordinate pointer" is advanced by the number
+ * of coordinates returned, so calling this function until it returns 0 visits all coordinates.
+ *
+ * The coordinates must not be modified and are only valid until the next item is retrieved from the map rect.
+ *
+ * @param it The map item whose coordinates to retrieve. This must be the active item, i.e. the last one retrieved from the
+ * {@code map_rect}. There can only be one active item per {@code map_rect}.
+ * @param c Receives a pointer to the coordinates
+ * @param buf Fallback buffer, which must be at least {@code count * sizeof(struct coord)} bytes in size
+ * @param count Size of {@code buf}
+ *
+ * @return The number of coordinates available at {@code *c}
+ */
+int item_coord_get_span(struct item *it, struct coord **c, struct coord *buf, int count) {
+    int ret;
+    if (it->meth->item_coord_get_span) {
+        ret=it->meth->item_coord_get_span(it->priv_data, c);
+        if (ret >= 0)
+            return ret;
+    }
+    *c=buf;
+    return it->meth->item_coord_get(it->priv_data, buf, count);
+}
+
 /**
  * @brief Gets the number of coordinates left for this item
  *
@@ -84,6 +84,7 @@ struct item_methods {
     int (*item_coord_set)(void *priv_data, struct coord *c, int count, enum change_mode mode);
     int (*item_type_set)(void *priv_data, enum item_type type);
     int (*item_coords_left)(void *priv_data);
+    int (*item_coord_get_span)(void *priv_data, struct coord **c);
 };
 
 struct item_id {
@@ -130,6 +131,7 @@ int *item_get_default_flags(enum item_type type);
 void item_coord_rewind(struct item *it);
 int item_coords_left(struct item * it);
 int item_coord_get(struct item *it, struct coord *c, int count);
+int item_coord_get_span(struct item *it, struct coord **c, struct coord *buf, int count);
 int item_coord_set(struct item *it, struct coord *c, int count, enum change_mode mode);
 int item_coord_get_within_selection(struct item *it, struct coord *c, int count, struct map_selection *sel);
 int item_coord_get_within_range(struct item *i, struct coord *c, int max, struct coord *start, struct coord *end);
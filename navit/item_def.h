@@ -642,4 +642,5 @@ ITEM(poly_port)
 ITEM(poly_saltpond)
 ITEM(poly_dam)
 ITEM(poly_swimming_pool)
+ITEM(countrysearchindex)
 ITEM2(0xffffffff,last)
@@ -107,6 +107,8 @@ struct cursor {
     int interval;
 };
 
+struct layout_compiled;
+
 struct layout {
     NAVIT_OBJECT
     struct navit *navit;
@@ -122,6 +124,9 @@ struct layout {
     GList *cursors;
     int order_delta;
     int active;
+    struct layout_compiled **compiled;  /**< Layout compiled per order by the graphics, indexed by order */
+    int compiled_count;                 /**< Number of entries in {@code compiled} */
+    unsigned int compiled_layers;       /**< Signature of the layers the compiled layouts were built from */
 };
 
 /* prototypes */
@@ -72,6 +72,7 @@ struct map {
 struct map_rect {
     struct map *m;				/**< The map this extract is from */
     struct map_rect_priv *priv; /**< Private data of this map rect, only known to the map plugin */
+    struct item *pending;		/**< Item which did not fit into the last batch, see map_rect_get_items() */
 };
 
 /**
@@ -196,6 +197,19 @@ int map_requires_conversion(struct map *this_) {
     return (this_->meth.charset != NULL && strcmp(this_->meth.charset, "utf-8"));
 }
 
+/**
+ * @brief Checks if map rects on a map may be read from different threads at the same time
+ *
+ * Even then, map rects must be created and destroyed on the main thread, and each map rect must only be used by
+ * one thread at a time.
+ *
+ * @param this_ The map
+ * @return True if map_rect_get_items() may be called on different map rects of the map concurrently
+ */
+int map_allows_concurrent_rects(struct map *this_) {
+    return this_->meth.concurrent_rects;
+}
+
 char *map_converted_string_tmp=NULL;
 
 /**
@@ -375,6 +389,385 @@ void map_rect_destroy(struct map_rect *mr) {
     }
 }
 
+/**
+ * @brief Creates a new item batch
+ *
+ * @param max_items Maximum number of items per batch
+ * @param max_coords Size of the coordinate buffer shared by all items of a batch
+ * @param data_size Size of the buffer for attribute data (such as strings) shared by all items of a batch, in bytes
+ * @param attr_types Attributes to retrieve the first occurrence of for each item, terminated by `attr_none`.
+ * May be NULL.
+ * @param repeated_types Attributes to retrieve every occurrence of for each item, such as `attr_poly_hole`,
+ * terminated by `attr_none`. May be NULL.
+ * @return The new batch
+ */
+struct map_item_batch *map_item_batch_new(int max_items, int max_coords, int data_size, enum attr_type *attr_types,
+        enum attr_type *repeated_types) {
+    struct map_item_batch *batch=g_new0(struct map_item_batch, 1);
+    int i,count=0;
+
+    batch->max_items=max_items;
+    batch->items=g_new0(struct map_item_record, max_items);
+    batch->max_coords=max_coords;
+    batch->coords=g_new(struct coord, max_coords);
+    batch->data_size=data_size;
+    batch->data=g_malloc(data_size);
+    if (attr_types)
+        while (attr_types[batch->attr_count] != attr_none)
+            batch->attr_count++;
+    batch->attr_types=g_new(enum attr_type, batch->attr_count+1);
+    for (i = 0 ; i < batch->attr_count ; i++)
+        batch->attr_types[i]=attr_types[i];
+    batch->attr_types[batch->attr_count]=attr_none;
+    batch->attrs=g_new0(struct attr, max_items*batch->attr_count);
+    if (repeated_types)
+        while (repeated_types[count] != attr_none)
+            count++;
+    batch->repeated_types=g_new(enum attr_type, count+1);
+    for (i = 0 ; i < count ; i++)
+        batch->repeated_types[i]=repeated_types[i];
+    batch->repeated_types[count]=attr_none;
+    if (count) {
+        batch->max_repeated=max_items;
+        batch->repeated=g_new(struct attr, batch->max_repeated);
+    }
+    return batch;
+}
+
+/**
+ * @brief Destroys an item batch
+ *
+ * @param batch The batch
+ */
+void map_item_batch_destroy(struct map_item_batch *batch) {
+    g_free(batch->items);
+    g_free(batch->coords);
+    g_free(batch->data);
+    g_free(batch->attr_types);
+    g_free(batch->attrs);
+    g_free(batch->repeated_types);
+    g_free(batch->repeated);
+    g_free(batch);
+}
+
+/**
+ * @brief Checks if items of a given type are to be added to a batch
+ *
+ * Map plugins should call this before retrieving coordinates or attributes of an item.
+ *
+ * @param batch The batch
+ * @param type The item type
+ * @return True if the item type passes the filter of the batch
+ */
+int map_item_batch_wants(struct map_item_batch *batch, enum item_type type) {
+    return !batch->filter || batch->filter(batch->filter_priv, type);
+}
+
+/* Grows the coordinate buffer of a batch which holds a single record */
+static void map_item_batch_grow_coords(struct map_item_batch *batch, int needed) {
+    dbg_assert(batch->count == 1);
+    batch->max_coords=MAX(needed, batch->max_coords*2);
+    batch->coords=g_renew(struct coord, batch->coords, batch->max_coords);
+    batch->items[0].c=batch->coords;
+}
+
+/* Whether the data of an attribute is stored outside of struct attr, and therefore copied into a batch */
+static int map_item_batch_attr_has_data(struct attr *attr) {
+    return attr->type != attr_none && !(attr->type >= attr_type_int_begin && attr->type <= attr_type_int_end) &&
+           !(attr->type >= attr_type_item_type_begin && attr->type <= attr_type_item_type_end) &&
+           attr->type != attr_order && attr->u.data;
+}
+
+/* Moves an attribute of a batch along with the data buffer */
+static void map_item_batch_move_attr(struct map_item_batch *batch, struct attr *attr, char *data) {
+    if (map_item_batch_attr_has_data(attr))
+        attr->u.data=data+((char *)attr->u.data-batch->data);
+}
+
+/* Grows the attribute data buffer of a batch which holds a single record */
+static void map_item_batch_grow_data(struct map_item_batch *batch, int needed) {
+    struct map_item_record *rec=&batch->items[0];
+    char *data;
+    int i;
+
+    dbg_assert(batch->count == 1);
+    batch->data_size=MAX(needed, batch->data_size*2);
+    data=g_malloc(batch->data_size);
+    memcpy(data, batch->data, batch->data_used);
+    for (i = 0 ; i < batch->attr_count ; i++)
+        map_item_batch_move_attr(batch, &rec->attrs[i], data);
+    for (i = 0 ; i < rec->repeated_count ; i++)
+        map_item_batch_move_attr(batch, &rec->repeated[i], data);
+    g_free(batch->data);
+    batch->data=data;
+}
+
+/**
+ * @brief Adds a new record to a batch
+ *
+ * This reserves space for `count` coordinates, which the caller must copy to `c` of the record returned. If the
+ * batch is empty, its coordinate buffer grows to hold them. The attributes of the new record are all set to
+ * `attr_none`.
+ *
+ * @param batch The batch
+ * @param type The item type
+ * @param id_hi First part of the item ID
+ * @param id_lo Second part of the item ID
+ * @param count Number of coordinates of the item
+ * @return The new record, or NULL if the batch is full. In the latter case the map plugin should stop and
+ * deliver the item as the first one of the next batch.
+ */
+struct map_item_record *map_item_batch_record_new(struct map_item_batch *batch, enum item_type type, int id_hi, int id_lo,
+        int count) {
+    struct map_item_record *rec;
+    int i;
+
+    if (batch->count >= batch->max_items)
+        return NULL;
+    if (batch->coord_count+count > batch->max_coords && batch->count)
+        return NULL;
+    rec=&batch->items[batch->count++];
+    rec->type=type;
+    rec->id_hi=id_hi;
+    rec->id_lo=id_lo;
+    if (count > batch->max_coords)
+        map_item_batch_grow_coords(batch, count);
+    rec->c=batch->coords+batch->coord_count;
+    rec->count=count;
+    batch->coord_mark=batch->coord_count;
+    batch->data_mark=batch->data_used;
+    batch->repeated_mark=batch->repeated_used;
+    batch->coord_count+=count;
+    rec->attrs=batch->attrs+(batch->count-1)*batch->attr_count;
+    for (i = 0 ; i < batch->attr_count ; i++) {
+        rec->attrs[i].type=attr_none;
+        rec->attrs[i].u.data=NULL;
+    }
+    rec->repeated=batch->repeated+batch->repeated_used;
+    rec->repeated_count=0;
+    return rec;
+}
+
+/**
+ * @brief Reserves space for more coordinates in the last record of a batch
+ *
+ * Map plugins which do not know the number of coordinates of an item in advance use this when the space reserved
+ * so far turns out to be too small.
+ *
+ * @param batch The batch
+ * @param rec The record, which must be the last one added
+ * @param count Number of coordinates to add to `count` of the record
+ * @return True on success, false if the batch is full
+ */
+int map_item_batch_record_extend(struct map_item_batch *batch, struct map_item_record *rec, int count) {
+    if (batch->coord_count+count > batch->max_coords) {
+        if (batch->count > 1)
+            return 0;
+        map_item_batch_grow_coords(batch, batch->coord_count+count);
+    }
+    rec->count+=count;
+    batch->coord_count+=count;
+    return 1;
+}
+
+/**
+ * @brief Sets the number of coordinates actually stored in the last record of a batch
+ *
+ * Map plugins which do not know the number of coordinates of an item in advance reserve the space available with
+ * map_item_batch_record_new() and then release what they did not use.
+ *
+ * @param batch The batch
+ * @param rec The record, which must be the last one added
+ * @param count The number of coordinates stored, not more than `count` of the record
+ */
+void map_item_batch_record_set_count(struct map_item_batch *batch, struct map_item_record *rec, int count) {
+    dbg_assert(count <= rec->count);
+    rec->count=count;
+    batch->coord_count=batch->coord_mark+count;
+}
+
+/* Copies the data of an attribute to the data buffer of a batch, returns false if it is full */
+static int map_item_batch_copy_attr(struct map_item_batch *batch, struct attr *dst, struct attr *attr) {
+    int size;
+
+    dst->type=attr->type;
+    if (!map_item_batch_attr_has_data(attr)) {
+        dst->u=attr->u;
+        return 1;
+    }
+    size=attr_data_size(attr);
+    if (batch->data_used+size > batch->data_size) {
+        if (batch->count > 1) {
+            dst->type=attr_none;
+            return 0;
+        }
+        map_item_batch_grow_data(batch, batch->data_used+size);
+    }
+    dst->u.data=batch->data+batch->data_used;
+    memcpy(dst->u.data, attr->u.data, size);
+    /* keep the data of the next attribute aligned */
+    batch->data_used+=(size+7) & ~7;
+    return 1;
+}
+
+/**
+ * @brief Stores an attribute in a record of a batch
+ *
+ * Attribute data which is not stored in `struct attr` itself is copied to the data buffer of the batch.
+ *
+ * @param batch The batch
+ * @param rec The record, which must be the last one added
+ * @param idx Index of the attribute type in `attr_types` of the batch
+ * @param attr The attribute
+ * @return True on success, false if the batch is full
+ */
+int map_item_batch_record_attr(struct map_item_batch *batch, struct map_item_record *rec, int idx, struct attr *attr) {
+    return map_item_batch_copy_attr(batch, &rec->attrs[idx], attr);
+}
+
+/**
+ * @brief Appends an attribute to the repeated attributes of a record of a batch
+ *
+ * Map plugins call this for every occurrence of the attributes in `repeated_types` of the batch.
+ *
+ * @param batch The batch
+ * @param rec The record, which must be the last one added
+ * @param attr The attribute
+ * @return True on success, false if the batch is full
+ */
+int map_item_batch_record_repeated(struct map_item_batch *batch, struct map_item_record *rec, struct attr *attr) {
+    if (batch->repeated_used == batch->max_repeated) {
+        if (batch->count > 1)
+            return 0;
+        batch->max_repeated=MAX(16, batch->max_repeated*2);
+        batch->repeated=g_renew(struct attr, batch->repeated, batch->max_repeated);
+        rec->repeated=batch->repeated;
+    }
+    if (!map_item_batch_copy_attr(batch, &rec->repeated[rec->repeated_count], attr))
+        return 0;
+    rec->repeated_count++;
+    batch->repeated_used++;
+    return 1;
+}
+
+/**
+ * @brief Removes the last record from a batch
+ *
+ * Map plugins call this if the attributes of the last item added do not fit into the batch, and deliver the item
+ * as the first one of the next batch.
+ *
+ * @param batch The batch
+ */
+void map_item_batch_record_drop(struct map_item_batch *batch) {
+    dbg_assert(batch->count > 0);
+    batch->count--;
+    batch->coord_count=batch->coord_mark;
+    batch->data_used=batch->data_mark;
+    batch->repeated_used=batch->repeated_mark;
+}
+
+/**
+ * @brief Adds an item to a batch through the item methods
+ *
+ * This is the generic way of adding an item, used for map plugins which do not implement `map_rect_get_items`.
+ * Map plugins implementing it may use this for items which need no special treatment.
+ *
+ * @param batch The batch
+ * @param item The item, with coordinates and attributes rewound
+ * @return True if the item was added, false if the batch is full
+ */
+int map_item_batch_add_item(struct map_item_batch *batch, struct item *item) {
+    struct map_item_record *rec;
+    struct attr attr;
+    struct coord c;
+    int i,count,left;
+
+    left=item_coords_left(item);
+    rec=map_item_batch_record_new(batch, item->type, item->id_hi, item->id_lo, MAX(left, 0));
+    if (!rec)
+        return 0;
+    count=item_coord_get(item, rec->c, rec->count);
+    /* the map did not tell the number of coordinates, or told too few */
+    while (count == rec->count && item_coord_get(item, &c, 1)) {
+        /* take the space left in the batch first, the batch only grows for an item on its own */
+        left=batch->max_coords-batch->coord_count;
+        if (!map_item_batch_record_extend(batch, rec, left > 0 ? left : MAX(rec->count, 64))) {
+            map_item_batch_record_drop(batch);
+            return 0;
+        }
+        rec->c[count++]=c;
+        count+=item_coord_get(item, rec->c+count, rec->count-count);
+    }
+    map_item_batch_record_set_count(batch, rec, count);
+    for (i = 0 ; i < batch->attr_count ; i++) {
+        item_attr_rewind(item);
+        if (item_attr_get(item, batch->attr_types[i], &attr) && !map_item_batch_record_attr(batch, rec, i, &attr)) {
+            map_item_batch_record_drop(batch);
+            return 0;
+        }
+    }
+    for (i = 0 ; batch->repeated_types[i] != attr_none ; i++) {
+        item_attr_rewind(item);
+        while (item_attr_get(item, batch->repeated_types[i], &attr)) {
+            if (!map_item_batch_record_repeated(batch, rec, &attr)) {
+                map_item_batch_record_drop(batch);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Retrieves the next items from a map rect in one call
+ *
+ * This is the batched counterpart to map_rect_get_item(). It fills `batch` with the next items from the map
+ * rect (which pass the filter of the batch, if any), along with their coordinates and the attributes listed in
+ * `attr_types` of the batch. Map plugins may implement this natively; for others, items are retrieved one by one
+ * through their item methods.
+ *
+ * Map rects from which items are retrieved by this function should not be used with map_rect_get_item() at
+ * the same time.
+ *
+ * @param mr The map rect to retrieve items from
+ * @param batch The batch to fill, previous contents are discarded
+ * @return The number of items in the batch. 0 means there are no more items, unless `busy` of the batch is set.
+ */
+int map_rect_get_items(struct map_rect *mr, struct map_item_batch *batch) {
+    struct item *item;
+
+    dbg_assert(mr != NULL);
+    batch->count=0;
+    batch->coord_count=0;
+    batch->data_used=0;
+    batch->repeated_used=0;
+    batch->busy=0;
+    if (mr->m->meth.map_rect_get_items)
+        return mr->m->meth.map_rect_get_items(mr->priv, batch);
+    for (;;) {
+        if (mr->pending) {
+            item=mr->pending;
+            mr->pending=NULL;
+            item_coord_rewind(item);
+            item_attr_rewind(item);
+        } else
+            item=map_rect_get_item(mr);
+        if (!item)
+            break;
+        if (item == &busy_item) {
+            batch->busy=1;
+            break;
+        }
+        if (!map_item_batch_wants(batch, item->type))
+            continue;
+        if (!map_item_batch_add_item(batch, item)) {
+            mr->pending=item;
+            break;
+        }
+    }
+    return batch->count;
+}
+
 /**
  * @brief Holds information about a search on a map
  *
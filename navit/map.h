@@ -64,6 +64,62 @@ struct map_selection {
 	struct item_range range;	/**< Range of items which should be delivered */
 };
 
+/**
+ * @brief An item as retrieved by map_rect_get_items()
+ *
+ * Unlike a `struct item`, a record does not refer back to the map rect: its coordinates and attribute
+ * data are copies held by the batch it belongs to.
+ */
+struct map_item_record {
+	enum item_type type;		/**< Type of the item */
+	int id_hi;			/**< First part of the ID of the item */
+	int id_lo;			/**< Second part of the ID of the item */
+	struct coord *c;		/**< Coordinates of the item, pointing into the coordinate buffer of the batch */
+	int count;			/**< Number of coordinates in `c` */
+	struct attr *attrs;		/**< The first occurrence of each attribute in `attr_types` of the batch, in that order.
+					     Attributes the item does not have are of type `attr_none`. */
+	struct attr *repeated;		/**< Every occurrence of the attributes in `repeated_types` of the batch */
+	int repeated_count;		/**< Number of attributes in `repeated` */
+};
+
+/**
+ * @brief A batch of items retrieved from a map rect in one call
+ *
+ * A batch holds a number of item records along with buffers for their coordinates and attribute data.
+ * It is created with map_item_batch_new() and filled with map_rect_get_items(), which overwrites
+ * the previous contents. All data in the batch remains valid until the batch is filled again or destroyed,
+ * independent of the map rect it was filled from. An item which does not fit into a batch holding other items
+ * is delivered as the first item of the next batch, the buffers of a batch grow to hold an item on its own.
+ *
+ * Map plugins which implement `map_rect_get_items` fill the batch through map_item_batch_record_new(),
+ * map_item_batch_record_extend(), map_item_batch_record_set_count(), map_item_batch_record_attr(),
+ * map_item_batch_record_repeated() and map_item_batch_record_drop().
+ */
+struct map_item_batch {
+	struct map_item_record *items;	/**< The records retrieved */
+	int count;			/**< Number of records in `items` */
+	int max_items;			/**< Capacity of `items` */
+	struct coord *coords;		/**< Coordinate buffer shared by all records */
+	int coord_count;		/**< Number of coordinates used in `coords` */
+	int max_coords;			/**< Capacity of `coords` */
+	enum attr_type *attr_types;	/**< Attributes to retrieve for each item, terminated by `attr_none` */
+	int attr_count;			/**< Number of entries in `attr_types`, excluding the terminator */
+	struct attr *attrs;		/**< Attribute buffer, `attr_count` entries per record */
+	enum attr_type *repeated_types;	/**< Attributes to retrieve every occurrence of, terminated by `attr_none` */
+	struct attr *repeated;		/**< Buffer for the repeated attributes of all records */
+	int repeated_used;		/**< Number of attributes used in `repeated` */
+	int max_repeated;		/**< Capacity of `repeated` */
+	char *data;			/**< Buffer for attribute data which is not stored in the attribute itself */
+	int data_used;			/**< Number of bytes used in `data` */
+	int data_size;			/**< Capacity of `data` in bytes */
+	int (*filter)(void *priv, enum item_type type);	/**< If not NULL, only items for which this returns true are retrieved */
+	void *filter_priv;		/**< Private data passed to `filter` */
+	int busy;			/**< Set if retrieval stopped because the map is busy, the caller should retry later */
+	int coord_mark;			/**< `coord_count` before the last record was added, used by map_item_batch_record_drop() */
+	int data_mark;			/**< `data_used` before the last record was added, used by map_item_batch_record_drop() */
+	int repeated_mark;		/**< `repeated_used` before the last record was added, used by map_item_batch_record_drop() */
+};
+
 /**
  * @brief Holds all functions a map plugin has to implement to be usable
  *
@@ -90,6 +146,8 @@ struct map_methods {
 	struct item *		(*map_rect_create_item)(struct map_rect_priv *mr, enum item_type type); /**< Function to create a new item in the map */
 	int			(*map_get_attr)(struct map_priv *priv, enum attr_type type, struct attr *attr); /**< Function to get a map attribute, can be NULL */
     int			(*map_set_attr)(struct map_priv *priv, struct attr *attr); /**< Function to set a map attribute, can be NULL */
+	int			(*map_rect_get_items)(struct map_rect_priv *mr, struct map_item_batch *batch); /**< Function to fill a batch with the next items from a map rect, can be NULL */
+	int			concurrent_rects; /**< Whether different map rects may be read from different threads at the same time, see map_allows_concurrent_rects() */
 };
 
 /**
@@ -237,6 +295,8 @@ struct attr_iter;
 struct callback;
 struct item;
 struct map;
+struct map_item_batch;
+struct map_item_record;
 struct map_priv;
 struct map_rect;
 struct map_search;
@@ -250,6 +310,7 @@ int map_set_attr(struct map *this_, struct attr *attr);
 void map_add_callback(struct map *this_, struct callback *cb);
 void map_remove_callback(struct map *this_, struct callback *cb);
 int map_requires_conversion(struct map *this_);
+int map_allows_concurrent_rects(struct map *this_);
 char *map_convert_string_tmp(struct map *this_, char *str);
 char *map_convert_string(struct map *this_, char *str);
 char *map_convert_dup(char *str);
@@ -262,6 +323,17 @@ struct item *map_rect_get_item(struct map_rect *mr);
 struct item *map_rect_get_item_byid(struct map_rect *mr, int id_hi, int id_lo);
 struct item *map_rect_create_item(struct map_rect *mr, enum item_type type_);
 void map_rect_destroy(struct map_rect *mr);
+struct map_item_batch *map_item_batch_new(int max_items, int max_coords, int data_size, enum attr_type *attr_types, enum attr_type *repeated_types);
+void map_item_batch_destroy(struct map_item_batch *batch);
+int map_item_batch_wants(struct map_item_batch *batch, enum item_type type);
+struct map_item_record *map_item_batch_record_new(struct map_item_batch *batch, enum item_type type, int id_hi, int id_lo, int count);
+int map_item_batch_record_extend(struct map_item_batch *batch, struct map_item_record *rec, int count);
+void map_item_batch_record_set_count(struct map_item_batch *batch, struct map_item_record *rec, int count);
+int map_item_batch_record_attr(struct map_item_batch *batch, struct map_item_record *rec, int idx, struct attr *attr);
+int map_item_batch_record_repeated(struct map_item_batch *batch, struct map_item_record *rec, struct attr *attr);
+void map_item_batch_record_drop(struct map_item_batch *batch);
+int map_item_batch_add_item(struct map_item_batch *batch, struct item *item);
+int map_rect_get_items(struct map_rect *mr, struct map_item_batch *batch);
 struct map_search *map_search_new(struct map *m, struct item *item, struct attr *search_attr, int partial);
 struct item *map_search_get_item(struct map_search *this_);
 void map_search_destroy(struct map_search *this_);
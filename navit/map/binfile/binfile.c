@@ -39,9 +39,19 @@
 #include "callback.h"
 #include "types.h"
 #include "geom.h"
+#include "event.h"
+#include "navit.h"
 
 static int map_id;
 
+/** Maps whose opening was deferred, in the order they are opened at idle time. */
+static GList *binfile_pending;
+static struct callback *binfile_pending_cb;
+static struct event_idle *binfile_pending_idle;
+
+/** Bounding boxes of maps opened before, indexed by file name, see {@code binfile_bbox_cache_load()}. */
+static GHashTable *binfile_bbox_cache;
+
 
 /**
  * @brief A map tile, a rectangular region of the world.
@@ -132,6 +142,39 @@ struct map_priv {
     long download_enabled;
     int last_searched_town_id_hi;
     int last_searched_town_id_lo;
+    int lazy;                    //!< Map has not been opened yet, see {@code map_binfile_open_lazy()}.
+    int bbox_valid;              //!< Whether {@code bbox} is known.
+    struct coord_rect bbox;      //!< Bounding box of all tiles of the map.
+};
+
+/**
+ * @brief Bounding box of a map file, as cached across sessions.
+ */
+struct binfile_bbox {
+    long long size;              //!< Size of the file the bounding box was determined for.
+    long long mtime;             //!< Modification time of the file the bounding box was determined for.
+    struct coord_rect r;
+};
+
+#define BINFILE_ATTR_TABLE_SIZE 32
+
+/**
+ * @brief Type and offset of each attribute of the current item.
+ *
+ * Decoded once per item on the first attribute lookup, so that subsequent lookups by type
+ * (which rendering and routing do several times per item, in varying order) do not have to
+ * walk the attribute region of the item again.
+ */
+struct binfile_attr_table {
+    int count;              //!< Number of entries, -1 if not decoded yet, -2 if the item has too many attributes.
+    int next;               //!< Index of the entry following the one returned last.
+    int label;              //!< Whether the item has an {@code attr_label}.
+    int *label_attr[5];     //!< Attributes from which a label can be synthesized, see {@code map_rect_priv}.
+    struct {
+        enum attr_type type;
+        int offset;         //!< Offset of the size field of the attribute from {@code pos_attr_start}.
+        int size;           //!< Value of the size field of the attribute.
+    } entries[BINFILE_ATTR_TABLE_SIZE];
 };
 
 struct map_rect_priv {
@@ -140,6 +183,7 @@ struct map_rect_priv {
     enum attr_type attr_last;
     int label;
     int *label_attr[5];
+    struct binfile_attr_table attr_table;
     struct map_selection *sel;
     struct map_priv *m;
     struct item item;
@@ -150,6 +194,7 @@ struct map_rect_priv {
     char *url;
     struct attr attrs[8];
     int status;
+    int batch_pending;      //!< The current item did not fit into the last batch and is to be delivered again.
     struct map_search_priv *msp;
 #ifdef DEBUG_SIZE
     int size;
@@ -174,6 +219,11 @@ struct map_search_priv {
     struct coord_rect rect_new;
     char *parent_name;
     GHashTable *search_results;
+    struct map_rect_priv *mr_index; /**< Map rectangle holding the search index of the country, if any. */
+    struct search_index_entry *index_entries; /**< Entries of the search index, sorted by key */
+    char *index_strings; /**< Keys of the search index */
+    int index_count; /**< Number of entries in the search index */
+    int index_pos; /**< Next entry of the search index to check */
 };
 
 
@@ -181,7 +231,9 @@ static void push_tile(struct map_rect_priv *mr, struct tile *t, int offset, int
 static void setup_pos(struct map_rect_priv *mr);
 static void map_binfile_close(struct map_priv *m);
 static int map_binfile_open(struct map_priv *m);
+static void map_binfile_open_lazy(struct map_priv *m);
 static void map_binfile_destroy(struct map_priv *m);
+static void binfile_pending_remove(struct map_priv *m);
 
 static void lfh_to_cpu(struct zip_lfh *lfh) {
     dbg_assert(lfh != NULL);
@@ -411,6 +463,8 @@ static int binfile_search_cd(struct map_priv *m, int offset, char *name, int par
 
 static void map_destroy_binfile(struct map_priv *m) {
     dbg(lvl_debug,"map_destroy_binfile");
+    if (m->lazy)
+        binfile_pending_remove(m);
     if (m->fi)
         map_binfile_close(m);
     map_binfile_destroy(m);
@@ -453,6 +507,29 @@ static int binfile_coord_get(void *priv_data, struct coord *c, int count) {
     return ret;
 }
 
+/**
+ * @brief Get the remaining coords of the current item in place
+ *
+ * On little-endian hosts the coordinates in the tile can be used as they are, so this returns a pointer into the
+ * tile data. Otherwise, -1 tells the caller to copy them with {@code binfile_coord_get()}.
+ *
+ * @param priv_data The map rect
+ * @param c Receives a pointer to the coordinates
+ * @return The number of coordinates at {@code *c}, or -1 if not available in place
+ */
+static int binfile_coord_get_span(void *priv_data, struct coord **c) {
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    struct map_rect_priv *mr=priv_data;
+    struct tile *t=mr->t;
+    int count=binfile_coord_left(priv_data);
+    *c=(struct coord *)t->pos_coord;
+    t->pos_coord+=count*2;
+    return count;
+#else
+    return -1;
+#endif
+}
+
 /**
  * @brief Get nuber of coords left for current item
  *
@@ -471,9 +548,14 @@ static void binfile_attr_rewind(void *priv_data) {
     struct map_rect_priv *mr=priv_data;
     struct tile *t=mr->t;
     t->pos_attr=t->pos_attr_start;
-    mr->label=0;
-    memset(mr->label_attr, 0, sizeof(mr->label_attr));
-
+    mr->attr_table.next=0;
+    if (mr->attr_table.count >= 0) {
+        mr->label=mr->attr_table.label;
+        memcpy(mr->label_attr, mr->attr_table.label_attr, sizeof(mr->label_attr));
+    } else {
+        mr->label=0;
+        memset(mr->label_attr, 0, sizeof(mr->label_attr));
+    }
 }
 
 static char *binfile_extract(struct map_priv *m, char *dir, char *filename, int partial) {
@@ -521,69 +603,179 @@ static char *binfile_extract(struct map_priv *m, char *dir, char *filename, int
     return g_strdup_printf("%s/%s",dir,filename);
 }
 
-static int binfile_attr_get(void *priv_data, enum attr_type attr_type, struct attr *attr) {
-    struct map_rect_priv *mr=priv_data;
+/**
+ * @brief Records the attributes which may be used to synthesize a label for the current item.
+ *
+ * @param mr The map rect
+ * @param type The type of the attribute
+ * @param pos Pointer to the type field of the attribute
+ */
+static void binfile_attr_label_candidate(struct map_rect_priv *mr, enum attr_type type, int *pos) {
+    if (type == attr_label)
+        mr->label=1;
+    if (type == attr_house_number)
+        mr->label_attr[0]=pos;
+    if (type == attr_street_name)
+        mr->label_attr[1]=pos;
+    if (type == attr_street_name_systematic)
+        mr->label_attr[2]=pos;
+    if (type == attr_district_name && mr->item.type < type_line)
+        mr->label_attr[3]=pos;
+    if (type == attr_town_name && mr->item.type < type_line)
+        mr->label_attr[4]=pos;
+}
+
+/**
+ * @brief Fills in an attribute from the attribute data of the current item.
+ *
+ * @param mr The map rect
+ * @param type The type of the attribute
+ * @param pos Pointer to the type field of the attribute
+ * @param size Size of the attribute (type and data) in multiples of 4 Bytes
+ * @param attr Receives the attribute
+ */
+static void binfile_attr_decode(struct map_rect_priv *mr, enum attr_type type, int *pos, int size, struct attr *attr) {
+    attr->type=type;
+    if (ATTR_IS_GROUP(type)) {
+        int i=0;
+        int *subpos=pos+1;
+        int size_rem=size-1;
+        while (size_rem > 0 && i < 7) {
+            int subsize=le32_to_cpu(*subpos++);
+            int subtype=le32_to_cpu(subpos[0]);
+            mr->attrs[i].type=subtype;
+            attr_data_set_le(&mr->attrs[i], subpos+1);
+            subpos+=subsize;
+            size_rem-=subsize+1;
+            i++;
+        }
+        mr->attrs[i].type=attr_none;
+        mr->attrs[i].u.data=NULL;
+        attr->u.attrs=mr->attrs;
+    } else {
+        attr_data_set_le(attr, pos+1);
+        if (type == attr_url_local) {
+            g_free(mr->url);
+            mr->url=binfile_extract(mr->m, mr->m->cachedir, attr->u.str, 1);
+            attr->u.str=mr->url;
+        }
+        if (type == attr_flags && mr->m->map_version < 1)
+            attr->u.num |= AF_CAR;
+    }
+}
+
+/**
+ * @brief Decodes the attribute offset table of the current item.
+ *
+ * Walks the attribute region of the current item once and records type and offset of each
+ * attribute, along with the label candidates. If the item has more attributes than fit into
+ * the table, the table is marked as overflowed and lookups fall back to scanning the item.
+ *
+ * @param mr The map rect
+ */
+static void binfile_attr_table_setup(struct map_rect_priv *mr) {
     struct tile *t=mr->t;
-    enum attr_type type;
-    int i,size;
+    struct binfile_attr_table *at=&mr->attr_table;
+    int *pos=t->pos_attr_start;
+    int size;
 
-    if (attr_type != mr->attr_last) {
-        t->pos_attr=t->pos_attr_start;
-        mr->attr_last=attr_type;
+    at->count=0;
+    at->label=0;
+    memset(at->label_attr, 0, sizeof(at->label_attr));
+    while (pos < t->pos_next) {
+        if (at->count >= BINFILE_ATTR_TABLE_SIZE) {
+            at->count=-2;
+            return;
+        }
+        size=le32_to_cpu(*pos);
+        at->entries[at->count].type=le32_to_cpu(pos[1]);
+        at->entries[at->count].offset=pos-t->pos_attr_start;
+        at->entries[at->count].size=size;
+        binfile_attr_label_candidate(mr, at->entries[at->count].type, pos+1);
+        at->count++;
+        pos+=size+1;
     }
+    at->label=mr->label;
+    memcpy(at->label_attr, mr->label_attr, sizeof(at->label_attr));
+}
+
+/**
+ * @brief Gets an attribute of the current item by walking its attribute region.
+ *
+ * This is the fallback for items whose attributes do not fit into the attribute offset table.
+ */
+static int binfile_attr_get_scan(struct map_rect_priv *mr, enum attr_type attr_type, struct attr *attr) {
+    struct tile *t=mr->t;
+    enum attr_type type;
+    int size;
+
     while (t->pos_attr < t->pos_next) {
         size=le32_to_cpu(*(t->pos_attr++));
         type=le32_to_cpu(t->pos_attr[0]);
-        if (type == attr_label)
-            mr->label=1;
-        if (type == attr_house_number)
-            mr->label_attr[0]=t->pos_attr;
-        if (type == attr_street_name)
-            mr->label_attr[1]=t->pos_attr;
-        if (type == attr_street_name_systematic)
-            mr->label_attr[2]=t->pos_attr;
-        if (type == attr_district_name && mr->item.type < type_line)
-            mr->label_attr[3]=t->pos_attr;
-        if (type == attr_town_name && mr->item.type < type_line)
-            mr->label_attr[4]=t->pos_attr;
+        binfile_attr_label_candidate(mr, type, t->pos_attr);
         if (type == attr_type || attr_type == attr_any) {
             if (attr_type == attr_any) {
                 dbg(lvl_debug,"pos %p attr %s size %d", t->pos_attr-1, attr_to_name(type), size);
             }
-            attr->type=type;
-            if (ATTR_IS_GROUP(type)) {
-                int i=0;
-                int *subpos=t->pos_attr+1;
-                int size_rem=size-1;
-                i=0;
-                while (size_rem > 0 && i < 7) {
-                    int subsize=le32_to_cpu(*subpos++);
-                    int subtype=le32_to_cpu(subpos[0]);
-                    mr->attrs[i].type=subtype;
-                    attr_data_set_le(&mr->attrs[i], subpos+1);
-                    subpos+=subsize;
-                    size_rem-=subsize+1;
-                    i++;
-                }
-                mr->attrs[i].type=attr_none;
-                mr->attrs[i].u.data=NULL;
-                attr->u.attrs=mr->attrs;
-            } else {
-                attr_data_set_le(attr, t->pos_attr+1);
-                if (type == attr_url_local) {
-                    g_free(mr->url);
-                    mr->url=binfile_extract(mr->m, mr->m->cachedir, attr->u.str, 1);
-                    attr->u.str=mr->url;
-                }
-                if (type == attr_flags && mr->m->map_version < 1)
-                    attr->u.num |= AF_CAR;
-            }
+            binfile_attr_decode(mr, type, t->pos_attr, size, attr);
             t->pos_attr+=size;
             return 1;
         } else {
             t->pos_attr+=size;
         }
     }
+    return 0;
+}
+
+/**
+ * @brief Gets an attribute of the current item through the attribute offset table.
+ *
+ * The table index to resume from is derived from `t->pos_attr`, which remains the authoritative
+ * iteration state shared with {@code binfile_attr_get_scan()} and {@code binfile_attr_set()}.
+ */
+static int binfile_attr_get_table(struct map_rect_priv *mr, enum attr_type attr_type, struct attr *attr) {
+    struct tile *t=mr->t;
+    struct binfile_attr_table *at=&mr->attr_table;
+    int offset=t->pos_attr-t->pos_attr_start;
+    int i=at->next;
+
+    if (i >= at->count || at->entries[i].offset != offset) {
+        for (i = 0 ; i < at->count && at->entries[i].offset < offset ; i++);
+    }
+    for ( ; i < at->count ; i++) {
+        if (at->entries[i].type == attr_type || attr_type == attr_any) {
+            int *pos=t->pos_attr_start+at->entries[i].offset;
+            if (attr_type == attr_any) {
+                dbg(lvl_debug,"pos %p attr %s size %d", pos, attr_to_name(at->entries[i].type), at->entries[i].size);
+            }
+            binfile_attr_decode(mr, at->entries[i].type, pos+1, at->entries[i].size, attr);
+            t->pos_attr=pos+at->entries[i].size+1;
+            at->next=i+1;
+            return 1;
+        }
+    }
+    t->pos_attr=t->pos_next;
+    at->next=at->count;
+    return 0;
+}
+
+static int binfile_attr_get(void *priv_data, enum attr_type attr_type, struct attr *attr) {
+    struct map_rect_priv *mr=priv_data;
+    struct tile *t=mr->t;
+    int i;
+
+    if (attr_type != mr->attr_last) {
+        t->pos_attr=t->pos_attr_start;
+        mr->attr_table.next=0;
+        mr->attr_last=attr_type;
+    }
+    if (mr->attr_table.count == -1)
+        binfile_attr_table_setup(mr);
+    if (mr->attr_table.count >= 0) {
+        if (binfile_attr_get_table(mr, attr_type, attr))
+            return 1;
+    } else if (binfile_attr_get_scan(mr, attr_type, attr))
+        return 1;
     if (!mr->label && (attr_type == attr_any || attr_type == attr_label)) {
         for (i = 0 ; i < sizeof(mr->label_attr)/sizeof(int *) ; i++) {
             if (mr->label_attr[i]) {
@@ -840,6 +1032,7 @@ static struct item_methods methods_binfile = {
     binfile_coord_set,
     NULL,
     binfile_coords_left,
+    binfile_coord_get_span,
 };
 
 static void push_tile(struct map_rect_priv *mr, struct tile *t, int offset, int length) {
@@ -1391,6 +1584,7 @@ static int push_zipfile_tile(struct map_rect_priv *mr, int zipfile, int offset,
 static struct map_rect_priv *map_rect_new_binfile_int(struct map_priv *map, struct map_selection *sel) {
     struct map_rect_priv *mr;
 
+    map_binfile_open_lazy(map);
     binfile_check_version(map);
     dbg(lvl_debug,"map_rect_new_binfile");
     if (!map->fi && !map->url)
@@ -1469,9 +1663,36 @@ static void map_download_selection(struct map_priv *m, struct map_rect_priv *mr,
     }
 }
 
+/**
+ * @brief Checks whether a selection overlaps the bounding box of a map.
+ */
+static int binfile_bbox_overlaps(struct map_priv *map, struct map_selection *sel) {
+    if (!sel || !map->bbox_valid)
+        return 1;
+    while (sel) {
+        if (coord_rect_overlap(&map->bbox, &sel->u.c_rect))
+            return 1;
+        sel=sel->next;
+    }
+    return 0;
+}
+
 static struct map_rect_priv *map_rect_new_binfile(struct map_priv *map, struct map_selection *sel) {
-    struct map_rect_priv *mr=map_rect_new_binfile_int(map, sel);
+    struct map_rect_priv *mr;
     struct tile t;
+
+    if (map->lazy && !binfile_bbox_overlaps(map, sel)) {
+        /* Nothing to find here, no need to open the map yet */
+        mr=g_new0(struct map_rect_priv, 1);
+        mr->m=map;
+        mr->sel=sel;
+        mr->item.meth=&methods_binfile;
+        mr->item.priv_data=mr;
+        return mr;
+    }
+    mr=map_rect_new_binfile_int(map, sel);
+    if (!mr)
+        return NULL;
     dbg(lvl_debug,"zip_members=%d", map->zip_members);
     if (map->url && map->fi && sel && sel->order == 255) {
         map_download_selection(map, mr, sel);
@@ -1574,6 +1795,7 @@ static void setup_pos(struct map_rect_priv *mr) {
     coord_size=le32_to_cpu(t->pos[2]);
     t->pos_coord_start=t->pos+3;
     t->pos_attr_start=t->pos_coord_start+coord_size;
+    mr->attr_table.count=-1;
 }
 
 static int selection_contains(struct map_selection *sel, struct coord_rect *r, struct range *mima) {
@@ -1723,6 +1945,66 @@ static struct item *map_rect_get_item_binfile(struct map_rect_priv *mr) {
     }
 }
 
+/* Stores the attributes a batch asks for of the current item in its last record, returns false if the batch is full */
+static int binfile_batch_attrs(struct map_rect_priv *mr, struct map_item_batch *batch, struct map_item_record *rec) {
+    struct attr attr;
+    int i;
+
+    for (i = 0 ; i < batch->attr_count ; i++) {
+        binfile_attr_rewind(mr);
+        if (binfile_attr_get(mr, batch->attr_types[i], &attr) && !map_item_batch_record_attr(batch, rec, i, &attr))
+            return 0;
+    }
+    for (i = 0 ; batch->repeated_types[i] != attr_none ; i++) {
+        binfile_attr_rewind(mr);
+        while (binfile_attr_get(mr, batch->repeated_types[i], &attr))
+            if (!map_item_batch_record_repeated(batch, rec, &attr))
+                return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Fills a batch with the next items of a map rect.
+ *
+ * Coordinates are copied straight from the tile and attributes are looked up through the attribute offset table,
+ * without going through the item methods.
+ */
+static int map_rect_get_items_binfile(struct map_rect_priv *mr, struct map_item_batch *batch) {
+    struct map_item_record *rec;
+    struct item *item;
+
+    for (;;) {
+        if (mr->batch_pending) {
+            mr->batch_pending=0;
+            item=&mr->item;
+            binfile_coord_rewind(mr);
+            binfile_attr_rewind(mr);
+        } else
+            item=map_rect_get_item_binfile(mr);
+        if (!item)
+            break;
+        if (item == &busy_item) {
+            batch->busy=1;
+            break;
+        }
+        if (!map_item_batch_wants(batch, item->type))
+            continue;
+        rec=map_item_batch_record_new(batch, item->type, item->id_hi, item->id_lo, binfile_coord_left(mr));
+        if (!rec) {
+            mr->batch_pending=1;
+            break;
+        }
+        binfile_coord_get(mr, rec->c, rec->count);
+        if (!binfile_batch_attrs(mr, batch, rec)) {
+            map_item_batch_record_drop(batch);
+            mr->batch_pending=1;
+            break;
+        }
+    }
+    return batch->count;
+}
+
 static struct item *map_rect_get_item_byid_binfile(struct map_rect_priv *mr, int id_hi, int id_lo) {
     struct tile *t;
     if (mr->m->eoc) {
@@ -1915,13 +2197,118 @@ static int binmap_get_estimated_boundaries (struct item *town, GList **boundarie
     return 0;
 }
 
+/**
+ * @brief Finds the item of a given type and country in the tile on top of the stack of a map rect.
+ *
+ * @return The zip member referenced by the item, or -1 if there is no such item
+ */
+static int binmap_search_index_find(struct map_rect_priv *mr, enum item_type type, int country_id) {
+    struct tile *t=mr->t;
+    struct attr at;
+
+    for (t->pos_next=t->start ; t->pos_next < t->end ; ) {
+        t->pos=t->pos_next;
+        setup_pos(mr);
+        if (mr->item.type != type)
+            continue;
+        binfile_attr_rewind(mr);
+        if (!binfile_attr_get(mr, attr_country_id, &at) || at.u.num != country_id)
+            continue;
+        if (binfile_attr_get(mr, attr_zipfile_ref, &at))
+            return at.u.num;
+    }
+    return -1;
+}
+
+/**
+ * @brief Opens the search index of a country, as written by maptool.
+ *
+ * The index lists the casefolded names and postal codes of all towns and districts of the country in sorted
+ * order, so that matching towns can be found with a binary search instead of scanning all country index parts.
+ * Maps without a search index are searched the traditional way.
+ *
+ * @return True if the index was found, false otherwise
+ */
+static int binmap_search_index_open(struct map_priv *map, struct map_search_priv *msp, int country_id) {
+    struct map_rect_priv *mr;
+    struct search_index_header *header;
+    int zipfile, depth;
+
+    if (!map->eoc || map->url)
+        return 0;
+    mr=map_rect_new_binfile_int(map, NULL);
+    if (!mr)
+        return 0;
+    depth=mr->tile_depth;
+    push_zipfile_tile(mr, map->zip_members-1, 0, 0, 0);
+    if (mr->tile_depth == depth || (zipfile=binmap_search_index_find(mr, type_countryindex, country_id)) == -1)
+        goto fail;
+    depth=mr->tile_depth;
+    push_zipfile_tile(mr, zipfile, 0, 0, 0);
+    if (mr->tile_depth == depth || (zipfile=binmap_search_index_find(mr, type_countrysearchindex, country_id)) == -1)
+        goto fail;
+    depth=mr->tile_depth;
+    push_zipfile_tile(mr, zipfile, 0, 0, 0);
+    if (mr->tile_depth == depth || mr->t->end - mr->t->start < (int)(sizeof(*header)/sizeof(int)))
+        goto fail;
+    header=(struct search_index_header *)mr->t->start;
+    if (le32_to_cpu(header->sig) != search_index_sig)
+        goto fail;
+    msp->index_count=le32_to_cpu(header->count);
+    msp->index_entries=(struct search_index_entry *)(header+1);
+    msp->index_strings=(char *)(msp->index_entries+msp->index_count);
+    if (msp->index_strings > (char *)mr->t->end)
+        goto fail;
+    msp->mr_index=mr;
+    dbg(lvl_debug,"using search index with %d entries for country %d", msp->index_count, country_id);
+    return 1;
+fail:
+    map_rect_destroy_binfile(mr);
+    return 0;
+}
+
+/**
+ * @brief Positions a search on the first index entry not sorting before the search string.
+ */
+static void binmap_search_index_seek(struct map_search_priv *msp) {
+    int lo=0, hi=msp->index_count;
+
+    while (lo < hi) {
+        int mid=lo+(hi-lo)/2;
+        if (strcmp(msp->index_strings+le32_to_cpu(msp->index_entries[mid].key), msp->search.u.str) < 0)
+            lo=mid+1;
+        else
+            hi=mid;
+    }
+    msp->index_pos=lo;
+}
+
+/**
+ * @brief Checks whether an index entry, taken from an attribute of the given type, is relevant to a search.
+ */
+static int binmap_search_index_type_matches(enum attr_type search, enum attr_type key) {
+    switch (search) {
+    case attr_town_postal:
+        return key == attr_town_postal;
+    case attr_town_name:
+        return key == attr_town_name || key == attr_town_name_match;
+    case attr_town_or_district_name:
+        return key == attr_town_name || key == attr_town_name_match
+               || key == attr_district_name || key == attr_district_name_match;
+    default:
+        return 0;
+    }
+}
+
 static struct map_search_priv *binmap_search_new(struct map_priv *map, struct item *item, struct attr *search,
         int partial) {
     struct map_rect_priv *map_rec;
-    struct map_search_priv *msp=g_new0(struct map_search_priv, 1);
+    struct map_search_priv *msp;
     struct item *town;
     int idx;
 
+    map_binfile_open_lazy(map);
+    msp=g_new0(struct map_search_priv, 1);
     msp->search = *search;
     msp->partial = partial;
     if(ATTR_IS_STRING(msp->search.type))
@@ -1937,6 +2324,12 @@ static struct map_search_priv *binmap_search_new(struct map_priv *map, struct it
     case attr_town_name:
     case attr_town_or_district_name:
     case attr_town_postal:
+        if (binmap_search_index_open(map, msp, item->id_lo)) {
+            msp->mr = map_rect_new_binfile_int(map, NULL);
+            msp->mode = 4;
+            binmap_search_index_seek(msp);
+            return msp;
+        }
         map_rec = map_rect_new_binfile(map, NULL);
         if (!map_rec)
             break;
@@ -2121,6 +2514,44 @@ static int duplicate(struct map_search_priv *msp, struct item *item, enum attr_t
     return 0;
 }
 
+/**
+ * @brief Returns the next town matching a search, using the search index of the country.
+ */
+static struct item *binmap_search_index_get_item(struct map_search_priv *msp) {
+    int len=strlen(msp->search.u.str);
+    struct item *it;
+
+    while (msp->index_pos < msp->index_count) {
+        struct search_index_entry *e=&msp->index_entries[msp->index_pos++];
+        char *key=msp->index_strings+le32_to_cpu(e->key);
+        int zipfile=le32_to_cpu(e->zipfile), offset=le32_to_cpu(e->offset);
+
+        if (msp->partial ? strncmp(key, msp->search.u.str, len) : strcmp(key, msp->search.u.str))
+            break;
+        if (!binmap_search_index_type_matches(msp->search.type, le32_to_cpu(e->type)))
+            continue;
+        if (msp->mr->t && msp->mr->t->zipfile_num == zipfile) {
+            struct tile *t=msp->mr->t;
+            t->pos=t->start+offset;
+            msp->mr->item.id_hi=zipfile;
+            msp->mr->item.id_lo=offset;
+            setup_pos(msp->mr);
+            binfile_coord_rewind(msp->mr);
+            binfile_attr_rewind(msp->mr);
+            it=&msp->mr->item;
+        } else
+            it=map_rect_get_item_byid_binfile(msp->mr, zipfile, offset);
+        if (!it || !item_is_town(*it))
+            continue;
+        if (msp->search.type == attr_town_postal) {
+            if (!duplicate(msp, it, attr_town_name, attr_town_postal))
+                return it;
+        } else if (!duplicate(msp, it, attr_town_name, 0))
+            return it;
+    }
+    return NULL;
+}
+
 static int item_inside_poly_list(struct item *it, GList *l) {
 
     while(l) {
@@ -2158,6 +2589,8 @@ static struct item *binmap_search_get_item(struct map_search_priv *map_search) {
     struct attr at;
     enum linguistics_cmp_mode mode=(map_search->partial?linguistics_cmp_partial:0);
 
+    if (map_search->mode == 4)
+        return binmap_search_index_get_item(map_search);
     for (;;) {
         while ((it  = map_rect_get_item_binfile(map_search->mr))) {
             int has_house_number=0;
@@ -2325,6 +2758,8 @@ static void binmap_search_destroy(struct map_search_priv *ms) {
         map_rect_destroy_binfile(ms->mr_item);
     if (ms->mr)
         map_rect_destroy_binfile(ms->mr);
+    if (ms->mr_index)
+        map_rect_destroy_binfile(ms->mr_index);
     while(ms->boundaries) {
         geom_poly_segment_destroy(ms->boundaries->data, NULL);
         ms->boundaries=g_list_delete_link(ms->boundaries,ms->boundaries);
@@ -2336,6 +2771,7 @@ static int binmap_get_attr(struct map_priv *m, enum attr_type type, struct attr
     attr->type=type;
     switch (type) {
     case attr_map_release:
+        map_binfile_open_lazy(m);
         if (m->map_release) {
             attr->u.str=m->map_release;
             return 1;
@@ -2377,6 +2813,12 @@ static struct map_methods map_methods_binfile = {
     NULL,
     binmap_get_attr,
     binmap_set_attr,
+    map_rect_get_items_binfile,
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    1, /* concurrent_rects, the zip headers in the shared file data are converted in place otherwise */
+#else
+    0, /* concurrent_rects */
+#endif
 };
 
 static int binfile_get_index(struct map_priv *m) {
@@ -2644,11 +3086,206 @@ static void binfile_check_version(struct map_priv *m) {
     }
 }
 
+static void binfile_file_stamp(struct file *fi, long long *size, long long *mtime) {
+    file_version(fi, 0);
+    *size=fi->size;
+#ifndef __CEGCC__
+    *mtime=fi->mtime;
+#else
+    *mtime=0;
+#endif
+}
+
+static char *binfile_bbox_cache_filename(void) {
+    char *dir=navit_get_user_data_directory(FALSE);
+    if (!dir)
+        return NULL;
+    return g_strjoin(NULL, dir, "/binfile_bbox.txt", NULL);
+}
+
+/**
+ * @brief Loads the bounding boxes of the maps opened in earlier sessions.
+ *
+ * Each line of the cache file holds size and modification time of a map file, its bounding box and its name.
+ */
+static void binfile_bbox_cache_load(void) {
+    char *filename, line[4096];
+    FILE *f;
+
+    if (binfile_bbox_cache)
+        return;
+    binfile_bbox_cache=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    filename=binfile_bbox_cache_filename();
+    if (!filename)
+        return;
+    f=fopen(filename, "r");
+    g_free(filename);
+    if (!f)
+        return;
+    while (fgets(line, sizeof(line), f)) {
+        struct binfile_bbox *bbox=g_new(struct binfile_bbox, 1);
+        int n=0;
+        line[strcspn(line, "\r\n")]='\0';
+        if (sscanf(line, "%lld %lld %d %d %d %d %n", &bbox->size, &bbox->mtime, &bbox->r.lu.x, &bbox->r.lu.y,
+                   &bbox->r.rl.x, &bbox->r.rl.y, &n) != 6 || !n || !line[n]) {
+            g_free(bbox);
+            continue;
+        }
+        g_hash_table_replace(binfile_bbox_cache, g_strdup(line+n), bbox);
+    }
+    fclose(f);
+}
+
+static void binfile_bbox_cache_save_entry(gpointer key, gpointer value, gpointer user_data) {
+    struct binfile_bbox *bbox=value;
+    fprintf(user_data, "%lld %lld %d %d %d %d %s\n", bbox->size, bbox->mtime, bbox->r.lu.x, bbox->r.lu.y,
+            bbox->r.rl.x, bbox->r.rl.y, (char *)key);
+}
+
+static void binfile_bbox_cache_save(void) {
+    char *filename=binfile_bbox_cache_filename();
+    FILE *f;
+
+    if (!filename)
+        return;
+    f=fopen(filename, "w");
+    if (f) {
+        g_hash_table_foreach(binfile_bbox_cache, binfile_bbox_cache_save_entry, f);
+        fclose(f);
+    } else
+        dbg(lvl_warning,"unable to write %s", filename);
+    g_free(filename);
+}
+
+/**
+ * @brief Determines the bounding box of a map from the submaps listed in its index.
+ *
+ * @return True if the map has an index with submaps, false otherwise
+ */
+static int binfile_read_bbox(struct map_priv *m, struct coord_rect *r) {
+    struct map_rect_priv *mr;
+    struct tile *t;
+    struct coord c[2];
+    int depth,ret=0;
+
+    if (!m->eoc || m->url)
+        return 0;
+    mr=map_rect_new_binfile_int(m, NULL);
+    if (!mr)
+        return 0;
+    depth=mr->tile_depth;
+    push_zipfile_tile(mr, m->zip_members-1, 0, 0, 0);
+    if (mr->tile_depth != depth) {
+        t=mr->t;
+        for (t->pos_next=t->start ; t->pos_next < t->end ; ) {
+            t->pos=t->pos_next;
+            setup_pos(mr);
+            if (mr->item.type != type_submap)
+                continue;
+            binfile_coord_rewind(mr);
+            if (binfile_coord_get(mr, c, 2) != 2)
+                continue;
+            if (!ret) {
+                r->lu=r->rl=c[0];
+                ret=1;
+            }
+            coord_rect_extend(r, &c[0]);
+            coord_rect_extend(r, &c[1]);
+        }
+    }
+    map_rect_destroy_binfile(mr);
+    return ret;
+}
+
+/**
+ * @brief Opens a map whose opening was deferred by {@code map_new_binfile()}.
+ *
+ * Opening a map reads the end of central directory record, the central directory and the index of the file,
+ * which adds up at startup for mapsets with many maps. So local maps are only opened once a map rect is requested
+ * for a selection overlapping their bounding box (as cached from an earlier session), or at the latest when
+ * the main loop gets idle. The bounding box of the map is cached for the next session.
+ */
+static void map_binfile_open_lazy(struct map_priv *m) {
+    struct binfile_bbox *bbox;
+    long long size,mtime;
+
+    if (!m->lazy)
+        return;
+    binfile_pending_remove(m);
+    m->lazy=0;
+    dbg(lvl_debug,"opening %s", m->filename);
+    if (!map_binfile_open(m)) {
+        if (m->fi)
+            map_binfile_close(m);
+        m->fi=NULL;
+        m->bbox_valid=0;
+        return;
+    }
+    m->bbox_valid=binfile_read_bbox(m, &m->bbox);
+    if (!m->bbox_valid)
+        return;
+    binfile_file_stamp(m->fi, &size, &mtime);
+    binfile_bbox_cache_load();
+    bbox=g_hash_table_lookup(binfile_bbox_cache, m->filename);
+    if (bbox && bbox->size == size && bbox->mtime == mtime && !memcmp(&bbox->r, &m->bbox, sizeof(bbox->r)))
+        return;
+    if (!bbox) {
+        bbox=g_new(struct binfile_bbox, 1);
+        g_hash_table_insert(binfile_bbox_cache, g_strdup(m->filename), bbox);
+    }
+    bbox->size=size;
+    bbox->mtime=mtime;
+    bbox->r=m->bbox;
+    binfile_bbox_cache_save();
+}
+
+static void binfile_pending_remove(struct map_priv *m) {
+    binfile_pending=g_list_remove(binfile_pending, m);
+    if (!binfile_pending && binfile_pending_idle) {
+        event_remove_idle(binfile_pending_idle);
+        binfile_pending_idle=NULL;
+    }
+}
+
+static void binfile_pending_open(void) {
+    if (binfile_pending)
+        map_binfile_open_lazy(binfile_pending->data);
+}
+
+/**
+ * @brief Defers opening a local map until it is needed.
+ *
+ * @return True if opening was deferred, false if the map file cannot be opened at all
+ */
+static int map_binfile_defer_open(struct map_priv *m) {
+    struct file *fi=file_create(m->filename, NULL);
+    struct binfile_bbox *bbox;
+    long long size,mtime;
+
+    if (!fi)
+        return 0;
+    binfile_file_stamp(fi, &size, &mtime);
+    file_destroy(fi);
+    binfile_bbox_cache_load();
+    bbox=g_hash_table_lookup(binfile_bbox_cache, m->filename);
+    if (bbox && bbox->size == size && bbox->mtime == mtime) {
+        m->bbox=bbox->r;
+        m->bbox_valid=1;
+    }
+    m->lazy=1;
+    binfile_pending=g_list_append(binfile_pending, m);
+    if (!binfile_pending_idle && event_system()) {
+        if (!binfile_pending_cb)
+            binfile_pending_cb=callback_new_0(callback_cast(binfile_pending_open));
+        binfile_pending_idle=event_add_idle(500, binfile_pending_cb);
+    }
+    return 1;
+}
 
 static struct map_priv *map_new_binfile(struct map_methods *meth, struct attr **attrs, struct callback_list *cbl) {
     struct map_priv *m;
     struct attr *data=attr_search(attrs, attr_data);
-    struct attr *check_version,*flags,*url,*download_enabled;
+    struct attr *check_version,*flags,*url,*download_enabled,*lazy;
     struct file_wordexp *wexp;
     char **wexp_data;
     if (! data)
@@ -2677,7 +3314,11 @@ static struct map_priv *map_new_binfile(struct map_methods *meth, struct attr **
     if (download_enabled)
         m->download_enabled=download_enabled->u.num;
 
-    if (!map_binfile_open(m) && !m->check_version && !m->url) {
+    lazy=attr_search(attrs, attr_lazy);
+
+    if (!m->check_version && !m->url && (!lazy || lazy->u.num) && map_binfile_defer_open(m)) {
+        load_changes(m);
+    } else if (!map_binfile_open(m) && !m->check_version && !m->url) {
         map_binfile_destroy(m);
         m=NULL;
     } else {
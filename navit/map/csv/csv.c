@@ -553,6 +553,45 @@ static struct item *map_rect_get_item_csv(struct map_rect_priv *mr) {
     return NULL;
 }
 
+static int map_rect_get_items_csv(struct map_rect_priv *mr, struct map_item_batch *batch) {
+    struct map_item_record *rec;
+    struct item *item;
+    struct attr attr;
+    int i,fits;
+
+    for (;;) {
+        if (mr->batch_pending) {
+            mr->batch_pending=0;
+            item=&mr->item;
+        } else
+            item=map_rect_get_item_csv(mr);
+        if (!item)
+            break;
+        if (!map_item_batch_wants(batch, item->type))
+            continue;
+        rec=map_item_batch_record_new(batch, item->type, item->id_hi, item->id_lo, 1);
+        if (!rec) {
+            mr->batch_pending=1;
+            break;
+        }
+        rec->c[0]=mr->c;
+        fits=1;
+        for (i = 0 ; fits && i < batch->attr_count ; i++)
+            if (csv_attr_get(mr, batch->attr_types[i], &attr) && !map_item_batch_record_attr(batch, rec, i, &attr))
+                fits=0;
+        /* an item has one value per attribute */
+        for (i = 0 ; fits && batch->repeated_types[i] != attr_none ; i++)
+            if (csv_attr_get(mr, batch->repeated_types[i], &attr) && !map_item_batch_record_repeated(batch, rec, &attr))
+                fits=0;
+        if (!fits) {
+            map_item_batch_record_drop(batch);
+            mr->batch_pending=1;
+            break;
+        }
+    }
+    return batch->count;
+}
+
 static struct item *map_rect_get_item_byid_csv(struct map_rect_priv *mr, int id_hi, int id_lo) {
     /*currently id_hi is ignored*/
 
@@ -642,6 +681,8 @@ static struct map_methods map_methods_csv = {
     NULL,
     csv_create_item,
     csv_get_attr,
+    NULL,
+    map_rect_get_items_csv,
 };
 
 static struct map_priv *map_new_csv(struct map_methods *meth, struct attr **attrs, struct callback_list *cbl) {
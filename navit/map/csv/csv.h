@@ -51,5 +51,6 @@ struct map_rect_priv {
 	struct item item;
 	struct map_priv *m;
 	GList* at_iter;
+	int batch_pending;
 };
 
@@ -141,6 +141,7 @@ static int textfile_attr_get(void *priv_data, enum attr_type attr_type, struct a
         str=attr_to_name(attr_type);
         dbg(lvl_debug,"attr='%s' ",str);
         if (attr_from_line(mr->attrs,str,&mr->attr_pos,mr->attr, NULL)) {
+            attr->type=attr_type;
             textfile_encode_attr(mr->attr, attr_type, attr);
             dbg(lvl_debug,"found");
             return 1;
@@ -301,6 +302,70 @@ static struct item *map_rect_get_item_textfile(struct map_rect_priv *mr) {
     }
 }
 
+/**
+ * @brief Makes the item just read the next one to be read again.
+ */
+static void textfile_unget_item(struct map_rect_priv *mr, struct item *item) {
+    mr->more=0;
+    fseek(mr->f, item->id_lo, SEEK_SET);
+    clearerr(mr->f);
+    get_line(mr);
+}
+
+/**
+ * @brief Fills a batch with the next items of a map rect.
+ *
+ * Coordinates are read straight into the batch. Since they cannot be read again, an item which does not fit
+ * into a batch that already holds other items is delivered again by seeking back to its first line. When
+ * reading from a pipe, the item is truncated instead.
+ */
+static int map_rect_get_items_textfile(struct map_rect_priv *mr, struct map_item_batch *batch) {
+    struct map_item_record *rec;
+    struct item *item;
+    struct attr attr;
+    int i,count,fits;
+
+    while (batch->count < batch->max_items && batch->coord_count < batch->max_coords) {
+        item=map_rect_get_item_textfile(mr);
+        if (!item)
+            break;
+        if (!map_item_batch_wants(batch, item->type))
+            continue;
+        rec=map_item_batch_record_new(batch, item->type, item->id_hi, item->id_lo,
+                                      item->id_hi ? 1 : batch->max_coords-batch->coord_count);
+        count=textfile_coord_get(mr, rec->c, rec->count);
+        fits=1;
+        /* the item has more coordinates than the space reserved */
+        while (!item->id_hi && count == rec->count && mr->more && parse_line(mr, 0)) {
+            if (!map_item_batch_record_extend(batch, rec, rec->count)) {
+                fits=0;
+                break;
+            }
+            count+=textfile_coord_get(mr, rec->c+count, rec->count-count);
+        }
+        map_item_batch_record_set_count(batch, rec, count);
+        for (i = 0 ; fits && i < batch->attr_count ; i++) {
+            textfile_attr_rewind(mr);
+            if (textfile_attr_get(mr, batch->attr_types[i], &attr) && !map_item_batch_record_attr(batch, rec, i, &attr))
+                fits=0;
+        }
+        for (i = 0 ; fits && batch->repeated_types[i] != attr_none ; i++) {
+            textfile_attr_rewind(mr);
+            while (fits && textfile_attr_get(mr, batch->repeated_types[i], &attr))
+                fits=map_item_batch_record_repeated(batch, rec, &attr);
+        }
+        if (!fits) {
+            if (!mr->m->is_pipe) {
+                map_item_batch_record_drop(batch);
+                textfile_unget_item(mr, item);
+                break;
+            }
+            dbg(lvl_warning,"item "ITEM_ID_FMT" does not fit into batch, truncating", ITEM_ID_ARGS(*item));
+        }
+    }
+    return batch->count;
+}
+
 static struct item *map_rect_get_item_byid_textfile(struct map_rect_priv *mr, int id_hi, int id_lo) {
     if (mr->m->is_pipe) {
 #ifndef _MSC_VER
@@ -324,6 +389,13 @@ static struct map_methods map_methods_textfile = {
     map_rect_destroy_textfile,
     map_rect_get_item_textfile,
     map_rect_get_item_byid_textfile,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    map_rect_get_items_textfile,
 };
 
 static struct map_priv *map_new_textfile(struct map_methods *meth, struct attr **attrs, struct callback_list *cbl) {
@@ -30,6 +30,7 @@
 #include "maptool.h"
 #include "debug.h"
 #include "linguistics.h"
+#include "zipfile.h"
 #include "country.h"
 #include "file.h"
 #include "profile.h"
@@ -4047,18 +4048,25 @@ int map_resolve_coords_and_split_at_intersections(FILE *in, FILE *out, FILE *out
     return 0;
 }
 
-static void index_country_add(struct zip_info *info, int country_id, char*first_key, char *last_key, char *tile,
-                              char *filename,
-                              int size, FILE *out) {
-    struct item_bin *item_bin=init_item(type_countryindex);
+static int index_country_add_tile(struct zip_info *info, char *tile, char suffix, char *filename, int size) {
     int num=0, zip_num;
     char tilename[32];
 
     do {
-        snprintf(tilename,sizeof(tilename),"%ss%d", tile, num);
+        snprintf(tilename,sizeof(tilename),"%s%c%d", tile, suffix, num);
         num++;
         zip_num=add_aux_tile(info, tilename, filename, size);
     } while (zip_num == -1);
+    return zip_num;
+}
+
+static int index_country_add(struct zip_info *info, int country_id, char*first_key, char *last_key, char *tile,
+                             char *filename,
+                             int size, FILE *out) {
+    struct item_bin *item_bin=init_item(type_countryindex);
+    int zip_num;
+
+    zip_num=index_country_add_tile(info, tile, 's', filename, size);
 
     item_bin_add_attr_int(item_bin, attr_country_id, country_id);
 
@@ -4070,6 +4078,113 @@ static void index_country_add(struct zip_info *info, int country_id, char*first_
 
     item_bin_add_attr_int(item_bin, attr_zipfile_ref, zip_num);
     item_bin_write(item_bin, out);
+    return zip_num;
+}
+
+/**
+ * @brief An entry of the search index of a country, as collected while writing the country index.
+ */
+struct search_index_key {
+    char *key;          /**< Casefolded key */
+    int type;           /**< Attribute the key was taken from */
+    int part;           /**< Number of the country index part holding the item */
+    int offset;         /**< Offset of the item within the part, in multiples of 4 bytes */
+};
+
+/**
+ * @brief The search index entries of a country.
+ */
+struct search_index_keys {
+    struct search_index_key *keys;
+    int count;
+    int size;
+};
+
+static void search_index_key_add(struct search_index_keys *keys, char *key, enum attr_type type, int part, int offset) {
+    struct search_index_key *k;
+    if (keys->count == keys->size) {
+        keys->size=keys->size ? keys->size*2 : 1024;
+        keys->keys=g_renew(struct search_index_key, keys->keys, keys->size);
+    }
+    k=&keys->keys[keys->count++];
+    k->key=linguistics_casefold(key);
+    k->type=type;
+    k->part=part;
+    k->offset=offset;
+}
+
+static void search_index_keys_free(struct search_index_keys *keys) {
+    int i;
+    for (i = 0 ; i < keys->count ; i++)
+        g_free(keys->keys[i].key);
+    g_free(keys->keys);
+}
+
+static int search_index_key_compare(const void *p1, const void *p2) {
+    const struct search_index_key *k1=p1;
+    const struct search_index_key *k2=p2;
+    int ret=strcmp(k1->key, k2->key);
+    if (ret)
+        return ret;
+    return k1->type-k2->type;
+}
+
+/**
+ * @brief Writes the search index of a country.
+ *
+ * The index lists the casefolded names (including their match variants) and postal codes of all towns and
+ * districts of the country in sorted order, along with references to the items in the country index parts. This
+ * lets binfile look up towns by prefix with a binary search instead of scanning the whole country.
+ *
+ * @param zip_info The map being written
+ * @param co The country
+ * @param tile Name of the tile the country index is stored under
+ * @param keys The keys collected
+ * @param part_zip Zip member number of each country index part, indexed by part number
+ * @param out File receiving the item referencing the index
+ */
+static void write_country_search_index(struct zip_info *zip_info, struct country_table *co, char *tile, struct search_index_keys *keys,
+                                       int *part_zip, FILE *out) {
+    struct search_index_header header;
+    struct search_index_entry entry;
+    struct item_bin *item_bin;
+    char countrypart[32];
+    char *filename;
+    FILE *f;
+    int i,key_offset=0;
+
+    if (!keys->count)
+        return;
+    qsort(keys->keys, keys->count, sizeof(*keys->keys), search_index_key_compare);
+    snprintf(countrypart,sizeof(countrypart),"country_%d_s",co->countryid);
+    f=tempfile("0",countrypart,1);
+    filename=tempfile_name("0",countrypart);
+    header.sig=GUINT32_TO_LE(search_index_sig);
+    header.count=GUINT32_TO_LE(keys->count);
+    fwrite(&header, sizeof(header), 1, f);
+    for (i = 0 ; i < keys->count ; i++) {
+        struct search_index_key *k=&keys->keys[i];
+        entry.key=GUINT32_TO_LE(key_offset);
+        entry.type=GUINT32_TO_LE(k->type);
+        entry.zipfile=GUINT32_TO_LE(part_zip[k->part]);
+        entry.offset=GUINT32_TO_LE(k->offset);
+        fwrite(&entry, sizeof(entry), 1, f);
+        key_offset+=strlen(k->key)+1;
+    }
+    for (i = 0 ; i < keys->count ; i++) {
+        struct search_index_key *k=&keys->keys[i];
+        fwrite(k->key, strlen(k->key)+1, 1, f);
+    }
+    /* pad to a multiple of 4 bytes, like all other members */
+    while (ftello(f) % 4)
+        fputc(0, f);
+
+    item_bin=init_item(type_countrysearchindex);
+    item_bin_add_attr_int(item_bin, attr_country_id, co->countryid);
+    item_bin_add_attr_int(item_bin, attr_zipfile_ref, index_country_add_tile(zip_info, tile, 'i', filename, ftello(f)));
+    item_bin_write(item_bin, out);
+    fclose(f);
+    g_free(filename);
 }
 
 void write_countrydir(struct zip_info *zip_info, int max_index_size) {
@@ -4095,6 +4210,9 @@ void write_countrydir(struct zip_info *zip_info, int max_index_size) {
             char *countryindexname;
             FILE *countryindex;
             char key[1024]="",first_key[1024]="",last_key[1024]="";
+            struct search_index_keys search_keys= {NULL, 0, 0};
+            int *part_zip=NULL;
+            enum attr_type key_type=attr_none;
 
             tile(&co->r, "", tileco, max, overlap, NULL);
 
@@ -4122,8 +4240,11 @@ void write_countrydir(struct zip_info *zip_info, int max_index_size) {
                         tilecur[0]=0;
 
                     a=item_bin_get_attr_bin_last(ib);
-                    if(a && ATTR_IS_STRING(a->type))
+                    if(a && ATTR_IS_STRING(a->type)) {
                         g_strlcpy(key,(char *)(a+1),sizeof(key));
+                        key_type=a->type;
+                    } else
+                        key_type=attr_none;
                 }
 
                 /* If output file is already opened, and:
@@ -4135,8 +4256,9 @@ void write_countrydir(struct zip_info *zip_info, int max_index_size) {
                     partsize=ftello(out);
                     fclose(out);
                     out=NULL;
-                    index_country_add(zip_info,co->countryid,first_key,last_key,strlen(tileco)>strlen(tileprev)?tileco:tileprev,outname,
-                                      partsize,countryindex);
+                    part_zip=g_renew(int, part_zip, co->nparts+1);
+                    part_zip[co->nparts]=index_country_add(zip_info,co->countryid,first_key,last_key,
+                                                           strlen(tileco)>strlen(tileprev)?tileco:tileprev,outname,partsize,countryindex);
                     g_free(outname);
                     outname=NULL;
                     g_strlcpy(first_key,key,sizeof(first_key));
@@ -4155,11 +4277,23 @@ void write_countrydir(struct zip_info *zip_info, int max_index_size) {
                     partsize=0;
                 }
 
+                if (key_type != attr_none) {
+                    char *postal;
+                    search_index_key_add(&search_keys, key, key_type, co->nparts, ftello(out)/4);
+                    /* only the primary entry of a town carries its postal code into the index, not its match variants */
+                    if (key_type != attr_town_name_match && key_type != attr_district_name_match
+                            && (postal=item_bin_get_attr(ib, attr_town_postal, NULL)))
+                        search_index_key_add(&search_keys, postal, attr_town_postal, co->nparts, ftello(out)/4);
+                }
                 item_bin_write(ib,out);
                 partsize+=ibsize;
                 g_strlcpy(last_key,key,sizeof(last_key));
             }
 
+            write_country_search_index(zip_info, co, tileco, &search_keys, part_zip, countryindex);
+            search_index_keys_free(&search_keys);
+            g_free(part_zip);
+
             partsize=ftello(countryindex);
             if(partsize)
                 index_country_add(zip_info,co->countryid,NULL,NULL,tileco,countryindexname, partsize, zip_get_index(zip_info));
@@ -4219,6 +4353,8 @@ void remove_countryfiles(void) {
             sprintf(partsuffix,"%d",j);
             tempfile_unlink(partsuffix,filename);
         }
+        sprintf(filename,"country_%d_s", co->countryid);
+        tempfile_unlink("0",filename);
     }
 }
 
@@ -31,6 +31,12 @@
 #include <glib.h>
 #include <math.h>
 #include <time.h>
+#if defined(HAVE_UNISTD_H) && !defined(_WIN32)
+#include <sys/wait.h>
+#endif
+#ifndef _MSC_VER
+#include <sys/time.h>
+#endif /* _MSC_VER */
 #include "debug.h"
 #include "navit.h"
 #include "callback.h"
@@ -1413,6 +1419,502 @@ static int navit_cmd_spawn(struct navit *this, char *function, struct attr **in,
     return 0;
 }
 
+struct navit_draw_benchmark {
+    struct navit *navit;
+    char *viewports;
+    char *png_prefix;
+    struct callback *cb;
+    struct event_timeout *timeout;
+};
+
+static void navit_draw_benchmark_free(struct navit_draw_benchmark *b) {
+    if (b->timeout)
+        event_remove_timeout(b->timeout);
+    callback_destroy(b->cb);
+    g_free(b->viewports);
+    g_free(b->png_prefix);
+    g_free(b);
+}
+
+/**
+ * @brief Writes the last drawn map to a png file
+ *
+ * @return true on success, false if the graphics driver can't provide png images or the file could not be written
+ */
+static int navit_write_png(struct navit *this_, char *filename) {
+    struct graphics_data_image *image=graphics_get_data(this_->gra, "image_png");
+    FILE *f;
+    int ret=0;
+    if (!image || !image->data) {
+        dbg(lvl_error, "graphics driver can't provide png images");
+        return 0;
+    }
+    f=fopen(filename, "wb");
+    if (f) {
+        if (fwrite(image->data, image->size, 1, f) == 1)
+            ret=1;
+        else
+            dbg(lvl_error, "failed to write %s", filename);
+        fclose(f);
+    } else
+        dbg(lvl_error, "failed to open %s", filename);
+    return ret;
+}
+
+static void navit_draw_benchmark_png(struct navit *this_, char *prefix, int n) {
+    char *filename=g_strdup_printf("%s%04d.png", prefix, n);
+    navit_write_png(this_, filename);
+    g_free(filename);
+}
+
+/**
+ * @brief Draws the map for each viewport listed in a file and reports how long it took.
+ *
+ * Each line of the file describes one viewport as {@code zoom yaw pitch center}, where {@code zoom} is the scale
+ * as in {@code attr_zoom}, {@code pitch} is given as in {@code attr_pitch} and {@code center} is anything
+ * {@code pcoord_parse()} accepts. Empty lines and lines starting with {@code #} are skipped.
+ *
+ * The map is drawn synchronously. The report lists the time in milliseconds spent in each drawing phase, one line
+ * per viewport followed by the sums, and is also written to the log at level info. If the navit instance is not
+ * ready yet, the benchmark is retried later. After the last viewport, the previous view is restored.
+ *
+ * @param b The benchmark to run, freed when done
+ * @return The report, to be freed by the caller, or NULL if the benchmark did not run now
+ */
+static char *navit_draw_benchmark_run(struct navit_draw_benchmark *b) {
+    struct navit *this_=b->navit;
+    struct transformation *t=this_->trans;
+    struct coord center,c;
+    struct pcoord pc;
+    long scale;
+    int yaw,pitch,n=0,max_lines=16;
+    double total,phase[graphics_phase_last],sum[graphics_phase_last+1];
+    char line[4096],*report,**lines;
+    FILE *f;
+
+    if (this_->ready != 3) {
+        if (!b->timeout)
+            b->timeout=event_add_timeout(1000, 1, b->cb);
+        return NULL;
+    }
+    f=fopen(b->viewports, "r");
+    if (!f) {
+        dbg(lvl_error, "failed to open %s", b->viewports);
+        navit_draw_benchmark_free(b);
+        return NULL;
+    }
+    center=*transform_get_center(t);
+    scale=transform_get_scale(t);
+    yaw=transform_get_yaw(t);
+    pitch=transform_get_pitch(t);
+    memset(sum, 0, sizeof(sum));
+    /* the report is joined from its lines at the end, lines[0] is the header and lines[n+1] the sums */
+    lines=g_new0(char *, max_lines);
+    lines[0]=g_strdup("viewport total fetch transform clip draw other\n");
+    while (fgets(line, sizeof(line), f)) {
+        double zoom;
+        int vyaw,vpitch,pos,i;
+        struct timeval start,end;
+        if (line[0] == '#' || sscanf(line, "%lf %d %d %n", &zoom, &vyaw, &vpitch, &pos) != 3)
+            continue;
+        g_strchomp(line+pos);
+        if (!pcoord_parse(line+pos, transform_get_projection(t), &pc)) {
+            dbg(lvl_error, "invalid center '%s'", line+pos);
+            continue;
+        }
+        c.x=pc.x;
+        c.y=pc.y;
+        transform_set_center(t, &c);
+        transform_set_scale(t, zoom*16);
+        transform_set_yaw(t, vyaw);
+        transform_set_pitch(t, round(vpitch*sqrt(240*320)/sqrt(this_->w*this_->h)));
+        transform_setup_source_rect(t);
+        graphics_phase_timing(1);
+        gettimeofday(&start, NULL);
+        graphics_draw(this_->gra, this_->displaylist, this_->mapsets->data, t, this_->layout_current, 0, NULL,
+                      this_->graphics_flags|1);
+        gettimeofday(&end, NULL);
+        graphics_phase_timing(0);
+        graphics_phase_get(phase);
+        total=(end.tv_sec-start.tv_sec)*1000.0+(end.tv_usec-start.tv_usec)/1000.0;
+        if (n+3 > max_lines) {
+            max_lines*=2;
+            lines=g_renew(char *, lines, max_lines);
+        }
+        lines[n+1]=g_strdup_printf("%d %.3f %.3f %.3f %.3f %.3f %.3f\n", n, total, phase[graphics_phase_fetch],
+                                   phase[graphics_phase_transform], phase[graphics_phase_clip],
+                                   phase[graphics_phase_draw], phase[graphics_phase_none]);
+        sum[0]+=total;
+        for (i = 1 ; i < graphics_phase_last ; i++)
+            sum[i]+=phase[i];
+        sum[graphics_phase_last]+=phase[graphics_phase_none];
+        if (b->png_prefix)
+            navit_draw_benchmark_png(this_, b->png_prefix, n);
+        n++;
+    }
+    fclose(f);
+    lines[n+1]=n ? g_strdup_printf("sum %.3f %.3f %.3f %.3f %.3f %.3f\n", sum[0], sum[graphics_phase_fetch],
+                                   sum[graphics_phase_transform], sum[graphics_phase_clip], sum[graphics_phase_draw],
+                                   sum[graphics_phase_last]) : NULL;
+    lines[n+2]=NULL;
+    report=g_strjoinv("", lines);
+    g_strfreev(lines);
+    dbg(lvl_info, "draw benchmark of %s:\n%s", b->viewports, report);
+    transform_set_center(t, &center);
+    transform_set_scale(t, scale);
+    transform_set_yaw(t, yaw);
+    transform_set_pitch(t, pitch);
+    navit_draw_benchmark_free(b);
+    navit_draw(this_);
+    return report;
+}
+
+/* Runs a benchmark which had to wait for the navit instance, the report only goes to the log */
+static void navit_draw_benchmark_deferred(struct navit_draw_benchmark *b) {
+    g_free(navit_draw_benchmark_run(b));
+}
+
+/**
+ * @brief Command to benchmark drawing the map for a scripted list of viewports
+ *
+ * Usage: {@code draw_benchmark("viewports.txt"[,"png_prefix"])}, see {@code navit_draw_benchmark_run()} for the file
+ * format. If a prefix is given, each viewport is also written to {@code <png_prefix>NNNN.png}, which needs a graphics
+ * driver able to provide png images, such as gd. Meant to be run with {@code navit -e}, using the null or gd graphics.
+ * Returns the report as a string, unless the navit instance wasn't ready yet. The report is logged in any case.
+ */
+static int navit_cmd_draw_benchmark(struct navit *this, char *function, struct attr **in, struct attr ***out) {
+    struct navit_draw_benchmark *b;
+    struct attr attr;
+    char *report;
+    if (!in || !in[0] || !ATTR_IS_STRING(in[0]->type) || !in[0]->u.str) {
+        dbg(lvl_error, "usage: draw_benchmark(viewports[,png_prefix])");
+        return 0;
+    }
+    b=g_new0(struct navit_draw_benchmark, 1);
+    b->navit=this;
+    b->viewports=g_strdup(in[0]->u.str);
+    if (in[1] && ATTR_IS_STRING(in[1]->type) && in[1]->u.str)
+        b->png_prefix=g_strdup(in[1]->u.str);
+    b->cb=callback_new_1(callback_cast(navit_draw_benchmark_deferred), b);
+    report=navit_draw_benchmark_run(b);
+    if (report && out) {
+        attr.type=attr_type_string_begin;
+        attr.u.str=report;
+        *out=attr_generic_add_attr(*out, &attr);
+    }
+    g_free(report);
+    return 0;
+}
+
+/**
+ * @brief Command to read the frame statistics of the graphics
+ *
+ * Usage: {@code frame_stats([frames])}. With an argument, collecting the statistics is enabled for that number of
+ * frames, or disabled with 0, as with setting {@code attr_frame_stats} of the graphics. Returns the report of the
+ * graphics, see {@code attr_frame_report}.
+ */
+static int navit_cmd_frame_stats(struct navit *this, char *function, struct attr **in, struct attr ***out) {
+    struct attr attr;
+    if (!this->gra)
+        return 0;
+    if (in && in[0] && ATTR_IS_INT(in[0]->type)) {
+        attr.type=attr_frame_stats;
+        attr.u.num=in[0]->u.num;
+        graphics_set_attr(this->gra, &attr);
+    }
+    if (!graphics_get_attr(this->gra, attr_frame_report, &attr, NULL))
+        return 0;
+    if (out)
+        *out=attr_generic_add_attr(*out, &attr);
+    return 0;
+}
+
+struct navit_tile_request {
+    struct coord_rect r;    /**< Area to render */
+    char *filename;         /**< Png file to write */
+};
+
+struct navit_render_tiles {
+    struct navit *navit;
+    char *requests;                 /**< File the requests are read from, {@code -} for stdin */
+    char *directory;                /**< Directory the tiles are written to */
+    int workers;
+    int fd;
+    struct callback *cb;            /**< Called when requests can be read, or to retry starting */
+    struct event_timeout *timeout;  /**< Retries starting until the navit instance is ready */
+    struct event_watch *watch;      /**< Waits for requests */
+    char buffer[4096];              /**< Requests read but not complete yet */
+    int buffer_pos;
+    int count;                      /**< Number of requests so far */
+    int done;                       /**< Number of tiles written so far */
+    double seconds;                 /**< Time spent rendering so far */
+};
+
+static void navit_render_tiles_free(struct navit_render_tiles *rt) {
+    if (rt->timeout)
+        event_remove_timeout(rt->timeout);
+    if (rt->watch)
+        event_remove_watch(rt->watch);
+    if (rt->fd > 0)
+        close(rt->fd);
+    callback_destroy(rt->cb);
+    g_free(rt->requests);
+    g_free(rt->directory);
+    g_free(rt);
+}
+
+/**
+ * @brief Parses a tile request
+ *
+ * A request is either {@code z x y}, for the tile of the usual web map tiling scheme, written to
+ * {@code directory/z/x/y.png}, or {@code bbox lng1 lat1 lng2 lat2}, written to {@code directory/bboxNNNN.png},
+ * where NNNN is the number of the request.
+ *
+ * @return true if the line is a valid request
+ */
+static int navit_tile_request_parse(char *line, char *directory, int n, struct navit_tile_request *req) {
+    struct coord_geo g[2];
+    int z,x,y,i;
+    char *dir;
+
+    if (sscanf(line, "bbox %lf %lf %lf %lf", &g[0].lng, &g[0].lat, &g[1].lng, &g[1].lat) == 4) {
+        req->filename=g_strdup_printf("%s/bbox%04d.png", directory, n);
+    } else if (sscanf(line, "%d %d %d", &z, &x, &y) == 3 && z >= 0 && z < 31 && x >= 0 && y >= 0 && x < 1 << z
+               && y < 1 << z) {
+        for (i = 0 ; i < 2 ; i++) {
+            g[i].lng=(x+i)*360.0/(1 << z)-180;
+            g[i].lat=atan(sinh(M_PI*(1-2.0*(y+i)/(1 << z))))*180/M_PI;
+        }
+        dir=g_strdup_printf("%s/%d/%d", directory, z, x);
+        file_mkdir(dir, 1);
+        req->filename=g_strdup_printf("%s/%d.png", dir, y);
+        g_free(dir);
+    } else
+        return 0;
+    transform_from_geo(projection_mg, &g[0], &req->r.lu);
+    transform_from_geo(projection_mg, &g[1], &req->r.rl);
+    if (req->r.lu.x > req->r.rl.x) {
+        x=req->r.lu.x;
+        req->r.lu.x=req->r.rl.x;
+        req->r.rl.x=x;
+    }
+    if (req->r.lu.y < req->r.rl.y) {
+        y=req->r.lu.y;
+        req->r.lu.y=req->r.rl.y;
+        req->r.rl.y=y;
+    }
+    return 1;
+}
+
+/**
+ * @brief Renders a range of tile requests
+ *
+ * The view is centered on each requested area and scaled so the area fills the window. Scales are limited to
+ * multiples of 1/16 map unit per pixel, which makes tiles of zoom levels above 17 slightly larger than requested.
+ *
+ * @return The number of tiles written
+ */
+static int navit_render_tiles_range(struct navit *this_, struct navit_tile_request *req, int start, int end) {
+    struct transformation *t=this_->trans;
+    struct coord c;
+    double zoom;
+    int i,ret=0;
+
+    for (i = start ; i < end ; i++) {
+        c.x=req[i].r.lu.x+(req[i].r.rl.x-req[i].r.lu.x)/2;
+        c.y=req[i].r.rl.y+(req[i].r.lu.y-req[i].r.rl.y)/2;
+        zoom=MAX((double)(req[i].r.rl.x-req[i].r.lu.x)/this_->w, (double)(req[i].r.lu.y-req[i].r.rl.y)/this_->h);
+        transform_set_center(t, &c);
+        transform_set_scale(t, MAX(1, round(zoom*16)));
+        transform_set_yaw(t, 0);
+        transform_set_pitch(t, 0);
+        transform_setup_source_rect(t);
+        graphics_draw(this_->gra, this_->displaylist, this_->mapsets->data, t, this_->layout_current, 0, NULL,
+                      this_->graphics_flags|1);
+        ret+=navit_write_png(this_, req[i].filename);
+    }
+    return ret;
+}
+
+/**
+ * @brief Renders a batch of tile requests
+ *
+ * The requests are split into as many contiguous ranges as there are workers, so neighbouring tiles are rendered by
+ * the same worker and can reuse its displaylist. Each worker is a process forked from this navit instance, sharing
+ * the loaded mapset and owning a copy of the graphics.
+ *
+ * @return The number of tiles written
+ */
+static int navit_render_tiles_batch(struct navit_render_tiles *rt, struct navit_tile_request *req, int count) {
+    struct navit *this_=rt->navit;
+    int done=0;
+#if defined(HAVE_UNISTD_H) && !defined(_WIN32)
+    int i;
+
+    if (rt->workers > 1 && count > 1) {
+        sigset_t set,old;
+        pid_t *pids=g_new(pid_t, rt->workers);
+        /* keep the SIGCHLD handler of spawn_process from reaping the workers */
+        sigemptyset(&set);
+        sigaddset(&set, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &set, &old);
+        fflush(stdout);
+        for (i = 0 ; i < rt->workers ; i++) {
+            pids[i]=fork();
+            if (!pids[i]) {
+                int n=navit_render_tiles_range(this_, req, (long)count*i/rt->workers, (long)count*(i+1)/rt->workers);
+                _exit(n == (count*(i+1)/rt->workers-count*i/rt->workers) ? 0 : 1);
+            }
+            if (pids[i] < 0)
+                dbg(lvl_error, "fork failed");
+        }
+        for (i = 0 ; i < rt->workers ; i++) {
+            int status;
+            int n=count*(i+1)/rt->workers-count*i/rt->workers;
+            if (pids[i] < 0)
+                done+=navit_render_tiles_range(this_, req, count*i/rt->workers, count*(i+1)/rt->workers);
+            else if (waitpid(pids[i], &status, 0) == pids[i] && WIFEXITED(status) && !WEXITSTATUS(status))
+                done+=n;
+            else
+                dbg(lvl_error, "worker %d failed", i);
+        }
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        g_free(pids);
+        return done;
+    }
+#endif
+    done=navit_render_tiles_range(this_, req, 0, count);
+    return done;
+}
+
+/**
+ * @brief Reads the tile requests available and renders them
+ *
+ * Called by the watch on the request file, each call reads once, so the main loop stays responsive while the
+ * requests trickle in through stdin or a pipe. The complete lines read are rendered as one batch, see
+ * {@code navit_render_tiles_batch()}, and the view is restored afterwards. At the end of the file, the throughput is
+ * reported and the job is freed.
+ *
+ * @param rt The rendering job
+ */
+static void navit_render_tiles_io(struct navit_render_tiles *rt) {
+    struct navit *this_=rt->navit;
+    struct transformation *t=this_->trans;
+    struct navit_tile_request *req=NULL;
+    struct timeval start,end;
+    struct coord center;
+    long scale;
+    int yaw,pitch,size,count=0,done,i;
+    char *str,*tok;
+
+    size=read(rt->fd, rt->buffer+rt->buffer_pos, sizeof(rt->buffer)-rt->buffer_pos-1);
+    if (size <= 0) {
+        dbg(lvl_info, "rendered %d of %d tiles with %d workers in %.3f s, %.1f tiles/s", rt->done, rt->count,
+            MAX(1, rt->workers), rt->seconds, rt->seconds > 0 ? rt->done/rt->seconds : 0);
+        navit_render_tiles_free(rt);
+        navit_draw(this_);
+        return;
+    }
+    rt->buffer_pos+=size;
+    rt->buffer[rt->buffer_pos]='\0';
+    str=rt->buffer;
+    while ((tok=strchr(str, '\n'))) {
+        *tok++='\0';
+        if (str[0] != '#') {
+            if (!(count % 64))
+                req=g_renew(struct navit_tile_request, req, count+64);
+            if (navit_tile_request_parse(str, rt->directory, rt->count+count, &req[count]))
+                count++;
+            else if (g_strchomp(str)[0])
+                dbg(lvl_error, "invalid request '%s'", str);
+        }
+        str=tok;
+    }
+    if (str != rt->buffer) {
+        size=rt->buffer+rt->buffer_pos-str;
+        memmove(rt->buffer, str, size+1);
+        rt->buffer_pos=size;
+    } else if (rt->buffer_pos == sizeof(rt->buffer)-1) {
+        dbg(lvl_error, "request too long, dropped");
+        rt->buffer_pos=0;
+    }
+    if (!count)
+        return;
+    center=*transform_get_center(t);
+    scale=transform_get_scale(t);
+    yaw=transform_get_yaw(t);
+    pitch=transform_get_pitch(t);
+    gettimeofday(&start, NULL);
+    done=navit_render_tiles_batch(rt, req, count);
+    gettimeofday(&end, NULL);
+    transform_set_center(t, &center);
+    transform_set_scale(t, scale);
+    transform_set_yaw(t, yaw);
+    transform_set_pitch(t, pitch);
+    rt->seconds+=(end.tv_sec-start.tv_sec)+(end.tv_usec-start.tv_usec)/1000000.0;
+    rt->count+=count;
+    rt->done+=done;
+    dbg(lvl_debug, "rendered %d of %d tiles", done, count);
+    for (i = 0 ; i < count ; i++)
+        g_free(req[i].filename);
+    g_free(req);
+}
+
+/**
+ * @brief Starts serving tile requests once the navit instance is ready
+ *
+ * Until then, starting is retried every second. See {@code navit_tile_request_parse()} for the request format.
+ *
+ * @param rt The rendering job, freed if the request file can't be opened
+ */
+static void navit_render_tiles_start(struct navit_render_tiles *rt) {
+    if (rt->navit->ready != 3) {
+        if (!rt->timeout)
+            rt->timeout=event_add_timeout(1000, 1, rt->cb);
+        return;
+    }
+    if (rt->timeout) {
+        event_remove_timeout(rt->timeout);
+        rt->timeout=NULL;
+    }
+    rt->fd=strcmp(rt->requests, "-") ? open(rt->requests, O_RDONLY) : 0;
+    if (rt->fd < 0) {
+        dbg(lvl_error, "failed to open %s", rt->requests);
+        navit_render_tiles_free(rt);
+        return;
+    }
+    callback_destroy(rt->cb);
+    rt->cb=callback_new_1(callback_cast(navit_render_tiles_io), rt);
+    rt->watch=event_add_watch(rt->fd, event_watch_cond_read, rt->cb);
+}
+
+/**
+ * @brief Command to render map tiles and areas into png files
+ *
+ * Usage: {@code render_tiles("requests","directory"[,workers])}. Requests are read from the file or named pipe
+ * given, or from stdin if its name is {@code -}, and rendered as they arrive until the end of the input, while the
+ * main loop keeps running. The throughput is reported at debug level info. Meant for headless rendering with
+ * {@code navit -e} and the gd graphics, whose {@code w} and {@code h} give the tile size, and a layout without OSD
+ * items, which would be rendered into the tiles as well.
+ */
+static int navit_cmd_render_tiles(struct navit *this, char *function, struct attr **in, struct attr ***out) {
+    struct navit_render_tiles *rt;
+    if (!in || !in[0] || !ATTR_IS_STRING(in[0]->type) || !in[0]->u.str || !in[1] || !ATTR_IS_STRING(in[1]->type)
+            || !in[1]->u.str) {
+        dbg(lvl_error, "usage: render_tiles(requests,directory[,workers])");
+        return 0;
+    }
+    rt=g_new0(struct navit_render_tiles, 1);
+    rt->navit=this;
+    rt->requests=g_strdup(in[0]->u.str);
+    rt->directory=g_strdup(in[1]->u.str);
+    rt->workers=1;
+    if (in[2] && ATTR_IS_INT(in[2]->type))
+        rt->workers=in[2]->u.num;
+    rt->cb=callback_new_1(callback_cast(navit_render_tiles_start), rt);
+    navit_render_tiles_start(rt);
+    return 0;
+}
 
 static struct command_table commands[] = {
     {"zoom_in",command_cast(navit_cmd_zoom_in)},
@@ -1441,6 +1943,9 @@ static struct command_table commands[] = {
     {"set_attr_var",command_cast(navit_cmd_set_attr_var)},
     {"get_attr_var",command_cast(navit_cmd_get_attr_var)},
     {"switch_layout_day_night",command_cast(navit_cmd_switch_layout_day_night)},
+    {"draw_benchmark",command_cast(navit_cmd_draw_benchmark)},
+    {"render_tiles",command_cast(navit_cmd_render_tiles)},
+    {"frame_stats",command_cast(navit_cmd_frame_stats)},
 };
 
 void navit_command_add_table(struct navit*this_, struct command_table *commands, int count) {
@@ -1615,8 +1615,12 @@ static void osd_button_draw(struct osd_priv_common *opc, struct navit *nav, stru
         graphics_image_free(opc->osd_item.gr, img);
     } else {
         struct graphics *gra;
+        struct graphics_image *img;
         gra = navit_get_graphics(nav);
-        this->img = graphics_image_new_scaled(gra, this->src, opc->osd_item.w, opc->osd_item.h);
+        /* load before releasing the old image, so an unchanged image is taken from the cache */
+        img = graphics_image_new_scaled(gra, this->src, opc->osd_item.w, opc->osd_item.h);
+        graphics_image_free(gra, this->img);
+        this->img = img;
 
         if (!this->img) {
             dbg(lvl_warning, "failed to load '%s'", this->src);
@@ -1652,6 +1656,7 @@ static void osd_button_init(struct osd_priv_common *opc, struct navit *nav) {
     dbg(lvl_debug, "enter");
     dbg(lvl_debug, "Get: %s, %d, %d, %d, %d", this->src, opc->osd_item.rel_w, opc->osd_item.rel_h, opc->osd_item.w,
         opc->osd_item.h);
+    graphics_image_free(gra, this->img);
     this->img = graphics_image_new_scaled(gra, this->src, opc->osd_item.w, opc->osd_item.h);
     if (!this->img) {
         dbg(lvl_warning, "failed to load '%s'", this->src);
@@ -1706,6 +1711,7 @@ int osd_button_set_attr(struct osd_priv_common *opc, struct attr* attr) {
         }
         nav = opc->osd_item.navit;
         gra = navit_get_graphics(nav);
+        graphics_image_free(gra, this_->img);
         this_->img = graphics_image_new_scaled(gra, this_->src, opc->osd_item.w, opc->osd_item.h);
         if (!this_->img) {
             dbg(lvl_warning, "failed to load '%s'", this_->src);
@@ -1784,6 +1790,7 @@ static void osd_image_init(struct osd_priv_common *opc, struct navit *nav) {
 
     struct graphics *gra = navit_get_graphics(nav);
     dbg(lvl_debug, "enter");
+    graphics_image_free(gra, this->img);
     this->img = graphics_image_new(gra, this->src);
     if (!this->img) {
         dbg(lvl_warning, "failed to load '%s'", this->src);
@@ -358,18 +358,12 @@ static void popup_show_item(struct navit *nav, void *popup, struct displayitem *
 }
 
 static void popup_display(struct navit *nav, void *popup, struct point *p) {
-    struct displaylist_handle *dlh;
-    struct displaylist *display;
-    struct displayitem *di;
-
-    display=navit_get_displaylist(nav);
-    dlh=graphics_displaylist_open(display);
-    while ((di=graphics_displaylist_next(dlh))) {
-        if (graphics_displayitem_within_dist(display, di, p, 5)) {
-            popup_show_item(nav, popup, di);
-        }
-    }
-    graphics_displaylist_close(dlh);
+    GList *l,*curr;
+
+    l=displaylist_get_items_within_dist(navit_get_displaylist(nav), p, 5);
+    for (curr=l ; curr ; curr=g_list_next(curr))
+        popup_show_item(nav, popup, curr->data);
+    g_list_free(l);
 }
 
 static struct pcoord c;
@@ -2562,9 +2562,13 @@ static void route_graph_add_street(struct route_graph *this, struct item *item,
 
         s_pnt=route_graph_add_point(this,&l);
         if (!segmented) {
-            while (item_coord_get(item, &c, 1)) {
-                len+=transform_distance(map_projection(item->map), &l, &c);
-                l=c;
+            struct coord buf[64],*span;
+            int i,count;
+            while ((count=item_coord_get_span(item, &span, buf, sizeof(buf)/sizeof(*buf))) > 0) {
+                for (i = 0 ; i < count ; i++) {
+                    len+=transform_distance(map_projection(item->map), &l, &span[i]);
+                    l=span[i];
+                }
             }
             e_pnt=route_graph_add_point(this,&l);
             dbg_assert(len >= 0);
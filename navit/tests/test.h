@@ -0,0 +1,74 @@
+/**
+ * Navit, a modular navigation system.
+ * Copyright (C) 2005-2008 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Helpers shared by the test programs. A test counts its failed checks with CHECK() and returns test_result() from
+ * main(). Sources built with navit_benchmark() have BENCHMARK defined and time the code instead of checking it. */
+
+#ifndef NAVIT_TESTS_TEST_H
+#define NAVIT_TESTS_TEST_H
+
+#include <stdio.h>
+#ifndef _MSC_VER
+#include <sys/time.h>
+#endif
+
+/** Number of checks failed so far */
+static int test_failures;
+
+/** Reports a failed check and goes on with the test */
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); test_failures++; } } while (0)
+
+static unsigned int test_seed=1;
+
+/**
+ * @brief A small random generator of its own, so tests get the same numbers on every platform
+ */
+static inline unsigned int test_random(void) {
+    test_seed=test_seed*1103515245+12345;
+    return test_seed >> 8;
+}
+
+/**
+ * @brief Returns a random number from min to max, both included
+ */
+static inline int test_random_range(int min, int max) {
+    return min+(int)(test_random()%(unsigned int)(max-min+1));
+}
+
+/**
+ * @brief Returns the wall clock time in microseconds, for benchmarks
+ */
+static inline long long test_time_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec*1000000LL+tv.tv_usec;
+}
+
+/**
+ * @brief Reports the number of failed checks
+ *
+ * @return The exit code of the test, non-zero if any check failed
+ */
+static inline int test_result(void) {
+    if (test_failures)
+        fprintf(stderr, "%d checks failed\n", test_failures);
+    return test_failures != 0;
+}
+
+#endif
@@ -0,0 +1,270 @@
+/**
+ * Navit, a modular navigation system.
+ * Copyright (C) 2005-2008 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Checks the streaming polygon clipper against the per-edge Sutherland-Hodgman clipper it replaced. Built as
+ * bench_clip_polygon, it reports the time both take on large polygons instead. */
+
+/* the clipper is static in graphics.c */
+#include "graphics.c"
+#include "test.h"
+
+#define POLYGONS 40000
+#define MAX_POINTS 64
+#define BIG_POINTS 2000
+#define BENCH_REPEAT 200
+
+/* graphics_clip_polygon() as it was before the streaming clipper */
+static void graphics_clip_polygon_reference(struct point_rect * r, struct point * in, int count_in, struct point *out,
+        int* count_out) {
+    /* get a temp buffer to store points after one direction clipping.
+     * since we are clipping 4 directions, result is always in out at the end*/
+    struct point *temp;
+    struct point *pout;
+    struct point *pin;
+    int edge;
+    int count;
+
+    /* sanity check */
+    if((r == NULL) || (in == NULL) || (out == NULL) || (count_out == NULL) || (*count_out < count_in*8+1)) {
+        return;
+    }
+
+    /* prepare buffers. We have two buffers that we flip over.
+     * 1. the output buffer
+     * 2. temp
+     */
+    if (count_in < ALLOCA_COORD_LIMIT) {
+        temp=g_alloca(sizeof(struct point) * (count_in < ALLOCA_COORD_LIMIT ? count_in*8+1:0));
+    } else {
+        /* too big. Allocate a buffer (slower) */
+        temp=g_new(struct point, count_in*8+1);
+    }
+    /* use temp as first buffer. So we get the final result in out*/
+    pout = temp;
+    /* start with input polygon */
+    pin=in;
+    /* start with number of points of source polygon*/
+    count=count_in;
+
+    /* clip all four directions of a rectangle */
+    for (edge = 0 ; edge < 4 ; edge++) {
+        int i;
+        /* p is first element in current buffer */
+        struct point *p=pin;
+        /* s is lasst element in current buffer */
+        struct point *s=pin+count-1;
+        /* nothing written yet */
+        *count_out=0;
+
+        /* iterate all points in current buffer */
+        for (i = 0 ; i < count ; i++) {
+            if (is_inside(p, r, edge)) {
+                if (! is_inside(s, r, edge)) {
+                    struct point pi;
+                    /* current segment crosses border from outside to inside. Add crossing point with border first */
+                    poly_intersection(s,p,r,edge,&pi);
+                    pout[(*count_out)++]=pi;
+                }
+                /* add point if inside */
+                pout[(*count_out)++]=*p;
+            } else {
+                if (is_inside(s, r, edge)) {
+                    struct point pi;
+                    /*current segment crosses border from inside to outside. Add crossing point with border */
+                    poly_intersection(p,s,r,edge,&pi);
+                    pout[(*count_out)++]=pi;
+                }
+                /* skip point if outside */
+            }
+            /* move one coordinate forward */
+            s=p;
+            p++;
+        }
+        /* use result of last clipping for next */
+        count=*count_out;
+
+        /* switch buffer */
+        if(pout == temp) {
+            pout=out;
+            pin=temp;
+        } else {
+            pin=out;
+            pout=temp;
+        }
+    }
+
+    /* have clipped poly in out. And number of points now in *count_out */
+
+    /* if we had to allocate the buffer, we need to free it */
+    if (count_in >= ALLOCA_COORD_LIMIT) {
+        g_free(temp);
+    }
+    return;
+}
+
+/* A star shaped polygon around center, its corners between rmin and rmax away from it */
+static void test_star(struct point *p, int count, struct point *center, int rmin, int rmax) {
+    int i;
+    for (i = 0 ; i < count ; i++) {
+        double a=2*M_PI*i/count;
+        int radius=test_random_range(rmin, rmax);
+        p[i].x=center->x+radius*cos(a);
+        p[i].y=center->y+radius*sin(a);
+    }
+}
+
+#ifdef BENCHMARK
+/* Prints the time per call both clippers take on a polygon */
+static void test_clip_big(struct point_rect *r, struct point *p, int count, const char *name) {
+    struct point *out=g_new(struct point, count*8+1);
+    long long start,time_ref,time_new;
+    int i,count_out;
+
+    start=test_time_us();
+    for (i = 0 ; i < BENCH_REPEAT ; i++) {
+        count_out=count*8+1;
+        graphics_clip_polygon_reference(r, p, count, out, &count_out);
+    }
+    time_ref=test_time_us()-start;
+    start=test_time_us();
+    for (i = 0 ; i < BENCH_REPEAT ; i++) {
+        count_out=count*8+1;
+        graphics_clip_polygon(r, p, count, out, &count_out);
+    }
+    time_new=test_time_us()-start;
+    printf("%-24s %d points: %.1f -> %.1f us per call\n", name, count, (double)time_ref/BENCH_REPEAT,
+           (double)time_new/BENCH_REPEAT);
+    g_free(out);
+}
+#else
+/* A polygon of random points around the rectangle, partly on its edges, crossing itself as it likes */
+static void test_random_polygon(struct point *p, int count, struct point_rect *r) {
+    int w=r->rl.x-r->lu.x, h=r->rl.y-r->lu.y;
+    int i;
+    for (i = 0 ; i < count ; i++) {
+        p[i].x=test_random_range(r->lu.x-w, r->rl.x+w);
+        p[i].y=test_random_range(r->lu.y-h, r->rl.y+h);
+        switch (test_random()%8) {
+        case 0:
+            p[i].x=test_random()%2 ? r->lu.x : r->rl.x;
+            break;
+        case 1:
+            p[i].y=test_random()%2 ? r->lu.y : r->rl.y;
+            break;
+        }
+    }
+}
+
+/* Checks whether two polygons have the same points in the same order, possibly starting at a different one */
+static int test_same_polygon(struct point *a, int count_a, struct point *b, int count_b) {
+    int start,i;
+    if (count_a != count_b)
+        return 0;
+    if (!count_a)
+        return 1;
+    for (start = 0 ; start < count_b ; start++) {
+        for (i = 0 ; i < count_a ; i++) {
+            struct point *q=&b[(start+i)%count_b];
+            if (a[i].x != q->x || a[i].y != q->y)
+                break;
+        }
+        if (i == count_a)
+            return 1;
+    }
+    return 0;
+}
+
+/* Clips a polygon with both clippers, returns whether they agree */
+static int test_compare(struct point_rect *r, struct point *p, int count, struct point *out, struct point *expected) {
+    struct point *result;
+    int count_out=count*8+1,count_expected=count*8+1;
+
+    graphics_clip_polygon_reference(r, p, count, expected, &count_expected);
+    result=graphics_clip_polygon(r, p, count, out, &count_out);
+    return test_same_polygon(result, count_out, expected, count_expected);
+}
+
+/* Checks that both clippers agree on a large polygon */
+static void test_clip_big(struct point_rect *r, struct point *p, int count, const char *name) {
+    struct point *out=g_new(struct point, count*8+1), *expected=g_new(struct point, count*8+1);
+
+    if (!test_compare(r, p, count, out, expected)) {
+        fprintf(stderr, "%s: polygon differs from the reference\n", name);
+        test_failures++;
+    }
+    g_free(out);
+    g_free(expected);
+}
+
+/* Clips random polygons against random rectangles with both clippers and checks they agree */
+static void test_clip_random(void) {
+    struct point p[MAX_POINTS], out[MAX_POINTS*8+1], expected[MAX_POINTS*8+1];
+    struct point center;
+    int i,differ=0;
+
+    for (i = 0 ; i < POLYGONS ; i++) {
+        struct point_rect r;
+        int count=test_random_range(3, MAX_POINTS);
+        r.lu.x=test_random_range(-100, 100);
+        r.lu.y=test_random_range(-100, 100);
+        r.rl.x=r.lu.x+test_random_range(0, 400);
+        r.rl.y=r.lu.y+test_random_range(0, 400);
+        if (i%2)
+            test_random_polygon(p, count, &r);
+        else {
+            /* stars inside, outside, across or around the rectangle */
+            center.x=test_random_range(r.lu.x-500, r.rl.x+500);
+            center.y=test_random_range(r.lu.y-500, r.rl.y+500);
+            test_star(p, count, &center, test_random_range(0, 200), test_random_range(200, 1000));
+        }
+        if (!test_compare(&r, p, count, out, expected)) {
+            if (differ++ < 10)
+                fprintf(stderr, "polygon %d of %d points differs from the reference\n", i, count);
+        }
+    }
+    CHECK(!differ);
+}
+#endif
+
+int main(int argc, char **argv) {
+    struct point_rect screen= {{0, 0}, {799, 599}};
+    struct point *big=g_new(struct point, BIG_POINTS);
+    struct point center;
+
+#ifndef BENCHMARK
+    test_clip_random();
+#endif
+    center.x=400;
+    center.y=300;
+    test_star(big, BIG_POINTS, &center, 100, 250);
+    test_clip_big(&screen, big, BIG_POINTS, "inside the screen");
+    /* below the screen, the old clipper only drops the points in its last stage */
+    center.y=2000;
+    test_star(big, BIG_POINTS, &center, 100, 250);
+    test_clip_big(&screen, big, BIG_POINTS, "outside the screen");
+    center.y=300;
+    center.x=800;
+    test_star(big, BIG_POINTS, &center, 100, 400);
+    test_clip_big(&screen, big, BIG_POINTS, "partly visible");
+    center.x=400;
+    test_star(big, BIG_POINTS, &center, 1000, 3000);
+    test_clip_big(&screen, big, BIG_POINTS, "enclosing the screen");
+    g_free(big);
+    return test_result();
+}
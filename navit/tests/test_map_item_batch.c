@@ -0,0 +1,261 @@
+/**
+ * Navit, a modular navigation system.
+ * Copyright (C) 2005-2008 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Tests map_rect_get_items() through the generic path for map plugins without native batch support */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include "config.h"
+#include "debug.h"
+#include "item.h"
+#include "attr.h"
+#include "coord.h"
+#include "projection.h"
+#include "xmlconfig.h"
+#include "layout.h"
+#include "map.h"
+#include "plugin.h"
+#include "test.h"
+
+#define BIG_COUNT 1000
+
+struct map_priv {
+    int dummy;
+};
+
+/* An item of the test map */
+struct test_item {
+    struct item item;
+    int count;
+    struct coord *c;
+    char *label;
+    int flags;
+    struct poly_hole **holes;
+    int hole_count;
+    int coord_pos, label_pos, flags_pos, hole_pos;
+};
+
+struct map_rect_priv {
+    int pos;
+};
+
+static struct coord street_coords[40], wood_coords[3], big_coords[BIG_COUNT], point_coords[1];
+static struct poly_hole *wood_holes[2];
+static char long_label[100];
+
+static struct test_item test_items[]= {
+    {{type_poi_fuel, 0, 1}, 1, point_coords, "Fuel"},
+    {{type_street_2_city, 0, 2}, 40, street_coords, "Main Street", 5},
+    {{type_poly_wood, 0, 3}, 3, wood_coords, long_label, 0, wood_holes, 2},
+    {{type_none}},
+    {{type_street_3_city, 0, 4}, BIG_COUNT, big_coords, "Long Road"},
+    {{type_poi_bank, 0, 5}, 1, point_coords, "Filtered"},
+    {{type_town_label, 0, 6}, 1, point_coords, "Last"},
+};
+
+static void test_coord_rewind(void *priv_data) {
+    struct test_item *ti=priv_data;
+    ti->coord_pos=0;
+}
+
+static int test_coord_get(void *priv_data, struct coord *c, int count) {
+    struct test_item *ti=priv_data;
+    int ret=MIN(count, ti->count-ti->coord_pos);
+    memcpy(c, ti->c+ti->coord_pos, ret*sizeof(*c));
+    ti->coord_pos+=ret;
+    return ret;
+}
+
+static void test_attr_rewind(void *priv_data) {
+    struct test_item *ti=priv_data;
+    ti->label_pos=ti->flags_pos=ti->hole_pos=0;
+}
+
+static int test_attr_get(void *priv_data, enum attr_type attr_type, struct attr *attr) {
+    struct test_item *ti=priv_data;
+    attr->type=attr_type;
+    switch (attr_type) {
+    case attr_label:
+        if (!ti->label || ti->label_pos++)
+            return 0;
+        attr->u.str=ti->label;
+        return 1;
+    case attr_flags:
+        if (!ti->flags || ti->flags_pos++)
+            return 0;
+        attr->u.num=ti->flags;
+        return 1;
+    case attr_poly_hole:
+        if (ti->hole_pos >= ti->hole_count)
+            return 0;
+        attr->u.poly_hole=ti->holes[ti->hole_pos++];
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* The coordinate count is left unknown, so the batch has to grow records while reading them */
+static struct item_methods test_item_methods = {
+    test_coord_rewind,
+    test_coord_get,
+    test_attr_rewind,
+    test_attr_get,
+};
+
+static struct map_rect_priv *test_rect_new(struct map_priv *map, struct map_selection *sel) {
+    return g_new0(struct map_rect_priv, 1);
+}
+
+static void test_rect_destroy(struct map_rect_priv *mr) {
+    g_free(mr);
+}
+
+static struct item *test_rect_get_item(struct map_rect_priv *mr) {
+    struct test_item *ti;
+    if (mr->pos >= G_N_ELEMENTS(test_items))
+        return NULL;
+    ti=&test_items[mr->pos++];
+    if (ti->item.type == type_none)
+        return &busy_item;
+    ti->item.meth=&test_item_methods;
+    ti->item.priv_data=ti;
+    test_coord_rewind(ti);
+    test_attr_rewind(ti);
+    return &ti->item;
+}
+
+static void test_map_destroy(struct map_priv *priv) {
+    g_free(priv);
+}
+
+static struct map_methods test_map_methods = {
+    projection_mg,
+    "utf-8",
+    test_map_destroy,
+    test_rect_new,
+    test_rect_destroy,
+    test_rect_get_item,
+};
+
+static struct map_priv *test_map_new(struct map_methods *meth, struct attr **attrs, struct callback_list *cbl) {
+    *meth=test_map_methods;
+    return g_new0(struct map_priv, 1);
+}
+
+static int test_filter(void *priv, enum item_type type) {
+    return type != type_poi_bank;
+}
+
+static struct poly_hole *test_hole_new(int count, int offset) {
+    struct poly_hole *hole=g_malloc(sizeof(*hole)+count*sizeof(struct coord));
+    int i;
+    hole->coord_count=count;
+    for (i = 0 ; i < count ; i++) {
+        hole->coord[i].x=offset+i;
+        hole->coord[i].y=-offset-i;
+    }
+    return hole;
+}
+
+static void test_init(void) {
+    int i;
+    for (i = 0 ; i < G_N_ELEMENTS(street_coords) ; i++) {
+        street_coords[i].x=i*10;
+        street_coords[i].y=i*20;
+    }
+    for (i = 0 ; i < G_N_ELEMENTS(wood_coords) ; i++) {
+        wood_coords[i].x=-i;
+        wood_coords[i].y=i;
+    }
+    for (i = 0 ; i < BIG_COUNT ; i++) {
+        big_coords[i].x=i;
+        big_coords[i].y=BIG_COUNT-i;
+    }
+    memset(long_label, 'w', sizeof(long_label)-1);
+    wood_holes[0]=test_hole_new(4, 100);
+    wood_holes[1]=test_hole_new(20, 200);
+}
+
+/* Checks a record against the item of the test map it was read from */
+static void check_record(struct map_item_record *rec, struct test_item *ti) {
+    int i;
+    CHECK(rec->type == ti->item.type);
+    CHECK(rec->id_lo == ti->item.id_lo);
+    CHECK(rec->count == ti->count);
+    CHECK(!memcmp(rec->c, ti->c, MIN(rec->count, ti->count)*sizeof(struct coord)));
+    CHECK(rec->attrs[0].type == attr_label);
+    CHECK(rec->attrs[0].u.str != ti->label && !strcmp(rec->attrs[0].u.str, ti->label));
+    if (ti->flags) {
+        CHECK(rec->attrs[1].type == attr_flags);
+        CHECK(rec->attrs[1].u.num == ti->flags);
+    } else
+        CHECK(rec->attrs[1].type == attr_none);
+    CHECK(rec->repeated_count == ti->hole_count);
+    for (i = 0 ; i < MIN(rec->repeated_count, ti->hole_count) ; i++) {
+        struct poly_hole *hole=rec->repeated[i].u.poly_hole;
+        CHECK(rec->repeated[i].type == attr_poly_hole);
+        CHECK(hole != ti->holes[i] && hole->coord_count == ti->holes[i]->coord_count);
+        CHECK(!memcmp(hole->coord, ti->holes[i]->coord, hole->coord_count*sizeof(struct coord)));
+    }
+}
+
+int main(int argc, char **argv) {
+    enum attr_type attr_types[]= {attr_label, attr_flags, attr_none};
+    enum attr_type repeated_types[]= {attr_poly_hole, attr_none};
+    /* the items expected in each batch, as indices into test_items */
+    static const int expected[][3]= {{0, 1, -1}, {2, -1}, {4, 6, -1}, {-1}};
+    struct attr type= {attr_type, {"test"}};
+    struct attr *attrs[]= {&type, NULL};
+    struct map_item_batch *batch;
+    struct map_rect *mr;
+    struct map *m;
+    int i,n,busy=0;
+
+    test_init();
+    plugin_register_category_map("test", test_map_new);
+    m=map_new(NULL, attrs);
+    CHECK(m != NULL);
+    if (!m)
+        return 1;
+    /* small enough to hold neither the big item nor the long label along with other items */
+    batch=map_item_batch_new(4, 64, 64, attr_types, repeated_types);
+    batch->filter=test_filter;
+    mr=map_rect_new(m, NULL);
+    for (n = 0 ; n < G_N_ELEMENTS(expected) ; n++) {
+        map_rect_get_items(mr, batch);
+        if (batch->busy)
+            busy++;
+        for (i = 0 ; expected[n][i] >= 0 ; i++) {
+            CHECK(i < batch->count);
+            if (i < batch->count)
+                check_record(&batch->items[i], &test_items[expected[n][i]]);
+        }
+        CHECK(batch->count == i);
+    }
+    CHECK(busy == 1);
+    CHECK(!map_rect_get_items(mr, batch) && !batch->busy);
+    map_rect_destroy(mr);
+    map_item_batch_destroy(batch);
+    map_destroy(m);
+    g_free(wood_holes[0]);
+    g_free(wood_holes[1]);
+    return test_result();
+}
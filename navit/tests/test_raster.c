@@ -0,0 +1,329 @@
+/**
+ * Navit, a modular navigation system.
+ * Copyright (C) 2005-2008 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Draws a few primitives with the rasterizer of the SDL driver on 32 and 16 bit surfaces and compares the pixels
+ * with the images below. In them '#' is a pixel set to the color drawn, '.' one left alone and '+' one blended. */
+
+#include <string.h>
+#include <glib.h>
+#include "raster.h"
+#include "test.h"
+
+#define WIDTH 16
+#define HEIGHT 10
+
+struct test_image {
+    const char *name;
+    void (*draw)(SDL_Surface *s, Uint32 col);
+    int only_32bpp; /**< Blends too faint to show in 16 bit, so the image is checked on the 32 bit surface only */
+    const char *expected[HEIGHT];
+};
+
+static void test_draw_rect(SDL_Surface *s, Uint32 col) {
+    raster_rect(s, 2, 3, 5, 4, col);
+}
+
+static void test_draw_rect_clipped(SDL_Surface *s, Uint32 col) {
+    raster_rect(s, -3, -2, 6, 5, col);
+    raster_rect(s, 12, 7, 10, 10, col);
+}
+
+static void test_draw_triangle(SDL_Surface *s, Uint32 col) {
+    int16_t vx[]= {1, 14, 1}, vy[]= {1, 8, 8};
+    raster_polygon(s, 3, vx, vy, col);
+}
+
+/* a polygon crossing itself, so a scanline meets an odd number of edges at the crossing */
+static void test_draw_bowtie(SDL_Surface *s, Uint32 col) {
+    int16_t vx[]= {1, 14, 14, 1}, vy[]= {1, 8, 1, 8};
+    raster_polygon(s, 4, vx, vy, col);
+}
+
+/* a polygon reaching far beyond the surface on all sides */
+static void test_draw_polygon_outside(SDL_Surface *s, Uint32 col) {
+    int16_t vx[]= {-1000, 8, 1000}, vy[]= {-1000, 1000, -1000};
+    raster_polygon(s, 3, vx, vy, col);
+}
+
+static void test_draw_polygon_with_hole(SDL_Surface *s, Uint32 col) {
+    struct point p[]= {{1, 1}, {14, 1}, {14, 8}, {1, 8}};
+    struct point hole_points[]= {{5, 3}, {10, 3}, {10, 6}, {5, 6}};
+    struct point *holes[]= {hole_points};
+    int ccount[]= {4};
+    raster_polygon_with_holes(s, p, 4, 1, ccount, holes, col);
+}
+
+/* the triangle again, drawn through a clipping rectangle like the driver uses for overlays */
+static void test_draw_clip_rect(SDL_Surface *s, Uint32 col) {
+    int16_t vx[]= {1, 14, 1}, vy[]= {1, 8, 8};
+    SDL_Rect clip= {4, 2, 6, 5};
+    SDL_SetClipRect(s, &clip);
+    raster_polygon(s, 3, vx, vy, col);
+    SDL_SetClipRect(s, NULL);
+}
+
+static void test_draw_lines(SDL_Surface *s, Uint32 col) {
+    raster_line(s, 0, 0, 15, 9, col);
+    raster_line(s, 0, 5, 15, 5, col);
+    raster_line(s, 3, -5, 3, 20, col);
+}
+
+static void test_draw_circle(SDL_Surface *s, Uint32 col) {
+    raster_circle(s, 7, 4, 4, col);
+}
+
+static void test_draw_aapolygon(SDL_Surface *s, Uint32 col) {
+    int16_t vx[]= {1, 14, 1}, vy[]= {1, 8, 8};
+    raster_aapolygon(s, 3, vx, vy, col);
+}
+
+static void test_draw_aaline(SDL_Surface *s, Uint32 col) {
+    raster_aaline(s, 0, 1, 15, 7, col);
+}
+
+static struct test_image images[]= {
+    {
+        "rect", test_draw_rect, 0, {
+            "................",
+            "................",
+            "................",
+            "..#####.........",
+            "..#####.........",
+            "..#####.........",
+            "..#####.........",
+            "................",
+            "................",
+            "................",
+        }
+    },
+    {
+        "rect clipped", test_draw_rect_clipped, 0, {
+            "###.............",
+            "###.............",
+            "###.............",
+            "................",
+            "................",
+            "................",
+            "................",
+            "............####",
+            "............####",
+            "............####",
+        }
+    },
+    {
+        "triangle", test_draw_triangle, 0, {
+            "................",
+            ".#..............",
+            ".###............",
+            ".#####..........",
+            ".#######........",
+            ".########.......",
+            ".##########.....",
+            ".############...",
+            ".##############.",
+            "................",
+        }
+    },
+    {
+        "bowtie", test_draw_bowtie, 0, {
+            "................",
+            ".#............#.",
+            ".###........###.",
+            ".#####....#####.",
+            ".##############.",
+            ".##############.",
+            ".#####....#####.",
+            ".###........###.",
+            ".#............#.",
+            "................",
+        }
+    },
+    {
+        "polygon outside", test_draw_polygon_outside, 0, {
+            "################",
+            "################",
+            "################",
+            "################",
+            "################",
+            "################",
+            "################",
+            "################",
+            "################",
+            "################",
+        }
+    },
+    {
+        "polygon with hole", test_draw_polygon_with_hole, 0, {
+            "................",
+            "..#############.",
+            "..#############.",
+            "..####.....####.",
+            "..####.....####.",
+            "..####.....####.",
+            "..#############.",
+            "..#############.",
+            "..#############.",
+            "................",
+        }
+    },
+    {
+        "clip rect", test_draw_clip_rect, 0, {
+            "................",
+            "................",
+            "................",
+            "....##..........",
+            "....####........",
+            "....#####.......",
+            "....######......",
+            "................",
+            "................",
+            "................",
+        }
+    },
+    {
+        "lines", test_draw_lines, 0, {
+            "##.#............",
+            "..##............",
+            "...##...........",
+            "...#.##.........",
+            "...#...#........",
+            "################",
+            "...#......##....",
+            "...#........#...",
+            "...#.........##.",
+            "...#...........#",
+        }
+    },
+    {
+        "circle", test_draw_circle, 0, {
+            ".......#........",
+            ".....#####......",
+            "....#######.....",
+            "...#########....",
+            "...#########....",
+            "...#########....",
+            "....#######.....",
+            ".....#####......",
+            ".......#........",
+            "................",
+        }
+    },
+    {
+        "aapolygon", test_draw_aapolygon, 0, {
+            "................",
+            ".##.............",
+            ".##++...........",
+            ".####++.........",
+            ".######++.......",
+            ".########++.....",
+            ".##########++...",
+            ".############+..",
+            ".##############.",
+            "................",
+        }
+    },
+    {
+        "aaline", test_draw_aaline, 1, {
+            "................",
+            "#++.............",
+            ".+++++..........",
+            "...++#++........",
+            "......+++++.....",
+            "........++#++...",
+            "...........++++.",
+            ".............++#",
+            "................",
+            "................",
+        }
+    },
+};
+
+static Uint32 test_get_pixel(SDL_Surface *s, int x, int y) {
+    Uint8 *row=(Uint8 *)s->pixels+y*s->pitch;
+    if (s->format->BytesPerPixel == 2)
+        return ((Uint16 *)row)[x];
+    return ((Uint32 *)row)[x];
+}
+
+/* Writes a row of the surface in the notation of the images */
+static void test_image_row(SDL_Surface *s, int y, Uint32 col, char *row) {
+    int x;
+    for (x = 0 ; x < WIDTH ; x++) {
+        Uint32 pixel=test_get_pixel(s, x, y);
+        row[x]=pixel == col ? '#' : (pixel ? '+' : '.');
+    }
+    row[WIDTH]='\0';
+}
+
+/* Draws an image on a cleared surface and compares it with the expected one, printing it if it differs */
+static void test_image(SDL_Surface *s, struct test_image *image, const char *format) {
+    Uint32 col=SDL_MapRGB(s->format, 0xff, 0xff, 0xff);
+    char row[WIDTH+1];
+    int y,differs=0;
+
+    SDL_FillRect(s, NULL, 0);
+    image->draw(s, col);
+    for (y = 0 ; y < HEIGHT ; y++) {
+        test_image_row(s, y, col, row);
+        if (strcmp(row, image->expected[y]))
+            differs=1;
+    }
+    if (!differs)
+        return;
+    fprintf(stderr, "%s %s differs, drawn:\n", format, image->name);
+    for (y = 0 ; y < HEIGHT ; y++) {
+        test_image_row(s, y, col, row);
+        fprintf(stderr, "    \"%s\"\n", row);
+    }
+    test_failures++;
+}
+
+/* Draws the anti-aliased line on blue and checks an edge pixel is blended between blue and the line color */
+static void test_blend(SDL_Surface *s, const char *format) {
+    Uint32 col=SDL_MapRGB(s->format, 0xff, 0xff, 0xff);
+    Uint8 r,g,b;
+
+    SDL_FillRect(s, NULL, SDL_MapRGB(s->format, 0, 0, 0xff));
+    test_draw_aaline(s, col);
+    SDL_GetRGB(test_get_pixel(s, 4, 2), s->format, &r, &g, &b);
+    if (!(r > 0x10 && r < 0xf0 && r == g && b >= 0xf0)) {
+        fprintf(stderr, "%s: blended pixel is %02x%02x%02x\n", format, r, g, b);
+        test_failures++;
+    }
+}
+
+int main(int argc, char **argv) {
+    SDL_Surface *argb8888=SDL_CreateRGBSurface(SDL_SWSURFACE, WIDTH, HEIGHT, 32, 0xff0000, 0xff00, 0xff, 0xff000000);
+    SDL_Surface *rgb565=SDL_CreateRGBSurface(SDL_SWSURFACE, WIDTH, HEIGHT, 16, 0xf800, 0x7e0, 0x1f, 0);
+    int i;
+
+    CHECK(argb8888 != NULL);
+    CHECK(rgb565 != NULL);
+    if (!argb8888 || !rgb565)
+        return test_result();
+    for (i = 0 ; i < G_N_ELEMENTS(images) ; i++) {
+        test_image(argb8888, &images[i], "argb8888");
+        if (!images[i].only_32bpp)
+            test_image(rgb565, &images[i], "rgb565");
+    }
+    test_blend(argb8888, "argb8888");
+    SDL_FreeSurface(argb8888);
+    SDL_FreeSurface(rgb565);
+    return test_result();
+}
@@ -0,0 +1,182 @@
+/**
+ * Navit, a modular navigation system.
+ * Copyright (C) 2005-2008 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Checks the 2D batch path of transform() against the per-point loop it bypasses on random-walk polylines. Built
+ * as bench_transform, it reports the time both take instead. */
+
+/* the per-point loop needs the helpers of transform.c, which are static */
+#include "transform.c"
+#include "test.h"
+
+#ifdef BENCHMARK
+#define POINTS 200000
+#define REPEAT 5
+#else
+#define POINTS 20000
+#endif
+
+/* transform() as it was before the batch path was added */
+static int transform_reference(struct transformation *t, enum projection required_projection, struct coord *input,
+                               struct point *result, int count, int mindist, int width, int *width_result) {
+    struct coord projected_coord, shifted_coord;
+    struct coord_3d rotated_coord;
+    struct point screen_point;
+    int zlimit=t->znear;
+    struct z_clip_result clip_result, clip_result_old= {{0,0}, -1, 0, 0};
+    int i,result_idx = 0,result_idx_last=0;
+    dbg(lvl_debug,"count=%d", count);
+    for (i=0; i < count; i++) {
+        dbg(lvl_debug, "input coord %d: (%d, %d)", i, input[i].x, input[i].y);
+        projected_coord = transform_correct_projection(t, required_projection, input[i]);
+        shifted_coord = transform_shift_by_center_and_scale(t, projected_coord);
+        rotated_coord = transform_rotate(t, shifted_coord);
+
+        if (t->ddd) {
+            clip_result=transform_z_clip_if_necessary(rotated_coord, zlimit, clip_result_old);
+            clip_result_old=clip_result;
+            if(clip_result.process_coord_again) {
+                i--;
+            } else if (clip_result.skip_coord) {
+                continue;
+            }
+            screen_point = transform_project_onto_view_plane(t, clip_result.clipped_coord);
+        } else {
+            screen_point.x = rotated_coord.x>>POST_SHIFT;
+            screen_point.y = rotated_coord.y>>POST_SHIFT;
+        }
+        screen_point.x+=t->offx;
+        screen_point.y+=t->offy;
+        dbg(lvl_debug,"result: (%d, %d)", screen_point.x, screen_point.y);
+
+        if (i != 0 && i != count-1 &&
+                (input[i+1].x != input[0].x || input[i+1].y != input[0].y)) {
+            if (transform_points_too_close(screen_point, result[result_idx_last], mindist)) {
+                continue;
+            }
+        }
+        result[result_idx]=screen_point;
+        if (width_result) {
+            if (t->ddd) {
+                dbg(lvl_debug,"width %d * %d / %d",width,t->wscale,clip_result.clipped_coord.z);
+                width_result[result_idx]=width*t->wscale/clip_result.clipped_coord.z;
+            } else
+                width_result[result_idx]=width;
+        }
+        result_idx_last=result_idx;
+        result_idx++;
+    }
+    return result_idx;
+}
+
+/* A polyline wandering around center in steps of up to step, closed like a polygon if closed is set */
+static void test_polyline(struct coord *c, int count, struct coord *center, int step, int closed) {
+    int i;
+    c[0]=*center;
+    for (i = 1 ; i < count ; i++) {
+        c[i].x=c[i-1].x+(int)(test_random()%(2*step+1))-step;
+        c[i].y=c[i-1].y+(int)(test_random()%(2*step+1))-step;
+    }
+    if (closed)
+        c[count-1]=c[0];
+}
+
+#ifdef BENCHMARK
+/* Prints the time per point both paths take on a polyline */
+static void test_transform_polyline(struct transformation *t, struct coord *c, int count, int mindist, int with_width,
+                           const char *name, int closed) {
+    struct point *result=g_new(struct point, count);
+    int *width=g_new(int, count);
+    long long start,time_ref,time_batch;
+    int i,n=0;
+
+    start=test_time_us();
+    for (i = 0 ; i < REPEAT ; i++)
+        transform_reference(t, t->pro, c, result, count, mindist, 7, with_width ? width : NULL);
+    time_ref=test_time_us()-start;
+    start=test_time_us();
+    for (i = 0 ; i < REPEAT ; i++)
+        n=transform(t, t->pro, c, result, count, mindist, 7, with_width ? width : NULL);
+    time_batch=test_time_us()-start;
+    printf("%-24s %-6s mindist %d%-12s: %d of %d points, %.2f -> %.2f ns/point\n", name, closed ? "closed" : "open",
+           mindist, with_width ? " with widths" : "", n, count, time_ref*1000.0/REPEAT/count,
+           time_batch*1000.0/REPEAT/count);
+    g_free(result);
+    g_free(width);
+}
+#else
+/* Transforms a polyline with both paths and checks they agree */
+static void test_transform_polyline(struct transformation *t, struct coord *c, int count, int mindist, int with_width,
+                                    const char *name, int closed) {
+    struct point *result=g_new(struct point, count), *expected=g_new(struct point, count);
+    int *width=g_new(int, count), *expected_width=g_new(int, count);
+    int n,n_ref,failed=test_failures;
+
+    n_ref=transform_reference(t, t->pro, c, expected, count, mindist, 7, with_width ? expected_width : NULL);
+    n=transform(t, t->pro, c, result, count, mindist, 7, with_width ? width : NULL);
+    CHECK(n == n_ref);
+    if (n == n_ref) {
+        CHECK(!memcmp(result, expected, n*sizeof(*result)));
+        if (with_width)
+            CHECK(!memcmp(width, expected_width, n*sizeof(*width)));
+    }
+    if (test_failures != failed)
+        fprintf(stderr, "%s %s mindist %d%s differs\n", name, closed ? "closed" : "open", mindist,
+                with_width ? " with widths" : "");
+    g_free(result);
+    g_free(expected);
+    g_free(width);
+    g_free(expected_width);
+}
+#endif
+
+int main(int argc, char **argv) {
+    /* the views tested, the scale in 1/16 map units per pixel. The 3D view takes the per-point path in both. */
+    static const struct {
+        int scale, yaw, pitch, step;
+        const char *name;
+    } views[]= {
+        {16, 0, 0, 8, "street, north up"},
+        {16, 37, 0, 8, "street, rotated"},
+        {16*64, 270, 0, 500, "town, rotated"},
+        {16*4096, 0, 0, 20000, "country, north up"},
+        {16, 0, 20, 8, "street, 3D"},
+    };
+    struct pcoord center= {projection_mg, 0x138b4a, 0x5d783f};
+    struct coord center_coord= {center.x, center.y};
+    struct map_selection sel= {NULL};
+    struct coord *c=g_new(struct coord, POINTS);
+    int i,closed;
+
+    sel.u.p_rect.rl.x=800;
+    sel.u.p_rect.rl.y=600;
+    for (i = 0 ; i < G_N_ELEMENTS(views) ; i++) {
+        struct transformation *t=transform_new(&center, views[i].scale, views[i].yaw);
+        transform_set_screen_selection(t, &sel);
+        transform_set_pitch(t, views[i].pitch);
+        for (closed = 0 ; closed < 2 ; closed++) {
+            test_polyline(c, POINTS, &center_coord, views[i].step, closed);
+            test_transform_polyline(t, c, POINTS, 0, 0, views[i].name, closed);
+            test_transform_polyline(t, c, POINTS, 2, 0, views[i].name, closed);
+            test_transform_polyline(t, c, POINTS, 2, 1, views[i].name, closed);
+        }
+        transform_destroy(t);
+    }
+    g_free(c);
+    return test_result();
+}
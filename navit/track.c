@@ -438,19 +438,63 @@ static int street_data_within_selection(struct street_data *sd, struct map_selec
 }
 
 
+/* Attributes read for the street data of a tracking line, at the indices used by tracking_street_data_new() */
+static enum attr_type tracking_batch_attrs[]= {attr_flags, attr_maxspeed, attr_none};
+
+/* Only streets are tracked */
+static int tracking_batch_filter(void *priv, enum item_type type) {
+    return item_get_default_flags(type) != NULL;
+}
+
+/**
+ * @brief Creates the street data of a street read into a batch, like street_get_data() does for an item
+ *
+ * @param m The map the street is from
+ * @param rec The record of the street, with the attributes in {@code tracking_batch_attrs}
+ * @return The street data, to be freed with street_data_free()
+ */
+static struct street_data *tracking_street_data_new(struct map *m, struct map_item_record *rec) {
+    struct street_data *ret=g_malloc(sizeof(struct street_data)+rec->count*sizeof(struct coord));
+
+    memset(&ret->item, 0, sizeof(ret->item));
+    ret->item.type=rec->type;
+    ret->item.id_hi=rec->id_hi;
+    ret->item.id_lo=rec->id_lo;
+    ret->item.map=m;
+    ret->count=rec->count;
+    memcpy(ret->c, rec->c, rec->count*sizeof(struct coord));
+    if (rec->attrs[0].type == attr_flags)
+        ret->flags=rec->attrs[0].u.num;
+    else
+        ret->flags=*item_get_default_flags(rec->type);
+    ret->maxspeed=-1;
+    if ((ret->flags & AF_SPEED_LIMIT) && rec->attrs[1].type == attr_maxspeed)
+        ret->maxspeed=rec->attrs[1].u.num;
+    return ret;
+}
+
+/**
+ * @brief Collects the streets around a position as tracking lines
+ *
+ * The streets are read in batches, which leaves out all other items before their coordinates are copied.
+ * The street data keeps the type, map and ID of each street, as needed to look it up again.
+ */
 static void tracking_doupdate_lines(struct tracking *tr, struct coord *pc, enum projection pro) {
     int max_dist=1000;
     struct map_selection *sel;
     struct mapset_handle *h;
     struct map *m;
     struct map_rect *mr;
-    struct item *item;
+    struct map_item_batch *batch;
     struct street_data *street;
     struct tracking_line *tl;
     struct coord_geo g;
     struct coord cc;
+    int i;
 
     dbg(lvl_debug,"enter");
+    batch=map_item_batch_new(64, 4096, 256, tracking_batch_attrs, NULL);
+    batch->filter=tracking_batch_filter;
     h=mapset_open(tr->ms);
     while ((m=mapset_next(h,2))) {
         cc.x = pc->x;
@@ -463,10 +507,10 @@ static void tracking_doupdate_lines(struct tracking *tr, struct coord *pc, enum
         mr=map_rect_new(m, sel);
         if (!mr)
             continue;
-        while ((item=map_rect_get_item(mr))) {
-            if (item_get_default_flags(item->type)) {
-                street=street_get_data(item);
-                if (street_data_within_selection(street, sel)) {
+        while (map_rect_get_items(mr, batch) || batch->busy) {
+            for (i = 0 ; i < batch->count ; i++) {
+                street=tracking_street_data_new(m, &batch->items[i]);
+                if (street->count && street_data_within_selection(street, sel)) {
                     tl=g_malloc(sizeof(struct tracking_line)+(street->count-1)*sizeof(int));
                     tl->street=street;
                     tracking_get_angles(tl);
@@ -480,6 +524,7 @@ static void tracking_doupdate_lines(struct tracking *tr, struct coord *pc, enum
         map_rect_destroy(mr);
     }
     mapset_close(h);
+    map_item_batch_destroy(batch);
     dbg(lvl_debug, "exit");
 }
 
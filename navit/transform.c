@@ -545,6 +545,52 @@ static struct z_clip_result transform_z_clip_if_necessary(struct coord_3d coord,
     return clip_result;
 }
 
+/**
+ * @brief Transforms coordinates to screen points, for the 2D case without projection conversion
+ *
+ * This is the same calculation as {@code transform_shift_by_center_and_scale()} and {@code transform_rotate()}
+ * do for a single coordinate, written as a loop without branches or calls so the compiler can vectorize it.
+ */
+static void transform_2d_batch(struct transformation *t, const struct coord *input,
+                               struct point *result, int count) {
+    int cx=t->map_center.x, cy=t->map_center.y, shift=t->scale_shift;
+    int m00=t->m00, m01=t->m01, m10=t->m10, m11=t->m11;
+    int h0=HOG(*t)*t->m02, h1=HOG(*t)*t->m12;
+    int offx=t->offx, offy=t->offy;
+    int i;
+
+    for (i = 0 ; i < count ; i++) {
+        int x=(input[i].x-cx) >> shift;
+        int y=(input[i].y-cy) >> shift;
+        result[i].x=((x*m00+y*m01+h0) >> POST_SHIFT)+offx;
+        result[i].y=((x*m10+y*m11+h1) >> POST_SHIFT)+offy;
+    }
+}
+
+/**
+ * @brief Drops points closer than {@code mindist} to the previous one, see {@code transform()}
+ *
+ * @return The number of points left in {@code result}
+ */
+static int transform_2d_decimate(const struct coord *input, struct point *result, int count, int mindist, int width,
+                                 int *width_result) {
+    int i,result_idx=0,result_idx_last=0;
+
+    for (i = 0 ; i < count ; i++) {
+        if (i != 0 && i != count-1 &&
+                (input[i+1].x != input[0].x || input[i+1].y != input[0].y)) {
+            if (transform_points_too_close(result[i], result[result_idx_last], mindist))
+                continue;
+        }
+        result[result_idx]=result[i];
+        if (width_result)
+            width_result[result_idx]=width;
+        result_idx_last=result_idx;
+        result_idx++;
+    }
+    return result_idx;
+}
+
 int transform(struct transformation *t, enum projection required_projection, struct coord *input,
               struct point *result, int count, int mindist, int width, int *width_result) {
     struct coord projected_coord, shifted_coord;
@@ -554,6 +600,12 @@ int transform(struct transformation *t, enum projection required_projection, str
     struct z_clip_result clip_result, clip_result_old= {{0,0}, -1, 0, 0};
     int i,result_idx = 0,result_idx_last=0;
     dbg(lvl_debug,"count=%d", count);
+    if (!t->ddd && required_projection == t->pro) {
+        transform_2d_batch(t, input, result, count);
+        if (!mindist && !width_result)
+            return count;
+        return transform_2d_decimate(input, result, count, mindist, width, width_result);
+    }
     for (i=0; i < count; i++) {
         dbg(lvl_debug, "input coord %d: (%d, %d)", i, input[i].x, input[i].y);
 #if 0 /* doesn't work as wanted */
@@ -831,6 +883,45 @@ void transform_set_screen_center(struct transformation *t, struct point *p) {
     t->screen_center=*p;
 }
 
+/**
+ * @brief Moves the map to a new screen center right away.
+ *
+ * Unlike {@code transform_set_screen_center()}, whose center only takes effect when the transformation is set up
+ * again, this also moves the offset used by {@code transform()} and {@code transform_reverse()}. The map selection
+ * is left unchanged.
+ *
+ * @param t The transformation
+ * @param p The new screen center
+ */
+void transform_set_screen_offset(struct transformation *t, struct point *p) {
+    t->screen_center=*p;
+    t->offx=p->x;
+    t->offy=p->y;
+}
+
+/**
+ * @brief Sets the screen area the map selection of a transformation is computed from.
+ *
+ * Unlike {@code transform_set_screen_selection()}, this leaves the screen center, and thus the mapping of
+ * coordinates, unchanged. The area may extend beyond the screen.
+ *
+ * @param t The transformation
+ * @param r The screen area to select
+ */
+void transform_set_source_rect(struct transformation *t, struct point_rect *r) {
+    struct map_selection sel;
+
+    if (t->screen_sel)
+        sel=*t->screen_sel;
+    else
+        memset(&sel, 0, sizeof(sel));
+    sel.next=NULL;
+    sel.u.p_rect=*r;
+    map_selection_destroy(t->screen_sel);
+    t->screen_sel=map_selection_dup(&sel);
+    transform_setup_source_rect(t);
+}
+
 void transform_get_size(struct transformation *t, int *width, int *height) {
     struct point_rect *r;
     if (t->screen_sel) {
@@ -38,6 +38,7 @@ struct coord_geo_cart;
 struct map_selection;
 struct pcoord;
 struct point;
+struct point_rect;
 struct transformation;
 struct transformation *transform_new(struct pcoord *center, int scale, int yaw);
 int transform_get_hog(struct transformation *this_);
@@ -75,6 +76,8 @@ int transform_get_distance(struct transformation *this_);
 void transform_set_scales(struct transformation *this_, int xscale, int yscale, int wscale);
 void transform_set_screen_selection(struct transformation *t, struct map_selection *sel);
 void transform_set_screen_center(struct transformation *t, struct point *p);
+void transform_set_screen_offset(struct transformation *t, struct point *p);
+void transform_set_source_rect(struct transformation *t, struct point_rect *r);
 void transform_get_size(struct transformation *t, int *width, int *height);
 void transform_setup(struct transformation *t, struct pcoord *c, int scale, int yaw);
 void transform_setup_source_rect(struct transformation *t);
@@ -171,6 +171,26 @@ struct zip_alignment_check {
 	int x[sizeof(struct zip_cd) == 46 ? 1:-1];
 };
 
+#define search_index_sig 0x58444953
+
+//! Header of a country search index member.
+
+//! maptool writes one such member per country and references it from an item of type
+//! type_countrysearchindex in the country index. The header is followed by `count` entries
+//! sorted by key, and those by the NUL-terminated key strings. All values are little endian.
+struct search_index_header {
+	int sig;                 //!< search_index_sig
+	int count;               //!< number of entries
+} ATTRIBUTE_PACKED;
+
+//! Entry of a country search index.
+struct search_index_entry {
+	int key;                 //!< offset of the casefolded key, relative to the end of the entries
+	int type;                //!< attribute the key was taken from, e.g. attr_town_name_match or attr_town_postal
+	int zipfile;             //!< zip member holding the item
+	int offset;              //!< offset of the item within the zip member, in multiples of 4 bytes
+} ATTRIBUTE_PACKED;
+
 #ifdef HAVE_PRAGMA_PACK
 #pragma pack(pop)
 #endif